@@ -246,6 +246,19 @@ endfunction()
 
 Find_platform_sources("${SDK_SOURCE_ROOT}" PLATFORM_INCLUDES PLATFORM_SOURCES PLATFORM_HEADERS)
 
+# io_uring based file I/O on Linux. Availability is also checked at runtime,
+# falling back to poll based implementation.
+option(VSM_IO_URING "Build io_uring based file I/O controller" ON)
+if (VSM_IO_URING AND CMAKE_SYSTEM_NAME MATCHES "Linux" AND NOT ANDROID AND NOT BEAGLEBONE)
+    include(CheckSymbolExists)
+    check_symbol_exists(IORING_FEAT_RW_CUR_POS "linux/io_uring.h" HAVE_IORING_FEAT_RW_CUR_POS)
+    if (HAVE_IORING_FEAT_RW_CUR_POS)
+        add_definitions(-DVSM_IO_URING)
+    else()
+        message(STATUS "io_uring headers are too old, io_uring file I/O disabled")
+    endif()
+endif()
+
 Compile_protobuf_definitions(
     "ucs_vsm.proto;ucs_vsm_defs.proto"
     "${SDK_SOURCE_ROOT}/resources/protobuf"
@@ -101,21 +101,21 @@ public:
      * Do not close the fd while it is in polling state.
      * Close it after poll returns.
      */
-    void
+    virtual void
     Delete_handle(int fd);
 
     /** Queue IO operation. The provided callback is called when the operation
      * completes with Io_cb structure filled.
      * @return True if succeeded, false otherwise. Check errno for error code.
      */
-    bool
+    virtual bool
     Queue_operation(Io_cb &io_cb);
 
     /** Cancel pending operation.
      * @param io_cb Operation control block.
      * @return True if cancelled, false if not cancelled (e.g. too late).
      */
-    bool
+    virtual bool
     Cancel_operation(Io_cb &io_cb);
 
 private:
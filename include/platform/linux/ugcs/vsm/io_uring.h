@@ -0,0 +1,118 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file io_uring.h
+ *
+ * Minimal io_uring interface used by file I/O controller. Available if the
+ * SDK is built with VSM_IO_URING option, runtime support should be checked
+ * by Io_uring::Is_supported().
+ */
+#ifndef _UGCS_VSM_IO_URING_H_
+#define _UGCS_VSM_IO_URING_H_
+
+#include <ugcs/vsm/exception.h>
+
+#include <linux/io_uring.h>
+
+namespace ugcs {
+namespace vsm {
+namespace internal {
+
+/** Submission and completion rings of io_uring instance. Not thread safe,
+ * the owner should serialize submissions. Completions can be consumed by
+ * another thread than the one submitting.
+ */
+class Io_uring {
+public:
+    /** Create the rings.
+     * @param entries Submission queue size.
+     * @throw System_exception if io_uring is not available.
+     */
+    Io_uring(unsigned entries);
+
+    ~Io_uring();
+
+    Io_uring(const Io_uring &) = delete;
+
+    /** Check if the running kernel supports io_uring with all the features
+     * used by the SDK. The check is done once.
+     */
+    static bool
+    Is_supported();
+
+    /** Get next zeroed submission entry. The queue is submitted if full.
+     * @throw System_exception if the queue cannot be submitted.
+     */
+    io_uring_sqe *
+    Get_sqe();
+
+    /** Submit all queued entries without waiting.
+     * @throw System_exception on submission failure.
+     */
+    void
+    Submit();
+
+    /** Wait for at least one completion without submitting anything. Can be
+     * called concurrently with submissions from another thread.
+     * @return false if interrupted by a signal.
+     */
+    bool
+    Wait();
+
+    /** Invoke the handler for each available completion and consume them.
+     * @return Number of completions processed.
+     */
+    template <class Handler>
+    unsigned
+    Process_completions(Handler &&handler)
+    {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        while (head != tail) {
+            handler(cqes[head & *cq_mask]);
+            head++;
+            count++;
+            /* Release the entry before the handler submits more. */
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        return count;
+    }
+
+private:
+    int ring_fd = -1;
+    /** Ring mappings. */
+    void *sq_ring = nullptr, *cq_ring = nullptr;
+    size_t sq_ring_size = 0, cq_ring_size = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned sq_entries = 0;
+    /** Shared ring fields. */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+    /** Local tail, published to the kernel on submission. */
+    unsigned sq_local_tail = 0;
+    /** Number of entries queued but not yet submitted. */
+    unsigned to_submit = 0;
+    /** Features reported by the kernel. */
+    unsigned features = 0;
+
+    /** Unmap the rings and close the instance. */
+    void
+    Release();
+
+    /** Enter the kernel.
+     * @return Number of submitted entries, -1 with errno set on failure.
+     */
+    int
+    Enter(unsigned submit, unsigned min_complete);
+};
+
+} /* namespace internal */
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_IO_URING_H_ */
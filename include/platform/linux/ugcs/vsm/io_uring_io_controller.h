@@ -0,0 +1,109 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file io_uring_io_controller.h
+ */
+#ifndef _UGCS_VSM_IO_URING_IO_CONTROLLER_H_
+#define _UGCS_VSM_IO_URING_IO_CONTROLLER_H_
+
+#include <ugcs/vsm/poll_io_controller.h>
+#include <ugcs/vsm/io_uring.h>
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ugcs {
+namespace vsm {
+namespace internal {
+
+/** I/O controller which submits read and write operations to io_uring
+ * instead of waiting for readiness and doing the transfer in the dispatcher
+ * thread. Positioned operations do not need a separate seek. Used instead of
+ * Poll_io_controller when the kernel supports io_uring.
+ */
+class Io_uring_io_controller: public Poll_io_controller {
+public:
+    Io_uring_io_controller();
+
+    virtual void
+    Enable() override;
+
+    /** Cancel submitted operations and wait until their completions are
+     * reported.
+     */
+    virtual void
+    Disable() override;
+
+    /** Close the descriptor when its submitted operations complete. */
+    virtual void
+    Delete_handle(int fd) override;
+
+    virtual bool
+    Queue_operation(Io_cb &io_cb) override;
+
+    /** Request cancellation of submitted operation. The operation is always
+     * completed by the callback, with ECANCELED error if it was canceled.
+     * @return Always false.
+     */
+    virtual bool
+    Cancel_operation(Io_cb &io_cb) override;
+
+private:
+    /** Submitted operations of a descriptor. */
+    struct File_desc {
+        int num_submitted = 0;
+        bool close_on_complete = false;
+    };
+
+    Io_uring ring;
+    /** Protects everything but the completion ring. */
+    std::mutex mutex;
+    /** Operations submitted and not yet completed. */
+    std::unordered_set<Io_cb *> submitted;
+    /** Operations which returned EAGAIN and wait for descriptor readiness. */
+    std::unordered_set<Io_cb *> polling;
+    /** Operations with requested cancellation. */
+    std::unordered_set<Io_cb *> canceled;
+    /** Set by Disable(), no operations are accepted or resubmitted. */
+    bool disabling = false;
+    /** Descriptors with submitted operations. */
+    std::unordered_map<int, File_desc> fd_map;
+    /** Thread which waits for completions and invokes callbacks. */
+    std::thread completion_thread;
+
+    /** Completion thread function. Exits when quit is requested and all
+     * submitted operations are completed.
+     */
+    void
+    Completion_thread();
+
+    /** Check if all submitted operations are completed. */
+    bool
+    Is_drained();
+
+    /** Submit read or write operation. Mutex should be locked.
+     * @return false on submission failure.
+     */
+    bool
+    Submit_operation(Io_cb &io_cb);
+
+    /** Submit readiness poll for the operation. Mutex should be locked.
+     * @return false on submission failure.
+     */
+    bool
+    Submit_poll(Io_cb &io_cb);
+
+    /** Queue cancellation of the operation or its readiness poll. Mutex
+     * should be locked, the caller submits the queue.
+     */
+    void
+    Submit_cancel(Io_cb &io_cb);
+};
+
+} /* namespace internal */
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_IO_URING_IO_CONTROLLER_H_ */
@@ -0,0 +1,345 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file coroutine.h
+ *
+ * C++20 coroutine adapters for asynchronous SDK operations. Each awaitable
+ * starts the operation with the given completion context and resumes the
+ * coroutine from that context, so the code after co_await runs in the same
+ * thread as a regular completion handler would.
+ * @code
+ * Async_task
+ * My_vehicle::Handshake()
+ * {
+ *     auto conn = co_await Async_connect(Socket_processor::Get_instance(),
+ *                                        addr, completion_ctx);
+ *     if (conn.result != Io_result::OK) {
+ *         co_return;
+ *     }
+ *     co_await Async_write(conn.stream, hello, completion_ctx);
+ *     auto reply = co_await Async_read(conn.stream, 64, 1, completion_ctx);
+ *     co_await Async_sleep(std::chrono::milliseconds(100), completion_ctx);
+ * }
+ * @endcode
+ * The awaited operation holds the coroutine, so the completion context should
+ * stay enabled until the operation completes, otherwise the coroutine is never
+ * resumed. Available only when the compiler supports C++20 coroutines.
+ *
+ * Async_read and Async_write keep the operation result in the awaiter and
+ * pass an inline completion handler referring to it (see
+ * Io_stream::Read_inline()), so no callback object is allocated for a step
+ * on socket streams. Other streams, Async_connect, Async_sleep and
+ * Async_wait still allocate one callback object per co_await.
+ */
+#ifndef _UGCS_VSM_COROUTINE_H_
+#define _UGCS_VSM_COROUTINE_H_
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <ugcs/vsm/socket_processor.h>
+#include <ugcs/vsm/timer_processor.h>
+
+#include <coroutine>
+
+namespace ugcs {
+namespace vsm {
+
+/** Return type for detached coroutines. The coroutine starts immediately
+ * and its frame is destroyed when it finishes. Unhandled exceptions are
+ * logged.
+ */
+class Async_task {
+public:
+    /** Coroutine promise. */
+    struct promise_type {
+        Async_task
+        get_return_object()
+        {
+            return Async_task();
+        }
+
+        std::suspend_never
+        initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never
+        final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void
+        return_void()
+        {}
+
+        void
+        unhandled_exception()
+        {
+            try {
+                throw;
+            } catch (const std::exception &e) {
+                LOG_ERROR("Unhandled exception in coroutine: %s", e.what());
+            } catch (...) {
+                LOG_ERROR("Unhandled exception in coroutine");
+            }
+        }
+    };
+};
+
+/** Result of Async_read(). */
+struct Async_read_result {
+    /** Data read. */
+    Io_buffer::Ptr buffer;
+    /** Operation result. */
+    Io_result result;
+};
+
+/** Result of Async_connect(). */
+struct Async_connect_result {
+    /** Connected stream, valid if result is OK. */
+    Socket_stream::Ref stream;
+    /** Operation result. */
+    Io_result result;
+};
+
+#ifndef NO_DOXYGEN
+namespace coroutine_internal {
+
+/** Common part of awaiters which start an operation on suspension. The
+ * operation waiter is not kept since the coroutine can be resumed and the
+ * awaiter destroyed before the operation start call returns. Completion
+ * handlers refer to the awaiter, so it is not copyable.
+ */
+class Context_awaiter {
+public:
+    Context_awaiter(Request_completion_context::Ptr ctx):
+        ctx(ctx)
+    {
+        if (!ctx) {
+            VSM_EXCEPTION(Nullptr_exception, "Completion context is required");
+        }
+    }
+
+    Context_awaiter(const Context_awaiter &) = delete;
+
+    bool
+    await_ready()
+    {
+        return false;
+    }
+
+    void
+    await_resume()
+    {}
+
+protected:
+    Request_completion_context::Ptr ctx;
+    /** Suspended coroutine. */
+    std::coroutine_handle<> handle;
+};
+
+/** Awaiter which returns the operation result. */
+template <class Result>
+class Awaiter: public Context_awaiter {
+public:
+    using Context_awaiter::Context_awaiter;
+
+    Result
+    await_resume()
+    {
+        return std::move(result);
+    }
+
+protected:
+    Result result;
+};
+
+} /* namespace coroutine_internal */
+#endif
+
+/** Awaitable read from a stream, see Io_stream::Read_inline(). */
+class Async_read: public coroutine_internal::Awaiter<Async_read_result> {
+public:
+    Async_read(Io_stream::Ref stream, size_t max_to_read, size_t min_to_read,
+               Request_completion_context::Ptr ctx):
+        Awaiter(ctx), stream(stream), max_to_read(max_to_read),
+        min_to_read(min_to_read)
+    {}
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        stream->Read_inline(max_to_read, min_to_read, result.buffer, result.result,
+                            Request::Inline_handler([this]() { this->handle.resume(); }),
+                            ctx);
+    }
+
+private:
+    Io_stream::Ref stream;
+    size_t max_to_read, min_to_read;
+};
+
+/** Awaitable write to a stream, see Io_stream::Write_inline(). */
+class Async_write: public coroutine_internal::Awaiter<Io_result> {
+public:
+    Async_write(Io_stream::Ref stream, Io_buffer::Ptr buffer,
+                Request_completion_context::Ptr ctx):
+        Awaiter(ctx), stream(stream), buffer(buffer)
+    {}
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        stream->Write_inline(buffer, result,
+                             Request::Inline_handler([this]() { this->handle.resume(); }),
+                             ctx);
+    }
+
+private:
+    Io_stream::Ref stream;
+    Io_buffer::Ptr buffer;
+};
+
+/** Awaitable socket connection, see Socket_processor::Connect(). */
+class Async_connect: public coroutine_internal::Awaiter<Async_connect_result> {
+public:
+    Async_connect(Socket_processor::Ptr processor, Socket_address::Ptr address,
+                  Request_completion_context::Ptr ctx,
+                  Io_stream::Type sock_type = Io_stream::Type::TCP):
+        Awaiter(ctx), processor(processor), address(address), sock_type(sock_type),
+        handler(Make_socket_connect_callback(
+                [this](Socket_stream::Ref stream, Io_result res)
+                {
+                    result = {stream, res};
+                    handle.resume();
+                }))
+    {}
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        processor->Connect(address, handler, ctx, sock_type);
+    }
+
+private:
+    Socket_processor::Ptr processor;
+    Socket_address::Ptr address;
+    Io_stream::Type sock_type;
+    Socket_processor::Connect_handler handler;
+};
+
+/** Awaitable delay based on Timer_processor. */
+class Async_sleep: public coroutine_internal::Context_awaiter {
+public:
+    Async_sleep(std::chrono::milliseconds delay, Request_completion_context::Ptr ctx):
+        Context_awaiter(ctx), delay(delay),
+        handler(Make_callback(
+                [this]()
+                {
+                    handle.resume();
+                    return false;
+                }))
+    {}
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        Timer_processor::Get_instance()->Create_timer(delay, handler, ctx);
+    }
+
+private:
+    std::chrono::milliseconds delay;
+    Timer_processor::Handler handler;
+};
+
+/** Awaitable completion of an arbitrary operation. The coroutine is resumed
+ * in the given context when the operation is done. If the context is
+ * disabled by that time, the coroutine frame is destroyed without resuming.
+ * Should not be used together with Operation_waiter::Timeout().
+ */
+class Async_wait: public coroutine_internal::Context_awaiter {
+public:
+    Async_wait(Operation_waiter &waiter, Request_completion_context::Ptr ctx):
+        Context_awaiter(ctx), waiter(waiter),
+        handler(Make_callback(
+                [this]()
+                {
+                    auto handle = this->handle;
+                    auto resume_ctx = this->ctx;
+                    if (!resume_ctx->Post([handle]() { handle.resume(); })) {
+                        LOG_WARNING("Context [%s] is disabled, coroutine destroyed.",
+                                    resume_ctx->Get_name().c_str());
+                        handle.destroy();
+                    }
+                }))
+    {}
+
+    bool
+    await_ready()
+    {
+        return waiter.Is_done();
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        waiter.Set_done_handler(handler);
+    }
+
+private:
+    Operation_waiter &waiter;
+    Request::Handler handler;
+};
+
+/** Switch the coroutine to the given context. */
+class Resume_on {
+public:
+    Resume_on(Request_container::Ptr ctx):
+        ctx(ctx)
+    {
+        if (!ctx) {
+            VSM_EXCEPTION(Nullptr_exception, "Context is required");
+        }
+    }
+
+    bool
+    await_ready()
+    {
+        return false;
+    }
+
+    /** @throws Invalid_op_exception if the context is disabled, the
+     * coroutine continues in the current context in this case.
+     */
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        if (!ctx->Post([handle]() { handle.resume(); })) {
+            VSM_EXCEPTION(Invalid_op_exception, "Context [%s] is disabled",
+                          ctx->Get_name().c_str());
+        }
+    }
+
+    void
+    await_resume()
+    {}
+
+private:
+    Request_container::Ptr ctx;
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* _UGCS_VSM_COROUTINE_H_ */
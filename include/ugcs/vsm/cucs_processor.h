@@ -228,8 +228,12 @@ private:
     void
     Close_ucs_stream(size_t stream_id);
 
+    /** Pass current UCS connections of the device to its context.
+     * @param batch Batch to submit the request to, if notifying several
+     *      devices at once.
+     */
     void
-    Notify_device_about_ucs_connections(uint32_t device_id);
+    Notify_device_about_ucs_connections(uint32_t device_id, Request_batch* batch = nullptr);
 
     /** Cucs processor singleton instance. */
     static Singleton<Cucs_processor> singleton;
@@ -0,0 +1,252 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/** @file inline_callback.h
+ * Move-only callback with small-buffer storage. Unlike callbacks created by
+ * Make_callback() it does not need a shared heap object for typical
+ * handlers, so it can be used in hot paths where a callback is created for
+ * each operation.
+ */
+
+#ifndef _UGCS_VSM_INLINE_CALLBACK_H_
+#define _UGCS_VSM_INLINE_CALLBACK_H_
+
+#include <ugcs/vsm/callback.h>
+
+#include <cstddef>
+#include <new>
+
+namespace ugcs {
+namespace vsm {
+
+/** Type-erased move-only callable without arguments. Callable objects which
+ * fit into the inline buffer and have non-throwing move constructor are
+ * stored in place, others are allocated on the heap. Regular callback
+ * pointers (see Callback_base::Ptr) can be stored as well.
+ * @param Result Return value type of the callback execution.
+ * @param inline_size Size of the inline buffer.
+ * @see Make_inline_callback
+ */
+template <typename Result, size_t inline_size = 64>
+class Inline_callback {
+public:
+    /** Result type. */
+    using Result_t = Result;
+
+    /** Construct empty callback. */
+    Inline_callback() = default;
+
+    /** Construct empty callback. */
+    Inline_callback(std::nullptr_t)
+    {}
+
+    /** Construct from any callable object with signature Result(). Explicit
+     * to keep overload resolution with Callback_base::Ptr arguments
+     * unambiguous.
+     */
+    template <class Callable,
+              class = typename std::enable_if<!std::is_same<
+                  typename std::decay<Callable>::type, Inline_callback>::value>::type>
+    explicit
+    Inline_callback(Callable &&callable)
+    {
+        using Type = typename std::decay<Callable>::type;
+        if (Is_empty_ptr(callable)) {
+            return;
+        }
+        if constexpr (Fits_inline<Type>()) {
+            new (storage) Type(std::forward<Callable>(callable));
+            ops = &Inline_ops<Type>::ops;
+        } else {
+            *reinterpret_cast<Type **>(storage) = new Type(std::forward<Callable>(callable));
+            ops = &Heap_ops<Type>::ops;
+        }
+    }
+
+    /** Move constructor. */
+    Inline_callback(Inline_callback &&other) noexcept
+    {
+        Move_from(other);
+    }
+
+    Inline_callback(const Inline_callback &) = delete;
+
+    ~Inline_callback()
+    {
+        Reset();
+    }
+
+    /** Move assignment. */
+    Inline_callback &
+    operator =(Inline_callback &&other) noexcept
+    {
+        if (this != &other) {
+            Reset();
+            Move_from(other);
+        }
+        return *this;
+    }
+
+    /** Release the stored callable. */
+    Inline_callback &
+    operator =(std::nullptr_t)
+    {
+        Reset();
+        return *this;
+    }
+
+    /** Call the stored callable.
+     * @throws Nullptr_exception if the callback is empty.
+     */
+    Result_t
+    operator()()
+    {
+        if (!ops) {
+            VSM_EXCEPTION(Nullptr_exception, "Attempted to invoke empty callback");
+        }
+        return ops->invoke(storage);
+    }
+
+    /** Check if the callback is not empty. */
+    explicit operator bool() const
+    {
+        return ops != nullptr;
+    }
+
+    /** Check if the callable is stored in the inline buffer. */
+    bool
+    Is_inline() const
+    {
+        return ops && ops->is_inline;
+    }
+
+private:
+    /** Operations on the stored callable. */
+    struct Ops {
+        Result_t (*invoke)(void *storage);
+        /** Move-construct into "to" and destroy in "from". */
+        void (*move)(void *from, void *to);
+        void (*destroy)(void *storage);
+        bool is_inline;
+    };
+
+    template <class Type>
+    struct Inline_ops {
+        static Result_t
+        Invoke(void *storage)
+        {
+            return (*static_cast<Type *>(storage))();
+        }
+
+        static void
+        Move(void *from, void *to)
+        {
+            new (to) Type(std::move(*static_cast<Type *>(from)));
+            static_cast<Type *>(from)->~Type();
+        }
+
+        static void
+        Destroy(void *storage)
+        {
+            static_cast<Type *>(storage)->~Type();
+        }
+
+        static constexpr Ops ops = {Invoke, Move, Destroy, true};
+    };
+
+    template <class Type>
+    struct Heap_ops {
+        static Result_t
+        Invoke(void *storage)
+        {
+            return (**static_cast<Type **>(storage))();
+        }
+
+        static void
+        Move(void *from, void *to)
+        {
+            *static_cast<Type **>(to) = *static_cast<Type **>(from);
+        }
+
+        static void
+        Destroy(void *storage)
+        {
+            delete *static_cast<Type **>(storage);
+        }
+
+        static constexpr Ops ops = {Invoke, Move, Destroy, false};
+    };
+
+    alignas(std::max_align_t) unsigned char storage[inline_size];
+    const Ops *ops = nullptr;
+
+    template <class Type>
+    static constexpr bool
+    Fits_inline()
+    {
+        return sizeof(Type) <= inline_size &&
+               alignof(std::max_align_t) % alignof(Type) == 0 &&
+               std::is_nothrow_move_constructible<Type>::value;
+    }
+
+    /** Null callback and function pointers result in empty callback. */
+    template <class Type>
+    static bool
+    Is_empty_ptr(const Type &callable,
+                 typename std::enable_if<std::is_constructible<bool, const Type &>::value>::type * = nullptr)
+    {
+        return !callable;
+    }
+
+    template <class Type>
+    static bool
+    Is_empty_ptr(const Type &,
+                 typename std::enable_if<!std::is_constructible<bool, const Type &>::value>::type * = nullptr)
+    {
+        return false;
+    }
+
+    void
+    Move_from(Inline_callback &other)
+    {
+        if (other.ops) {
+            other.ops->move(other.storage, storage);
+            ops = other.ops;
+            other.ops = nullptr;
+        }
+    }
+
+    void
+    Reset()
+    {
+        if (ops) {
+            auto cur_ops = ops;
+            ops = nullptr;
+            cur_ops->destroy(storage);
+        }
+    }
+};
+
+/** Create an inline callback. Arguments are bound the same way as by
+ * Make_callback(), but the callback object is stored in the returned value
+ * instead of a shared heap object.
+ *
+ * @param callable Any callable object type, or class member function pointer
+ *      followed by the object pointer.
+ * @param args Arguments pack.
+ * @return Callback with user arguments bound.
+ */
+template <class Callable, typename... Args>
+Inline_callback<typename Callback<Callable, void, Args...>::Base_type::Result_t>
+Make_inline_callback(Callable &&callable, Args&& ...args)
+{
+    return Inline_callback<typename Callback<Callable, void, Args...>::Base_type::Result_t>(
+        Callback<Callable, void, Args...>(std::forward<Callable>(callable),
+                                          std::forward<Args>(args)...));
+}
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_INLINE_CALLBACK_H_ */
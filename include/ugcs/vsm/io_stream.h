@@ -237,25 +237,66 @@ public:
             VSM_EXCEPTION(Invalid_param_exception, "Completion handler can not "
                     "exist without completion context and vice versa.");
         }
-        if (min_to_read && max_to_read == 0) {
-            // For UDP and TCP Let's try to read more than required as it can save us some syscalls later.
-            // In UDP case we need to try read the maximum expected size. Otherwise we can get truncated data.
-            switch (stream_type) {
-            case Type::UDP:
-            case Type::UDP_MULTICAST:
-                max_to_read = MIN_UDP_PAYLOAD_SIZE_TO_READ;
-                break;
-            case Type::TCP:
-                max_to_read = MAX_TCP_PAYLOAD_SIZE_TO_READ;
-                break;
-            default:
-                max_to_read = min_to_read;
-                break;
-            }
-        } else if (max_to_read < min_to_read) {
-            VSM_EXCEPTION(Invalid_param_exception, "max_to_read cannot be less than min_to_read");
+        return Read_impl(Get_max_to_read(max_to_read, min_to_read), min_to_read,
+                         OFFSET_NONE, completion_handler, comp_ctx);
+    }
+
+    /** Initiate write operation with inline completion handler. The result
+     * is stored to the given variable before the handler is invoked, so no
+     * callback object is created for the handler arguments. Suits adapters
+     * which start an operation per step, e.g. coroutine awaiters. Socket
+     * streams support it natively, other streams wrap the handler into a
+     * regular callback.
+     * @param buffer Buffer with data to write.
+     * @param result_arg Variable for the operation result, should stay
+     *      valid until the handler is invoked.
+     * @param completion_handler Handler to invoke when the operation is
+     *      completed.
+     * @param comp_ctx Completion context for the operation.
+     * @return Waiter object which can be used for synchronization and control.
+     * @throw Invalid_param_exception If handler or context is not set.
+     */
+    Operation_waiter
+    Write_inline(Io_buffer::Ptr buffer, Io_result &result_arg,
+                 Request::Inline_handler &&completion_handler,
+                 Request_completion_context::Ptr comp_ctx)
+    {
+        if (!completion_handler || !comp_ctx) {
+            VSM_EXCEPTION(Invalid_param_exception, "Completion handler and "
+                    "context are required.");
         }
-        return Read_impl(max_to_read, min_to_read, OFFSET_NONE, completion_handler, comp_ctx);
+        return Write_inline_impl(buffer, OFFSET_NONE, result_arg,
+                                 std::move(completion_handler), comp_ctx);
+    }
+
+    /** Initiate read operation with inline completion handler, see
+     * Write_inline().
+     * @param max_to_read Maximal number of bytes to read from the stream,
+     *      see Read() for zero value.
+     * @param min_to_read Minimal number of bytes to read from the stream.
+     * @param buffer_arg Variable for the data read, should stay valid until
+     *      the handler is invoked.
+     * @param result_arg Variable for the operation result, the same.
+     * @param completion_handler Handler to invoke when the operation is
+     *      completed.
+     * @param comp_ctx Completion context for the operation.
+     * @return Waiter object which can be used for synchronization and control.
+     * @throw Invalid_param_exception If handler or context is not set.
+     * @throw Invalid_param_exception If Max to read is less then Min to read.
+     */
+    Operation_waiter
+    Read_inline(size_t max_to_read, size_t min_to_read,
+                Io_buffer::Ptr &buffer_arg, Io_result &result_arg,
+                Request::Inline_handler &&completion_handler,
+                Request_completion_context::Ptr comp_ctx)
+    {
+        if (!completion_handler || !comp_ctx) {
+            VSM_EXCEPTION(Invalid_param_exception, "Completion handler and "
+                    "context are required.");
+        }
+        return Read_inline_impl(Get_max_to_read(max_to_read, min_to_read),
+                                min_to_read, OFFSET_NONE, buffer_arg, result_arg,
+                                std::move(completion_handler), comp_ctx);
     }
 
     /** Initiate stream close operation.
@@ -354,6 +395,25 @@ protected:
               Read_handler completion_handler,
               Request_completion_context::Ptr comp_ctx) = 0;
 
+    /** Write_inline() call implementation. Default one wraps the handler
+     * into a regular callback and calls Write_impl().
+     * @see Write_inline
+     */
+    virtual Operation_waiter
+    Write_inline_impl(Io_buffer::Ptr buffer, Offset offset, Io_result &result_arg,
+                      Request::Inline_handler &&completion_handler,
+                      Request_completion_context::Ptr comp_ctx);
+
+    /** Read_inline() call implementation. Default one wraps the handler
+     * into a regular callback and calls Read_impl().
+     * @see Read_inline
+     */
+    virtual Operation_waiter
+    Read_inline_impl(size_t max_to_read, size_t min_to_read, Offset offset,
+                     Io_buffer::Ptr &buffer_arg, Io_result &result_arg,
+                     Request::Inline_handler &&completion_handler,
+                     Request_completion_context::Ptr comp_ctx);
+
     /** Close call implementation.
      * @param completion_handler Completion handler.
      * @param comp_ctx Completion context.
@@ -370,6 +430,30 @@ protected:
     Set_name(const std::string&);
 
 private:
+    /** Resolve zero max_to_read of a read call according to the stream type.
+     * @throw Invalid_param_exception If Max to read is less then Min to read.
+     */
+    size_t
+    Get_max_to_read(size_t max_to_read, size_t min_to_read) const
+    {
+        if (min_to_read && max_to_read == 0) {
+            // For UDP and TCP Let's try to read more than required as it can save us some syscalls later.
+            // In UDP case we need to try read the maximum expected size. Otherwise we can get truncated data.
+            switch (stream_type) {
+            case Type::UDP:
+            case Type::UDP_MULTICAST:
+                return MIN_UDP_PAYLOAD_SIZE_TO_READ;
+            case Type::TCP:
+                return MAX_TCP_PAYLOAD_SIZE_TO_READ;
+            default:
+                return min_to_read;
+            }
+        } else if (max_to_read < min_to_read) {
+            VSM_EXCEPTION(Invalid_param_exception, "max_to_read cannot be less than min_to_read");
+        }
+        return max_to_read;
+    }
+
     /** Name mutex, global for all streams, because operations with name
      * are rare.
      */
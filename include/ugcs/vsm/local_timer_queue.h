@@ -0,0 +1,138 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file local_timer_queue.h
+ *
+ * Timers processed by the thread which owns them.
+ */
+
+#ifndef _UGCS_VSM_LOCAL_TIMER_QUEUE_H_
+#define _UGCS_VSM_LOCAL_TIMER_QUEUE_H_
+
+#include <ugcs/vsm/callback.h>
+#include <ugcs/vsm/utils.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace ugcs {
+namespace vsm {
+
+/** Queue of timers which are fired by the thread calling Process_timers(),
+ * usually a worker thread which uses the nearest fire time as its wait
+ * deadline (see Request_worker::Create_timer()). Unlike Timer_processor
+ * timers, handlers are invoked directly without requests and without
+ * crossing threads.
+ */
+class Local_timer_queue: public std::enable_shared_from_this<Local_timer_queue> {
+    DEFINE_COMMON_CLASS(Local_timer_queue, Local_timer_queue)
+
+public:
+    /** Timer handler. It should return boolean value with the following
+     * meanings:
+     * false - stop the timer, i.e. do not perform further invocations;
+     * true - re-schedule next invocation after the initial interval.
+     */
+    typedef Callback_proxy<bool> Handler;
+
+    /** Represents timer instance. */
+    class Timer: public std::enable_shared_from_this<Timer> {
+        DEFINE_COMMON_CLASS(Timer, Timer)
+
+    public:
+        /** Construct timer instance associated with a queue. */
+        Timer(const Local_timer_queue::Ptr &queue,
+              std::chrono::microseconds interval, const Handler &handler);
+
+        /** Cancel running timer. Do nothing if timer is not running. If
+         * canceled from another thread while the handler is being invoked,
+         * the timer is not re-scheduled.
+         */
+        void
+        Cancel();
+
+        /** Check if the timer still is running - i.e. will produce handler
+         * invocations.
+         */
+        bool
+        Is_running() const;
+
+        /** Get time of next timer firing. */
+        std::chrono::steady_clock::time_point
+        Get_fire_time() const;
+
+    private:
+        friend class Local_timer_queue;
+
+        /** Related queue. */
+        const std::weak_ptr<Local_timer_queue> queue;
+        /** Indicates that timer is currently running. */
+        bool is_running = true;
+        /** Timer interval. */
+        std::chrono::microseconds interval;
+        /** Time when the timer should be fired next time. */
+        std::chrono::steady_clock::time_point fire_time;
+        /** Timer handler. */
+        Handler handler;
+        /** Position in the queue, valid if is_queued. */
+        std::multimap<std::chrono::steady_clock::time_point, Ptr>::iterator pos;
+        /** Timer is in the queue, i.e. not being fired. */
+        bool is_queued = false;
+    };
+
+    /** Create and schedule the timer. First time it is fired after the
+     * specified interval, it is re-scheduled while the handler returns true.
+     * Can be called from any thread, but the caller is responsible for
+     * waking the processing thread up if the new timer is the nearest one.
+     *
+     * @param interval Timer interval.
+     * @param handler Handler to invoke, should be non-empty.
+     * @return Timer object which can be used to cancel running timer.
+     * @throw Invalid_param_exception if handler is not set.
+     */
+    Timer::Ptr
+    Create_timer(std::chrono::microseconds interval, const Handler &handler);
+
+    /** Cancel the specified timer in case it is running. */
+    void
+    Cancel_timer(const Timer::Ptr &timer);
+
+    /** Fire expired timers invoking their handlers in the calling thread.
+     * @return Delay until the next timer expiration, at least one
+     *      microsecond, or zero if there are no timers.
+     */
+    std::chrono::microseconds
+    Process_timers();
+
+    /** Cancel all timers. Should not be called while timers are processed. */
+    void
+    Clear();
+
+    /** Get number of running timers. */
+    size_t
+    Get_size() const;
+
+private:
+    typedef std::multimap<std::chrono::steady_clock::time_point, Timer::Ptr> Timers;
+
+    /** Timers ordered by fire time. */
+    Timers timers;
+    /** Number of timers being fired, i.e. running but not in the map. */
+    size_t num_firing = 0;
+    /** Protects timers and their state, contended only by other threads
+     * creating or canceling timers.
+     */
+    mutable std::mutex mutex;
+
+    /** Put the timer to the map. Mutex should be held. */
+    void
+    Queue_timer(const Timer::Ptr &timer);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_LOCAL_TIMER_QUEUE_H_ */
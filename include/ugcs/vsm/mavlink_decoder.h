@@ -10,6 +10,8 @@
 #include <ugcs/vsm/callback.h>
 #include <ugcs/vsm/mavlink.h>
 
+#include <bitset>
+#include <cstring>
 #include <unordered_map>
 
 #ifndef _UGCS_VSM_MAVLINK_DECODER_H_
@@ -53,6 +55,32 @@ public:
     /** Convenience builder for raw data handlers. */
     DEFINE_CALLBACK_BUILDER(Make_raw_data_handler, (Io_buffer::Ptr), (nullptr))
 
+    /** Handler for complete frames which passed checksum and length
+     * validation. The buffer contains the whole frame starting with the start
+     * sign and ending with the checksum.
+     */
+    typedef Callback_proxy<void, Io_buffer::Ptr> Frame_handler;
+
+    /** Convenience builder for frame handlers. */
+    DEFINE_CALLBACK_BUILDER(Make_frame_handler, (Io_buffer::Ptr), (nullptr))
+
+    /** Handler for link quality updates. Arguments are:
+     * - Sending system id
+     * - Sending component id
+     * - Link quality in range [0..1], i.e. fraction of messages received
+     *   in the last completed window of @ref LINK_QUALITY_WINDOW messages.
+     */
+    typedef Callback_proxy<void, uint8_t, uint8_t, float> Link_quality_handler;
+
+    /** Convenience builder for link quality handlers. */
+    DEFINE_CALLBACK_BUILDER(Make_link_quality_handler, (uint8_t, uint8_t, float),
+            (mavlink::SYSTEM_ID_NONE, 0, 0))
+
+    /** Number of expected messages in one link quality window. Quality is
+     * reported once per window.
+     */
+    static constexpr uint32_t LINK_QUALITY_WINDOW = 100;
+
     /** Decoder statistics. */
     struct Stats {
         /** Messages processed by registered handler. Total and per system_id. */
@@ -72,6 +100,12 @@ public:
         /** Number of STX bytes found during decoding, i.e. how many times packet
          * decode was tried to be started. Only total for the connection is counted. */
         uint64_t stx_syncs = 0;
+        /** Messages lost according to sequence numbers. Total and per system_id. */
+        uint64_t seq_lost = 0;
+        /** Messages received with the same sequence number twice. Total and per system_id. */
+        uint64_t seq_duplicates = 0;
+        /** Messages received out of order. They are not counted as lost. Total and per system_id. */
+        uint64_t seq_reordered = 0;
     };
 
     enum class MavlinkVersion {
@@ -95,6 +129,8 @@ public:
     {
         handler = Handler();
         data_handler = Raw_data_handler();
+        frame_handler = Frame_handler();
+        link_quality_handler = Link_quality_handler();
     }
 
     /**
@@ -112,6 +148,26 @@ public:
         data_handler = handler;
     }
 
+    /** Register handler for validated frames, e.g. for traffic capture. It is
+     * called from the decoding context before the message handler.
+     */
+    void
+    Register_frame_handler(Frame_handler handler)
+    {
+        frame_handler = handler;
+    }
+
+    /** Register handler for link quality updates. It is called from the
+     * decoding context once per @ref LINK_QUALITY_WINDOW expected messages of
+     * each system and component, so it is cheap enough to update the
+     * telemetry directly, e.g. Vehicle::t_gcs_link_quality.
+     */
+    void
+    Register_link_quality_handler(Link_quality_handler handler)
+    {
+        link_quality_handler = handler;
+    }
+
     /** Decode buffer from the wire. */
     void
     Decode(Io_buffer::Ptr buffer)
@@ -227,12 +283,133 @@ public:
         return stats[mavlink::SYSTEM_ID_ANY];
     }
 
+    /** Get current link quality calculated from message sequence numbers.
+     * @param system_id System id of the sender.
+     * @param component_id Component id of the sender, or
+     *      mavlink::MAV_COMP_ID_ALL for all components of the system.
+     * @return Fraction of messages received in the current and previous
+     *      windows in range [0..1], or -1 if nothing was received from the
+     *      sender yet.
+     */
+    float
+    Get_link_quality(uint8_t system_id, uint8_t component_id = mavlink::MAV_COMP_ID_ALL)
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        uint32_t received = 0, lost = 0;
+        for (auto& iter : seq_trackers) {
+            if ((iter.first >> 8) == system_id &&
+                (component_id == mavlink::MAV_COMP_ID_ALL ||
+                 (iter.first & 0xff) == component_id)) {
+                received += iter.second.received + iter.second.prev_received;
+                lost += iter.second.lost + iter.second.prev_lost;
+            }
+        }
+        if (!received) {
+            return -1;
+        }
+        return static_cast<float>(received) / (received + lost);
+    }
+
     MavlinkVersion
     Get_mavlink_version() const {
         return mavlink_version;
     }
 
 private:
+    /** Maximal distance behind the last received sequence number for a
+     * message to be considered late or duplicated. Messages further behind
+     * resynchronize the tracker.
+     */
+    static constexpr uint8_t SEQ_REORDER_WINDOW = 64;
+
+    /** Sequence number tracking state of one system and component. */
+    struct Seq_tracker {
+        /** Last (highest) received sequence number. */
+        uint8_t last_seq;
+        /** Sequence numbers received during the last lap. */
+        std::bitset<256> seen;
+        /** Received and lost messages in the current window. */
+        uint32_t received = 0, lost = 0;
+        /** Received and lost messages in the previous window. */
+        uint32_t prev_received = 0, prev_lost = 0;
+    };
+
+    /** Account message sequence number. Should be called with stats mutex
+     * locked.
+     * @return true if link quality window is completed for the sender.
+     */
+    bool
+    Track_seq(uint8_t system_id, uint8_t component_id, uint8_t seq)
+    {
+        auto inserted = seq_trackers.emplace((system_id << 8) | component_id, Seq_tracker());
+        auto& t = inserted.first->second;
+        auto& sys_stats = stats[system_id];
+        auto& total_stats = stats[mavlink::SYSTEM_ID_ANY];
+        if (inserted.second) {
+            t.last_seq = seq;
+            t.seen.set(seq);
+            t.received++;
+            return false;
+        }
+        uint8_t ahead = seq - t.last_seq;
+        if (ahead && ahead < 128) {
+            /* New message, all skipped ones are lost so far. */
+            for (uint8_t s = t.last_seq + 1; s != seq; s++) {
+                t.seen.reset(s);
+            }
+            t.seen.set(seq);
+            t.last_seq = seq;
+            t.received++;
+            t.lost += ahead - 1;
+            sys_stats.seq_lost += ahead - 1;
+            total_stats.seq_lost += ahead - 1;
+        } else if (static_cast<uint8_t>(t.last_seq - seq) > SEQ_REORDER_WINDOW) {
+            /* Too far from the last seen number to be a late message, the
+             * sender most probably restarted. Resynchronize, the gap is not
+             * a loss.
+             */
+            t.seen.reset();
+            t.seen.set(seq);
+            t.last_seq = seq;
+            t.received++;
+        } else if (t.seen.test(seq)) {
+            sys_stats.seq_duplicates++;
+            total_stats.seq_duplicates++;
+            return false;
+        } else {
+            /* Late message which was accounted as lost. */
+            t.seen.set(seq);
+            t.received++;
+            if (t.lost) {
+                t.lost--;
+            }
+            if (sys_stats.seq_lost) {
+                sys_stats.seq_lost--;
+                total_stats.seq_lost--;
+            }
+            sys_stats.seq_reordered++;
+            total_stats.seq_reordered++;
+        }
+        if (t.received + t.lost < LINK_QUALITY_WINDOW) {
+            return false;
+        }
+        t.prev_received = t.received;
+        t.prev_lost = t.lost;
+        t.received = 0;
+        t.lost = 0;
+        return true;
+    }
+
+    /** Restore the start sign stripped from the packet and copy the frame. */
+    Io_buffer::Ptr
+    Make_frame(Io_buffer::Ptr packet, size_t packet_len)
+    {
+        std::vector<uint8_t> frame(packet_len + 1);
+        frame[0] = state == State::VER2 ? mavlink::START_SIGN2 : mavlink::START_SIGN;
+        memcpy(frame.data() + 1, packet->Get_data(), packet_len);
+        return Io_buffer::Create(std::move(frame));
+    }
+
     bool
     Decode_packet(Io_buffer::Ptr buffer)
     {
@@ -299,6 +476,21 @@ private:
             /*
              * Fully valid packet received.
              */
+            if (Track_seq(system_id, component_id, seq) && link_quality_handler) {
+                auto quality_handler = link_quality_handler;
+                auto& t = seq_trackers[(system_id << 8) | component_id];
+                float quality = static_cast<float>(t.prev_received) /
+                        (t.prev_received + t.prev_lost);
+                stats_lock.unlock();
+                quality_handler(system_id, component_id, quality);
+                stats_lock.lock();
+            }
+            if (frame_handler) {
+                auto frame_handler_tmp = frame_handler;
+                stats_lock.unlock();
+                frame_handler_tmp(Make_frame(buffer, header_len + payload_len + 2));
+                stats_lock.lock();
+            }
             if (handler) {
                 stats[system_id].handled++;
                 stats[mavlink::SYSTEM_ID_ANY].handled++;
@@ -336,10 +528,19 @@ private:
     /** Raw data handler. */
     Raw_data_handler data_handler;
 
+    /** Validated frames handler. */
+    Frame_handler frame_handler;
+
     /** Statistics. */
     std::unordered_map<int, Stats> stats;
     std::mutex stats_mutex;
 
+    /** Sequence trackers, key is (system_id << 8) | component_id. */
+    std::unordered_map<int, Seq_tracker> seq_trackers;
+
+    /** Link quality handler. */
+    Link_quality_handler link_quality_handler;
+
     /** Packet buffer. */
     ugcs::vsm::Io_buffer::Ptr packet_buf;
 
@@ -165,6 +165,8 @@ public:
      * @param processor If given, specifies request processor in which context
      * the handler should be executed, otherwise handler is executed from the
      * thread which calls @ref Demux method.
+     * @param priority Priority class of the handler invocations posted to the
+     * processor, e.g. Request::Priority::LOW for bulk transfers.
      * @return Valid registration key which can be used to unregister the
      * handler later.
      */
@@ -174,10 +176,11 @@ public:
             Handler<message_id, Extention_type> handler,
             System_id system_id = SYSTEM_ID_ANY,
             Component_id component_id = COMPONENT_ID_ANY,
-            Request_processor::Ptr processor = nullptr)
+            Request_processor::Ptr processor = nullptr,
+            Request::Priority priority = Request::Priority::NORMAL)
     {
         auto callback = Callback<message_id, Extention_type>::Create(
-                handler, processor);
+                handler, processor, priority);
         Key key(message_id, system_id, component_id);
         key.Generate_id();
         std::unique_lock<std::mutex> lock(mutex);
@@ -225,8 +228,8 @@ private:
     class Callback_base: public std::enable_shared_from_this<Callback_base> {
         DEFINE_COMMON_CLASS(Callback_base, Callback_base)
     public:
-        Callback_base(Request_processor::Ptr processor) :
-            processor(processor) {}
+        Callback_base(Request_processor::Ptr processor, Request::Priority priority) :
+            processor(processor), priority(priority) {}
 
         virtual
         ~Callback_base()
@@ -239,6 +242,9 @@ private:
     protected:
         /** Optional request processor for a handler (may be nullptr). */
         Request_processor::Ptr processor;
+
+        /** Priority class of the invocations posted to the processor. */
+        Request::Priority priority;
     };
 
     /** Callback for specific Mavlink message with necessary payload building. */
@@ -251,8 +257,9 @@ private:
         using Message_type = mavlink::Message<message_id, Extention_type>;
 
         Callback(Handler<message_id, Extention_type> handler,
-                Request_processor::Ptr processor):
-            Callback_base(processor),
+                Request_processor::Ptr processor,
+                Request::Priority priority):
+            Callback_base(processor, priority),
             handler(handler)
         {}
 
@@ -264,11 +271,20 @@ private:
                     Message_type::Create(system_id, component_id, request_id, buffer);
             if (processor) {
                 /* Callback will be invoked from processor context. */
-                auto request = Request::Create();
-                request->Set_processing_handler(Make_callback(&Callback::Invoke,
-                        Shared_from_this(), std::move(message), request));
-                processor->Submit_request(std::move(request));
-
+                bool posted = processor->Post(
+                    [self = Shared_from_this(), message = std::move(message)]()
+                    {
+                        self->Invoke(message);
+                    }, priority);
+                if (!posted) {
+                    if (!processor->Is_enabled()) {
+                        VSM_EXCEPTION(Internal_error_exception,
+                                "Mavlink message %d is posted to disabled processor [%s].",
+                                message_id, processor->Get_name().c_str());
+                    }
+                    LOG_DEBUG("Mavlink message %d dropped, processor [%s] queue is full.",
+                              message_id, processor->Get_name().c_str());
+                }
             } else {
                 /* Invoke from the calling thread. */
                 handler(message);
@@ -281,12 +297,9 @@ private:
 
         /** Invoke the handler. */
         void
-        Invoke(typename Message_type::Ptr message, Request::Ptr request)
+        Invoke(typename Message_type::Ptr message)
         {
             handler(message);
-            if (request) {
-                request->Complete();
-            }
         }
     };
 
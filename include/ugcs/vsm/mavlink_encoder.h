@@ -105,6 +105,16 @@ public:
         return Io_buffer::Create(std::move(data));
     }
 
+    /** Take the next sequence number for a frame which is not produced by
+     * this encoder, e.g. a cached one, so that all frames sent over the
+     * same link share one sequence.
+     */
+    uint8_t
+    Take_seq()
+    {
+        return seq++;
+    }
+
 private:
     /** Current sequence number. */
     uint8_t seq = 0;
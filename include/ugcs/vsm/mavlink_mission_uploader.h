@@ -0,0 +1,255 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mavlink_mission_uploader.h
+ *
+ * Mission upload engine for Mavlink mission protocol.
+ */
+#ifndef _UGCS_VSM_MAVLINK_MISSION_UPLOADER_H_
+#define _UGCS_VSM_MAVLINK_MISSION_UPLOADER_H_
+
+#include <ugcs/vsm/mavlink_stream.h>
+#include <ugcs/vsm/timer_processor.h>
+
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Uploads a list of MISSION_ITEM_INT items to the vehicle over a Mavlink
+ * stream. All items are encoded once into a single buffer when the item list
+ * is set, so MISSION_REQUEST_INT (and legacy MISSION_REQUEST) messages are
+ * answered by slices of that buffer without any per-request encoding.
+ *
+ * Item sending can be pipelined: when the vehicle requests item N, items up to
+ * N + window - 1 which were not yet sent are sent right away. Retries and
+ * timeouts are driven by a single periodic timer per upload.
+ *
+ * Mission items are built by the VSM from the task actions, because
+ * command mapping is autopilot specific. The engine fills seq, target
+ * and mission_type fields itself.
+ *
+ * All handlers are invoked from the contexts given to the constructor.
+ * Progress can be forwarded to the UCS from a vehicle like this:
+ * @code
+ * uploader->Upload(
+ *     Mavlink_mission_uploader::Make_completion_handler(
+ *         &My_vehicle::On_upload_done, Shared_from_this(), ucs_request),
+ *     Mavlink_mission_uploader::Make_progress_handler(
+ *         [this, ucs_request](float progress)
+ *         {
+ *             Report_progress(ucs_request, progress, "Uploading mission");
+ *         }));
+ * @endcode
+ */
+class Mavlink_mission_uploader:
+    public std::enable_shared_from_this<Mavlink_mission_uploader> {
+
+    DEFINE_COMMON_CLASS(Mavlink_mission_uploader, Mavlink_mission_uploader)
+
+public:
+    /** Upload result. */
+    enum class Result {
+        /** Vehicle accepted the mission. */
+        OK,
+        /** Vehicle answered with negative MISSION_ACK. */
+        REJECTED,
+        /** Vehicle stopped responding and retries are exhausted. */
+        TIMED_OUT,
+        /** Upload canceled by @ref Cancel call. */
+        CANCELED
+    };
+
+    /** Completion handler. Arguments are upload result and mission result
+     * code from vehicle MISSION_ACK (meaningful for OK and REJECTED results
+     * only).
+     */
+    typedef Callback_proxy<void, Result, mavlink::MAV_MISSION_RESULT> Completion_handler;
+
+    /** Progress handler. Argument is upload progress in range [0..1]. */
+    typedef Callback_proxy<void, float> Progress_handler;
+
+    /** Convenience builder for completion handlers. */
+    DEFINE_CALLBACK_BUILDER(Make_completion_handler,
+            (Result, mavlink::MAV_MISSION_RESULT),
+            (Result::CANCELED, mavlink::MAV_MISSION_ERROR))
+
+    /** Convenience builder for progress handlers. */
+    DEFINE_CALLBACK_BUILDER(Make_progress_handler, (float), (0))
+
+    /** Default time to wait for the vehicle response before retry. */
+    static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT =
+            std::chrono::milliseconds(1500);
+
+    /** Default number of retries of the same step. */
+    static constexpr int DEFAULT_MAX_RETRIES = 5;
+
+    /** Construct uploader.
+     * @param stream Mavlink stream connected to the vehicle. Decoder and
+     *      demuxer should be bound.
+     * @param system_id System id of this GCS.
+     * @param component_id Component id of this GCS.
+     * @param target_system System id of the vehicle.
+     * @param target_component Component id of the vehicle autopilot.
+     * @param processor Context for Mavlink message handlers, they run in
+     *      Request::Priority::LOW class there.
+     * @param completion_ctx Context for timer and write completions.
+     */
+    Mavlink_mission_uploader(
+            Mavlink_stream::Ptr stream,
+            uint8_t system_id,
+            uint8_t component_id,
+            uint8_t target_system,
+            uint8_t target_component,
+            Request_processor::Ptr processor,
+            Request_completion_context::Ptr completion_ctx);
+
+    /** Set items to upload and encode them. Seq, target system, target
+     * component and mission type fields are overwritten.
+     * @throws Invalid_op_exception if upload is in progress.
+     */
+    void
+    Set_items(
+            std::vector<mavlink::Pld_mission_item_int> items,
+            mavlink::MAV_MISSION_TYPE mission_type = mavlink::MAV_MISSION_TYPE_MISSION);
+
+    /** Get number of items to upload. */
+    size_t
+    Get_item_count() const
+    {
+        return item_frames.size();
+    }
+
+    /** Set number of items which are sent ahead in response to one request.
+     * Value 1 (the default) is the plain request-response protocol.
+     */
+    void
+    Set_window(size_t window);
+
+    /** Set vehicle response timeout and number of retries per step. */
+    void
+    Set_timeout(std::chrono::milliseconds timeout, int max_retries = DEFAULT_MAX_RETRIES);
+
+    /** Start upload of previously set items.
+     * @param completion_handler Called once when upload is finished.
+     * @param progress_handler Optional, called each time upload advances.
+     * @throws Invalid_op_exception if upload is already in progress.
+     */
+    void
+    Upload(Completion_handler completion_handler,
+           Progress_handler progress_handler = Progress_handler());
+
+    /** Cancel ongoing upload. Completion handler is called with CANCELED
+     * result. Does nothing if upload is not active.
+     */
+    void
+    Cancel();
+
+    /** Check if upload is in progress. */
+    bool
+    Is_active() const;
+
+private:
+    /** Offset and length of one encoded item frame in frames buffer. */
+    typedef std::pair<size_t, size_t> Frame_location;
+
+    /** Stream to the vehicle. */
+    Mavlink_stream::Ptr stream;
+
+    /** GCS identity. */
+    uint8_t system_id, component_id;
+
+    /** Vehicle identity. */
+    uint8_t target_system, target_component;
+
+    /** Contexts. */
+    Request_processor::Ptr processor;
+    Request_completion_context::Ptr completion_ctx;
+
+    /** Mission type of the items. */
+    mavlink::MAV_MISSION_TYPE mission_type = mavlink::MAV_MISSION_TYPE_MISSION;
+
+    /** All item frames, encoded back to back. */
+    Io_buffer::Ptr frames;
+
+    /** Location of each item frame in frames buffer, indexed by seq. */
+    std::vector<Frame_location> item_frames;
+
+    /** Send-ahead window. */
+    size_t window = 1;
+
+    /** Response timeout. */
+    std::chrono::milliseconds timeout = DEFAULT_TIMEOUT;
+
+    /** Maximal retries of the same step. */
+    int max_retries = DEFAULT_MAX_RETRIES;
+
+    /** Protects upload state below. */
+    mutable std::mutex mutex;
+
+    /** Upload is in progress. */
+    bool active = false;
+
+    /** Vehicle has requested at least one item. */
+    bool requested = false;
+
+    /** Last requested item. */
+    size_t requested_seq = 0;
+
+    /** Number of items sent at least once. */
+    size_t sent_count = 0;
+
+    /** Retries done for the current step. */
+    int retries = 0;
+
+    /** Last time the vehicle showed progress. */
+    std::chrono::steady_clock::time_point last_activity;
+
+    /** Retry timer. */
+    Timer_processor::Timer::Ptr timer;
+
+    /** Handler registration keys. */
+    Mavlink_demuxer::Key request_int_key, request_key, ack_key;
+
+    Completion_handler completion_handler;
+    Progress_handler progress_handler;
+
+    /** Send MISSION_COUNT. */
+    void
+    Send_count();
+
+    /** Send one pre-encoded item. */
+    void
+    Send_item(size_t seq);
+
+    /** Handle item request from the vehicle. */
+    void
+    On_item_request(size_t seq, uint8_t type);
+
+    void
+    On_mission_request_int(mavlink::Message<mavlink::MESSAGE_ID::MISSION_REQUEST_INT>::Ptr message);
+
+    void
+    On_mission_request(mavlink::Message<mavlink::MESSAGE_ID::MISSION_REQUEST>::Ptr message);
+
+    void
+    On_mission_ack(mavlink::Message<mavlink::MESSAGE_ID::MISSION_ACK>::Ptr message);
+
+    /** Retry timer handler. */
+    bool
+    On_timer();
+
+    /** Finish upload with the given result. Should be called with mutex
+     * locked, it is released inside.
+     */
+    void
+    Finish(std::unique_lock<std::mutex>& lock, Result result,
+           mavlink::MAV_MISSION_RESULT mission_result);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MAVLINK_MISSION_UPLOADER_H_ */
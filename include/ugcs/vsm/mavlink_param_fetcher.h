@@ -0,0 +1,286 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mavlink_param_fetcher.h
+ *
+ * Bulk parameters fetching for Mavlink parameter protocol.
+ */
+#ifndef _UGCS_VSM_MAVLINK_PARAM_FETCHER_H_
+#define _UGCS_VSM_MAVLINK_PARAM_FETCHER_H_
+
+#include <ugcs/vsm/mavlink_stream.h>
+#include <ugcs/vsm/timer_processor.h>
+
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Fetches the full list of vehicle parameters over a Mavlink stream.
+ *
+ * The list is requested by PARAM_REQUEST_LIST and received indices are
+ * tracked in a bitmap. When the stream stalls, only the missing indices are
+ * re-requested by PARAM_REQUEST_READ, in batches. Retries and timeouts are
+ * driven by a single periodic timer per fetch.
+ *
+ * If cache directory is set, the vehicle is first asked for its "_HASH_CHECK"
+ * pseudo-parameter (PARAM_HASH). If the cache file for that hash exists, the
+ * parameters are loaded from it without fetching the list. Otherwise the list
+ * is fetched and stored in the cache under the vehicle reported hash. Vehicles
+ * which do not answer the hash request are fetched as usual.
+ *
+ * All handlers are invoked from the contexts given to the constructor.
+ */
+class Mavlink_param_fetcher:
+    public std::enable_shared_from_this<Mavlink_param_fetcher> {
+
+    DEFINE_COMMON_CLASS(Mavlink_param_fetcher, Mavlink_param_fetcher)
+
+public:
+    /** Fetch result. */
+    enum class Result {
+        /** All parameters received. */
+        OK,
+        /** Vehicle stopped responding and retries are exhausted. Parameters
+         * received so far are still available.
+         */
+        TIMED_OUT,
+        /** Fetch canceled by @ref Cancel call. */
+        CANCELED
+    };
+
+    /** One onboard parameter. */
+    struct Param {
+        /** Parameter index on the vehicle. */
+        uint16_t index;
+        /** Parameter name. */
+        std::string name;
+        /** Value as received in PARAM_VALUE. */
+        float value;
+        /** Value type, one of mavlink::MAV_PARAM_TYPE. */
+        uint8_t type;
+    };
+
+    /** Completion handler. */
+    typedef Callback_proxy<void, Result> Completion_handler;
+
+    /** Progress handler. Argument is fetch progress in range [0..1]. */
+    typedef Callback_proxy<void, float> Progress_handler;
+
+    /** Convenience builder for completion handlers. */
+    DEFINE_CALLBACK_BUILDER(Make_completion_handler, (Result), (Result::CANCELED))
+
+    /** Convenience builder for progress handlers. */
+    DEFINE_CALLBACK_BUILDER(Make_progress_handler, (float), (0))
+
+    /** Name of the pseudo-parameter carrying parameters hash. */
+    static constexpr const char* HASH_PARAM_NAME = "_HASH_CHECK";
+
+    /** Default time of the stream silence before gaps are re-requested. */
+    static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT =
+            std::chrono::milliseconds(1000);
+
+    /** Default number of retries without progress. */
+    static constexpr int DEFAULT_MAX_RETRIES = 5;
+
+    /** Default number of missing parameters requested at once. */
+    static constexpr size_t DEFAULT_BATCH_SIZE = 10;
+
+    /** Construct fetcher.
+     * @param stream Mavlink stream connected to the vehicle. Decoder and
+     *      demuxer should be bound.
+     * @param system_id System id of this GCS.
+     * @param component_id Component id of this GCS.
+     * @param target_system System id of the vehicle.
+     * @param target_component Component id which parameters are fetched.
+     * @param processor Context for Mavlink message handlers, they run in
+     *      Request::Priority::LOW class there.
+     * @param completion_ctx Context for timer and write completions.
+     */
+    Mavlink_param_fetcher(
+            Mavlink_stream::Ptr stream,
+            uint8_t system_id,
+            uint8_t component_id,
+            uint8_t target_system,
+            uint8_t target_component,
+            Request_processor::Ptr processor,
+            Request_completion_context::Ptr completion_ctx);
+
+    /** Set directory for parameter cache files. Empty string (the default)
+     * disables caching.
+     */
+    void
+    Set_cache_dir(const std::string& dir);
+
+    /** Set stream silence timeout and number of retries without progress. */
+    void
+    Set_timeout(std::chrono::milliseconds timeout, int max_retries = DEFAULT_MAX_RETRIES);
+
+    /** Set number of missing parameters re-requested at once. */
+    void
+    Set_batch_size(size_t batch_size);
+
+    /** Start fetching. Previously fetched parameters are discarded.
+     * @param completion_handler Called once when fetch is finished.
+     * @param progress_handler Optional, called each time fetch advances by
+     *      at least one percent.
+     * @throws Invalid_op_exception if fetch is already in progress.
+     */
+    void
+    Fetch(Completion_handler completion_handler,
+          Progress_handler progress_handler = Progress_handler());
+
+    /** Cancel ongoing fetch. Completion handler is called with CANCELED
+     * result. Does nothing if fetch is not active.
+     */
+    void
+    Cancel();
+
+    /** Check if fetch is in progress. */
+    bool
+    Is_active() const;
+
+    /** Check if the last fetch was satisfied from the cache. */
+    bool
+    Is_from_cache() const;
+
+    /** Get received parameters ordered by index. */
+    std::vector<Param>
+    Get_params() const;
+
+    /** Get number of parameters not received yet. */
+    size_t
+    Get_missing_count() const;
+
+private:
+    /** Fetch stage. */
+    enum class Stage {
+        /** Waiting for the hash response. */
+        HASH_CHECK,
+        /** Receiving the list. */
+        LIST
+    };
+
+    /** Stream to the vehicle. */
+    Mavlink_stream::Ptr stream;
+
+    /** GCS identity. */
+    uint8_t system_id, component_id;
+
+    /** Vehicle identity. */
+    uint8_t target_system, target_component;
+
+    /** Contexts. */
+    Request_processor::Ptr processor;
+    Request_completion_context::Ptr completion_ctx;
+
+    /** Cache directory, empty if caching is disabled. */
+    std::string cache_dir;
+
+    /** Silence timeout. */
+    std::chrono::milliseconds timeout = DEFAULT_TIMEOUT;
+
+    /** Maximal retries without progress. */
+    int max_retries = DEFAULT_MAX_RETRIES;
+
+    /** Re-request batch size. */
+    size_t batch_size = DEFAULT_BATCH_SIZE;
+
+    /** Protects fetch state below. */
+    mutable std::mutex mutex;
+
+    /** Fetch is in progress. */
+    bool active = false;
+
+    /** Current stage. */
+    Stage stage = Stage::LIST;
+
+    /** Parameters indexed by parameter index. */
+    std::vector<Param> params;
+
+    /** Received indices bitmap. */
+    std::vector<bool> received;
+
+    /** Number of set bits in received bitmap. */
+    size_t received_count = 0;
+
+    /** Last reported progress percent. */
+    int reported_percent = -1;
+
+    /** Number of re-requested indices still not received. */
+    size_t gaps_pending = 0;
+
+    /** Vehicle reported parameters hash. */
+    uint32_t hash = 0;
+
+    /** Hash value is known. */
+    bool hash_valid = false;
+
+    /** Parameters loaded from the cache. */
+    bool from_cache = false;
+
+    /** Retries done without progress. */
+    int retries = 0;
+
+    /** Last time the vehicle showed progress. */
+    std::chrono::steady_clock::time_point last_activity;
+
+    /** Retry timer. */
+    Timer_processor::Timer::Ptr timer;
+
+    /** Handler registration key. */
+    Mavlink_demuxer::Key value_key;
+
+    Completion_handler completion_handler;
+    Progress_handler progress_handler;
+
+    /** Send PARAM_REQUEST_LIST. */
+    void
+    Send_request_list();
+
+    /** Send PARAM_REQUEST_READ by name (index -1) or by index. */
+    void
+    Send_request_read(int index, const char* name = "");
+
+    /** Re-request next batch of missing parameters. */
+    void
+    Request_gaps();
+
+    /** Get cache file name for the given hash. */
+    std::string
+    Get_cache_file(uint32_t hash) const;
+
+    /** Load parameters from the cache for the current hash.
+     * @return true if loaded.
+     */
+    bool
+    Load_cache();
+
+    /** Store parameters to the cache under the current hash. */
+    void
+    Save_cache();
+
+    void
+    On_param_value(mavlink::Message<mavlink::MESSAGE_ID::PARAM_VALUE>::Ptr message);
+
+    /** Retry timer handler. */
+    bool
+    On_timer();
+
+    /** Report progress if it advanced. Mutex is released inside. */
+    void
+    Report_progress(std::unique_lock<std::mutex>& lock);
+
+    /** Finish fetch with the given result. Should be called with mutex
+     * locked, it is released inside.
+     */
+    void
+    Finish(std::unique_lock<std::mutex>& lock, Result result);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MAVLINK_PARAM_FETCHER_H_ */
@@ -12,6 +12,12 @@
 #include <ugcs/vsm/mavlink_decoder.h>
 #include <ugcs/vsm/mavlink_demuxer.h>
 #include <ugcs/vsm/mavlink_encoder.h>
+#include <ugcs/vsm/timer_processor.h>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <map>
+#include <mutex>
 #include <tuple>
 #include <queue>
 
@@ -30,6 +36,9 @@ public:
     /** Type of the appropriate Mavlink decoder. */
     typedef Mavlink_decoder Decoder;
 
+    /** Identifier of periodic message. */
+    typedef uint32_t Periodic_message_id;
+
     /** Construct Mavlink stream using a I/O stream. */
     Mavlink_stream(Io_stream::Ref stream) :
         stream(stream), decoder()
@@ -131,6 +140,10 @@ public:
     {
         ASSERT(completion_ctx->Get_type() != Request_completion_context::Type::TEMPORAL);
 
+        /* Sequence number is taken and the write is queued atomically, so
+         * frames hit the wire in sequence order.
+         */
+        std::unique_lock<std::mutex> lock(send_mutex);
         Io_buffer::Ptr buffer;
         if (mav2) {
             buffer = encoder.Encode_v2(payload, system_id, component_id);
@@ -138,14 +151,104 @@ public:
             buffer = encoder.Encode_v1(payload, system_id, component_id);
         }
 
-        Operation_waiter waiter = stream->Write(
-                buffer,
-                Make_dummy_callback<void, Io_result>(),
-                completion_ctx);
-        waiter.Timeout(timeout, timeout_handler, true, completion_ctx);
+        Send_buffer_locked(buffer, timeout, timeout_handler, completion_ctx);
+    }
 
-        write_ops.emplace(std::move(waiter));
-        Cleanup_write_ops();
+    /** Send already encoded Mavlink frame(s) to other end asynchronously.
+     * Buffer is written as is, so it should contain complete frames, e.g.
+     * previously produced by @ref Mavlink_encoder. Timeout and completion
+     * context have the same meaning as for @ref Send_message.
+     */
+    void
+    Send_buffer(
+            Io_buffer::Ptr buffer,
+            const std::chrono::milliseconds& timeout,
+            Operation_waiter::Timeout_handler timeout_handler,
+            const Request_completion_context::Ptr& completion_ctx)
+    {
+        ASSERT(completion_ctx->Get_type() != Request_completion_context::Type::TEMPORAL);
+
+        std::unique_lock<std::mutex> lock(send_mutex);
+        Send_buffer_locked(buffer, timeout, timeout_handler, completion_ctx);
+    }
+
+    /** Send the message periodically, e.g. GCS heartbeat. The message is
+     * encoded once and the cached frame is sent each period with only the
+     * sequence number and checksum patched. All periodic messages of the
+     * stream are driven by a single one-shot timer, which is re-armed for
+     * the earliest next send time. Periodic message methods may be called
+     * from any thread.
+     * @param payload Message payload.
+     * @param system_id System id.
+     * @param component_id Component id.
+     * @param period Send period. It is also used as write timeout.
+     * @param completion_ctx Context for the timer and write completions.
+     *      Should be the same for all periodic messages of the stream and the
+     *      one used with @ref Send_message, because the sequence number is
+     *      shared.
+     * @param send_now Send the first message right away, otherwise it is sent
+     *      after the first period.
+     * @return Identifier of the periodic message.
+     */
+    Periodic_message_id
+    Add_periodic_message(
+            const mavlink::Payload_base& payload,
+            uint8_t system_id,
+            uint8_t component_id,
+            std::chrono::milliseconds period,
+            const Request_completion_context::Ptr& completion_ctx,
+            bool send_now = true)
+    {
+        ASSERT(completion_ctx->Get_type() != Request_completion_context::Type::TEMPORAL);
+        ASSERT(period.count() > 0);
+
+        std::unique_lock<std::mutex> lock(send_mutex);
+        Periodic_message_id id = ++last_periodic_id;
+        auto& msg = periodic_messages[id];
+        msg.system_id = system_id;
+        msg.component_id = component_id;
+        msg.period = period;
+        msg.next_send = std::chrono::steady_clock::now();
+        Cache_periodic_frame(msg, payload);
+        if (send_now) {
+            Send_periodic_frame(msg, completion_ctx);
+        }
+        msg.next_send += period;
+
+        periodic_ctx = completion_ctx;
+        if (!periodic_timer || msg.next_send < periodic_due) {
+            Schedule_periodic_timer();
+        }
+        return id;
+    }
+
+    /** Replace payload of the periodic message. Sending schedule is not
+     * affected.
+     * @return false if there is no message with such id.
+     */
+    bool
+    Update_periodic_message(Periodic_message_id id, const mavlink::Payload_base& payload)
+    {
+        std::unique_lock<std::mutex> lock(send_mutex);
+        auto iter = periodic_messages.find(id);
+        if (iter == periodic_messages.end()) {
+            return false;
+        }
+        Cache_periodic_frame(iter->second, payload);
+        return true;
+    }
+
+    /** Stop sending the periodic message. The timer is stopped when the last
+     * periodic message is removed.
+     */
+    void
+    Remove_periodic_message(Periodic_message_id id)
+    {
+        std::unique_lock<std::mutex> lock(send_mutex);
+        periodic_messages.erase(id);
+        if (periodic_messages.empty()) {
+            Cancel_periodic_timer();
+        }
     }
 
     /** Disable the class. Underlying I/O stream is freed, but not explicitly
@@ -155,16 +258,170 @@ public:
     void
     Disable()
     {
+        std::unique_lock<std::mutex> lock(send_mutex);
+        periodic_messages.clear();
+        Cancel_periodic_timer();
         decoder.Disable();
         demuxer.Disable();
         stream = nullptr;
-        while (!write_ops.empty()) {
-            write_ops.front().Abort();
-            write_ops.pop();
+        auto ops = std::move(write_ops);
+        write_ops = std::queue<Operation_waiter>();
+        lock.unlock();
+        while (!ops.empty()) {
+            ops.front().Abort();
+            ops.pop();
         }
     }
 
 private:
+    /** Periodic message with its cached frame. */
+    struct Periodic_message {
+        /** Frame encoded with zero sequence number. */
+        std::vector<uint8_t> frame;
+        /** Offset of the sequence number in the frame. */
+        size_t seq_offset;
+        /** CRC extra byte of the message. */
+        uint8_t crc_extra;
+        /** Frame checksum for each sequence number, filled on first use. */
+        std::array<uint16_t, 256> crc;
+        /** Valid entries of crc. */
+        std::bitset<256> crc_valid;
+        /** Sender identity. */
+        uint8_t system_id, component_id;
+        /** Send period. */
+        std::chrono::milliseconds period;
+        /** Time to send next. */
+        std::chrono::steady_clock::time_point next_send;
+    };
+
+    /** Queue the write, send mutex should be locked. */
+    void
+    Send_buffer_locked(
+            Io_buffer::Ptr buffer,
+            const std::chrono::milliseconds& timeout,
+            Operation_waiter::Timeout_handler timeout_handler,
+            const Request_completion_context::Ptr& completion_ctx)
+    {
+        if (!stream) {
+            return;
+        }
+        Operation_waiter waiter = stream->Write(
+                buffer,
+                Make_dummy_callback<void, Io_result>(),
+                completion_ctx);
+        waiter.Timeout(timeout, timeout_handler, true, completion_ctx);
+
+        write_ops.emplace(std::move(waiter));
+        Cleanup_write_ops();
+    }
+
+    /** Arm the periodic timer for the earliest next send time. Send mutex
+     * should be locked.
+     */
+    void
+    Schedule_periodic_timer()
+    {
+        Cancel_periodic_timer();
+        if (periodic_messages.empty()) {
+            return;
+        }
+        periodic_due = periodic_messages.begin()->second.next_send;
+        for (auto& iter : periodic_messages) {
+            periodic_due = std::min(periodic_due, iter.second.next_send);
+        }
+        auto delay = std::max(periodic_due - std::chrono::steady_clock::now(),
+                              std::chrono::steady_clock::duration::zero());
+        periodic_timer = Timer_processor::Get_instance()->Create_timer(
+                std::chrono::duration_cast<std::chrono::microseconds>(delay),
+                Make_callback(&Mavlink_stream::On_periodic_timer, Shared_from_this(),
+                              periodic_generation),
+                periodic_ctx);
+    }
+
+    /** Cancel the periodic timer. Send mutex should be locked. */
+    void
+    Cancel_periodic_timer()
+    {
+        /* Invalidates the timer callback which could be already queued. */
+        periodic_generation++;
+        if (periodic_timer) {
+            periodic_timer->Cancel();
+            periodic_timer = nullptr;
+        }
+    }
+
+    /** Encode the payload into the periodic message cache. */
+    void
+    Cache_periodic_frame(Periodic_message& msg, const mavlink::Payload_base& payload)
+    {
+        /* Own encoder, so that stream sequence is not consumed. */
+        Mavlink_encoder cache_encoder;
+        Io_buffer::Ptr buffer;
+        if (send_mavlink2) {
+            buffer = cache_encoder.Encode_v2(payload, msg.system_id, msg.component_id);
+            msg.seq_offset = 4;
+        } else {
+            buffer = cache_encoder.Encode_v1(payload, msg.system_id, msg.component_id);
+            msg.seq_offset = 2;
+        }
+        auto data = static_cast<const uint8_t*>(buffer->Get_data());
+        msg.frame.assign(data, data + buffer->Get_length());
+        msg.crc_extra = payload.Get_extra_byte();
+        msg.crc_valid.reset();
+    }
+
+    /** Send cached frame with the next sequence number. Send mutex should be
+     * locked.
+     */
+    void
+    Send_periodic_frame(Periodic_message& msg,
+                        const Request_completion_context::Ptr& completion_ctx)
+    {
+        uint8_t seq = encoder.Take_seq();
+        std::vector<uint8_t> data(msg.frame);
+        data[msg.seq_offset] = seq;
+        size_t crc_offset = data.size() - sizeof(uint16_t);
+        if (!msg.crc_valid.test(seq)) {
+            /* Don't include start sign. */
+            mavlink::Checksum sum(&data[1], crc_offset - 1);
+            msg.crc[seq] = sum.Accumulate(msg.crc_extra);
+            msg.crc_valid.set(seq);
+        }
+        *reinterpret_cast<mavlink::Uint16*>(&data[crc_offset]) = msg.crc[seq];
+        Send_buffer_locked(Io_buffer::Create(std::move(data)), msg.period,
+                           Operation_waiter::Timeout_handler(), completion_ctx);
+    }
+
+    /** Periodic timer handler, the timer is one-shot and re-armed here. */
+    bool
+    On_periodic_timer(uint32_t generation)
+    {
+        std::unique_lock<std::mutex> lock(send_mutex);
+        if (generation != periodic_generation) {
+            /* Canceled or re-armed meanwhile. */
+            return false;
+        }
+        periodic_timer = nullptr;
+        if (!stream || periodic_messages.empty()) {
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (auto& iter : periodic_messages) {
+            auto& msg = iter.second;
+            if (now < msg.next_send) {
+                continue;
+            }
+            Send_periodic_frame(msg, periodic_ctx);
+            msg.next_send += msg.period;
+            if (msg.next_send < now) {
+                /* Do not try to catch up after a stall. */
+                msg.next_send = now + msg.period;
+            }
+        }
+        Schedule_periodic_timer();
+        return false;
+    }
+
     /** Underlying stream. */
     Io_stream::Ref stream;
 
@@ -199,6 +456,29 @@ private:
 
     /** Send outgoing traffic in mavlink version 2 format */
     bool send_mavlink2 = false;
+
+    /** Periodic messages. */
+    std::map<Periodic_message_id, Periodic_message> periodic_messages;
+
+    /** Last assigned periodic message id. */
+    Periodic_message_id last_periodic_id = 0;
+
+    /** Protects the encoder sequence, write queue and periodic messages
+     * which are accessed both from user threads and the periodic timer.
+     */
+    std::mutex send_mutex;
+
+    /** One-shot timer for all periodic messages. */
+    Timer_processor::Timer::Ptr periodic_timer;
+
+    /** Time the periodic timer is armed for. */
+    std::chrono::steady_clock::time_point periodic_due;
+
+    /** Incremented each time the periodic timer is canceled. */
+    uint32_t periodic_generation = 0;
+
+    /** Context of periodic sends. */
+    Request_completion_context::Ptr periodic_ctx;
 };
 
 } /* namespace vsm */
@@ -0,0 +1,228 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mavlink_tlog.h
+ *
+ * Capture and replay of Mavlink traffic in telemetry log (tlog) format.
+ *
+ * Tlog file is a sequence of records. Each record is a 64 bits big-endian
+ * timestamp in microseconds since Unix epoch followed by one complete Mavlink
+ * frame. The format is understood by most ground control software.
+ */
+#ifndef _UGCS_VSM_MAVLINK_TLOG_H_
+#define _UGCS_VSM_MAVLINK_TLOG_H_
+
+#include <ugcs/vsm/mavlink_decoder.h>
+#include <ugcs/vsm/io_request.h>
+#include <ugcs/vsm/request_context.h>
+#include <ugcs/vsm/timer_processor.h>
+
+#include <deque>
+#include <fstream>
+
+namespace ugcs {
+namespace vsm {
+
+/** Writes Mavlink frames received by a decoder into tlog file. Only frames
+ * which passed the decoder checksum validation are captured, they are
+ * timestamped and collected in a large append buffer. The buffer is written to the file asynchronously
+ * when it is full and periodically by a flush timer, so the decoding
+ * context never waits for the disk. Signed Mavlink 2 frames are not captured
+ * because the decoder does not pass their signatures.
+ * @code
+ * auto file = File_processor::Get_instance()->Open("flight.tlog", "w");
+ * auto tlog = Mavlink_tlog_writer::Create(file, completion_ctx);
+ * tlog->Enable();
+ * mav_stream->Get_decoder().Register_frame_handler(tlog->Get_frame_handler());
+ * @endcode
+ */
+class Mavlink_tlog_writer:
+    public std::enable_shared_from_this<Mavlink_tlog_writer> {
+
+    DEFINE_COMMON_CLASS(Mavlink_tlog_writer, Mavlink_tlog_writer)
+
+public:
+    /** Default append buffer size. */
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    /** Period of the background flush. */
+    static constexpr std::chrono::milliseconds FLUSH_PERIOD =
+            std::chrono::milliseconds(1000);
+
+    /** Construct writer.
+     * @param file Opened for writing file stream, typically from
+     *      File_processor.
+     * @param completion_ctx Context for flush timer and write completions.
+     * @param buffer_size Append buffer size, write is initiated when it is
+     *      filled.
+     */
+    Mavlink_tlog_writer(
+            Io_stream::Ref file,
+            Request_completion_context::Ptr completion_ctx,
+            size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    /** Start periodic flush. */
+    void
+    Enable();
+
+    /** Flush buffered frames and stop periodic flush. The file is not
+     * closed.
+     */
+    void
+    Disable();
+
+    /** Get handler to register in Mavlink_decoder. */
+    Mavlink_decoder::Frame_handler
+    Get_frame_handler();
+
+    /** Write buffered frames to the file now. */
+    void
+    Flush();
+
+    /** Get number of frames captured so far. */
+    uint64_t
+    Get_frame_count() const;
+
+private:
+    /** Output file. */
+    Io_stream::Ref file;
+
+    /** Context for timer and writes. */
+    Request_completion_context::Ptr completion_ctx;
+
+    /** Append buffer capacity. */
+    size_t buffer_size;
+
+    /** Protects the state below. */
+    mutable std::mutex mutex;
+
+    /** Records ready to be written. */
+    std::vector<uint8_t> buffer;
+
+    /** Frames captured. */
+    uint64_t frame_count = 0;
+
+    /** Flush timer. */
+    Timer_processor::Timer::Ptr timer;
+
+    void
+    On_frame(Io_buffer::Ptr frame);
+
+    /** Write the buffer, mutex should be locked. */
+    void
+    Flush_locked();
+
+    bool
+    On_timer();
+};
+
+/** Input stream which replays Mavlink frames from tlog file, e.g. for load
+ * testing with recorded flights. Frames are delivered according to their
+ * timestamps scaled by the speed factor, or as fast as they are read when
+ * speed is @ref AS_FAST_AS_POSSIBLE. Written data are discarded. Reading
+ * past the last frame completes with END_OF_FILE result.
+ * @code
+ * auto stream = Mavlink_tlog_replay_stream::Create("flight.tlog", completion_ctx, 4.0);
+ * auto mav_stream = Mavlink_stream::Create(stream);
+ * @endcode
+ */
+class Mavlink_tlog_replay_stream: public Io_stream {
+    DEFINE_COMMON_CLASS(Mavlink_tlog_replay_stream, Io_stream)
+
+public:
+    /** Speed value to replay without delays. */
+    static constexpr double AS_FAST_AS_POSSIBLE = 0;
+
+    /** Open tlog file for replay.
+     * @param file_name Tlog file name.
+     * @param completion_ctx Context for the replay timer and completions of
+     *      operations issued without a handler. It should be served by the
+     *      caller, e.g. the same context which serves the Mavlink stream.
+     * @param speed Replay speed factor, 1 is real time.
+     * @throws Invalid_param_exception if the file cannot be opened.
+     */
+    Mavlink_tlog_replay_stream(const std::string& file_name,
+                               Request_completion_context::Ptr completion_ctx,
+                               double speed = 1.0);
+
+    /** Get number of frames replayed so far. */
+    uint64_t
+    Get_frame_count() const;
+
+private:
+    /** Source file. */
+    std::ifstream file;
+
+    /** Replay speed factor. */
+    double speed;
+
+    /** Protects the state below. */
+    mutable std::mutex op_mutex;
+
+    /** Read requests waiting for data. */
+    std::deque<Read_request::Ptr> read_queue;
+
+    /** Data of the frames which became due but not yet read. */
+    Io_buffer::Ptr pending;
+
+    /** Next record frame and timestamp, valid when next_loaded is set. */
+    std::vector<uint8_t> next_frame;
+    uint64_t next_time = 0;
+    bool next_loaded = false;
+
+    /** End of file reached. */
+    bool eof = false;
+
+    /** Timestamp of the first record and the time it was replayed. */
+    uint64_t first_time = 0;
+    std::chrono::steady_clock::time_point start_time;
+    bool started = false;
+
+    /** Frames replayed. */
+    uint64_t frame_count = 0;
+
+    /** Context for timer and completions. */
+    Request_completion_context::Ptr completion_ctx;
+
+    /** Replay timer, armed while the next frame is not due yet. */
+    Timer_processor::Timer::Ptr timer;
+
+    virtual Operation_waiter
+    Write_impl(Io_buffer::Ptr buffer, Offset offset,
+               Write_handler completion_handler,
+               Request_completion_context::Ptr comp_ctx) override;
+
+    virtual Operation_waiter
+    Read_impl(size_t max_to_read, size_t min_to_read, Offset offset,
+              Read_handler completion_handler,
+              Request_completion_context::Ptr comp_ctx) override;
+
+    virtual Operation_waiter
+    Close_impl(Close_handler completion_handler,
+               Request_completion_context::Ptr comp_ctx) override;
+
+    /** Load next record from the file.
+     * @return false if end of file reached.
+     */
+    bool
+    Load_record();
+
+    /** Serve queued reads with due data, arm timer if data are not due yet.
+     * Mutex should be locked.
+     */
+    void
+    Process_reads();
+
+    void
+    Handle_read_cancel(Read_request::Ptr request);
+
+    bool
+    On_timer();
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MAVLINK_TLOG_H_ */
@@ -0,0 +1,157 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mpsc_queue.h
+ *
+ * Intrusive lock-free multi-producer single-consumer queue.
+ */
+#ifndef _UGCS_VSM_MPSC_QUEUE_H_
+#define _UGCS_VSM_MPSC_QUEUE_H_
+
+#include <atomic>
+
+namespace ugcs {
+namespace vsm {
+
+/** Base class for elements of @ref Mpsc_queue. Element can be linked into
+ * one queue at a time.
+ */
+class Mpsc_queue_node {
+public:
+    Mpsc_queue_node() = default;
+
+    /** Node is not copyable, it may be linked. */
+    Mpsc_queue_node(const Mpsc_queue_node&) = delete;
+
+private:
+    template <class Node>
+    friend class Mpsc_queue;
+
+    /** Next node, from older to newer. */
+    std::atomic<Mpsc_queue_node*> next = { nullptr };
+};
+
+/** Intrusive unbounded multi-producer single-consumer queue (D. Vyukov's
+ * algorithm). Push is wait-free and does not allocate memory, nodes are
+ * provided by the caller. Pop should be serialized by the caller. Pop may
+ * return nullptr while a concurrent push is not yet fully linked, so the
+ * consumer should rely on some notification from producers issued after the
+ * push is done.
+ * @param Node Element type, should be derived from Mpsc_queue_node.
+ */
+template <class Node>
+class Mpsc_queue {
+public:
+    Mpsc_queue():
+        head(&stub), tail(&stub)
+    {}
+
+    Mpsc_queue(const Mpsc_queue&) = delete;
+
+    /** Push the node. Can be called from any thread. */
+    void
+    Push(Node* node)
+    {
+        size.fetch_add(1, std::memory_order_relaxed);
+        Push_node(node);
+    }
+
+    /** Pop the oldest node. Only one thread at a time can pop.
+     * @return Popped node or nullptr if the queue is empty.
+     */
+    Node*
+    Pop()
+    {
+        Mpsc_queue_node* cur = tail;
+        Mpsc_queue_node* next = cur->next.load(std::memory_order_acquire);
+        if (cur == &stub) {
+            if (!next) {
+                return nullptr;
+            }
+            tail = next;
+            cur = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return Release(cur);
+        }
+        if (cur != head.load(std::memory_order_acquire)) {
+            /* Producer is in the middle of push. */
+            return nullptr;
+        }
+        /* Last node can be popped only when something follows it. */
+        Push_node(&stub);
+        next = cur->next.load(std::memory_order_acquire);
+        if (next) {
+            tail = next;
+            return Release(cur);
+        }
+        return nullptr;
+    }
+
+    /** Get the oldest node without popping it. Only the popping thread can
+     * call it. Pop() may still return nullptr after a node was peeked if
+     * the node is the last one and a push is in progress.
+     * @return The oldest node or nullptr if the queue is empty.
+     */
+    Node*
+    Peek()
+    {
+        Mpsc_queue_node* cur = tail;
+        if (cur == &stub) {
+            cur = cur->next.load(std::memory_order_acquire);
+        }
+        return static_cast<Node*>(cur);
+    }
+
+    /** Check if the queue is empty. Exact only if there are no concurrent
+     * pushes.
+     */
+    bool
+    Is_empty() const
+    {
+        return size.load(std::memory_order_relaxed) == 0;
+    }
+
+    /** Get number of queued nodes. Exact only if there are no concurrent
+     * operations.
+     */
+    size_t
+    Get_size() const
+    {
+        return size.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** Newest node, producers side. */
+    std::atomic<Mpsc_queue_node*> head;
+    /** Oldest node, consumer side. */
+    Mpsc_queue_node* tail;
+    /** Stub node which keeps the queue never physically empty. */
+    Mpsc_queue_node stub;
+    /** Number of nodes. */
+    std::atomic<size_t> size = { 0 };
+
+    void
+    Push_node(Mpsc_queue_node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Mpsc_queue_node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node*
+    Release(Mpsc_queue_node* node)
+    {
+        size.fetch_sub(1, std::memory_order_relaxed);
+        return static_cast<Node*>(node);
+    }
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MPSC_QUEUE_H_ */
@@ -119,6 +119,15 @@ public:
     void
     Abort();
 
+    /** Set handler which is invoked when the request is done. It is invoked
+     * immediately if the request is already done or there is no request.
+     * Calling context is either completion, abortion or this method calling
+     * context. Replaces the handler used by Timeout(), so both should not be
+     * used for the same operation.
+     */
+    void
+    Set_done_handler(Request::Handler handler);
+
     /** Check if request is fully processed, i.e. all handlers were invoked and
      * no more actions pending.
      */
@@ -129,6 +138,8 @@ public:
     }
 
 private:
+    friend class Socket_processor;
+
     /** Associated request. */
     Request::Ptr request;
 
@@ -12,6 +12,9 @@
 #define _UGCS_VSM_REQUEST_CONTAINER_H_
 
 #include <ugcs/vsm/callback.h>
+#include <ugcs/vsm/inline_callback.h>
+#include <ugcs/vsm/mpsc_queue.h>
+#include <ugcs/vsm/request_stats.h>
 #include <ugcs/vsm/utils.h>
 
 #include <memory>
@@ -20,6 +23,7 @@
 #include <condition_variable>
 #include <atomic>
 #include <list>
+#include <vector>
 
 namespace ugcs {
 namespace vsm {
@@ -30,6 +34,14 @@ namespace vsm {
 class Request_container: public std::enable_shared_from_this<Request_container> {
     DEFINE_COMMON_CLASS(Request_container, Request_container)
 
+    /** Element of the container queue, either a request or a posted task. */
+    struct Queue_entry: Mpsc_queue_node {
+        /** Entry is a Task, Request::Queue_hook otherwise. */
+        bool is_task = false;
+        /** Submission time, set only when statistics are collected. */
+        std::chrono::steady_clock::time_point submit_time;
+    };
+
 public:
     /** Generic request for implementing inter-threads communications and asynchronous
      * operations.
@@ -82,8 +94,29 @@ public:
             CANCELED
         };
 
+        /** Request priority class. Requests of higher class are processed
+         * before queued requests of lower classes, see
+         * Request_container::STARVATION_LIMIT. Requests of the same class are
+         * processed in submission order.
+         */
+        enum class Priority {
+            /** Urgent requests, e.g. safety-relevant commands. */
+            HIGH,
+            /** Default class, posted tasks have it unless specified. */
+            NORMAL,
+            /** Bulk work, e.g. file or parameters transfer. */
+            LOW
+        };
+
+        /** Number of priority classes. */
+        static constexpr int NUM_PRIORITIES = 3;
+
         /** Callback denoting a handler of the request. */
         typedef Callback_base<void>::Ptr<> Handler;
+        /** Move-only handler which does not require a heap allocation, see
+         * Make_inline_callback().
+         */
+        typedef Inline_callback<void> Inline_handler;
         /** Smart lock object for request external locking. */
         typedef std::unique_lock<std::mutex> Locker;
 
@@ -103,6 +136,10 @@ public:
         void
         Set_processing_handler(Handler &&handler);
 
+        /** @see Set_processing_handler */
+        void
+        Set_processing_handler(Inline_handler &&handler);
+
         /** Set completion handler for the request. It is called when request is completed
          * in the specified completion context.
          *
@@ -119,6 +156,11 @@ public:
         Set_completion_handler(const Request_container::Ptr &context,
                                Handler &&handler);
 
+        /** @see Set_completion_handler */
+        void
+        Set_completion_handler(const Request_container::Ptr &context,
+                               Inline_handler &&handler);
+
         /** Set request cancellation handler. It is fired when Abort() method is
          * called between request processing started and Complete() is called (i.e.
          * while request is in PROCESSING state). The second case is calling request
@@ -230,6 +272,39 @@ public:
             return status;
         }
 
+        /** Set request priority class. Takes effect when the request is
+         * submitted next time.
+         */
+        void
+        Set_priority(Priority priority)
+        {
+            this->priority = priority;
+        }
+
+        /** Get request priority class. */
+        Priority
+        Get_priority() const
+        {
+            return priority;
+        }
+
+        /** Mark the request as coalescable, i.e. it can be dropped from an
+         * overflowed queue since a newer request supersedes it, see
+         * Request_container::Overflow_policy::DROP_HEAD.
+         */
+        void
+        Set_coalescable(bool coalescable = true)
+        {
+            this->coalescable = coalescable;
+        }
+
+        /** Check if the request is coalescable. */
+        bool
+        Is_coalescable() const
+        {
+            return coalescable;
+        }
+
         /** Check if request is completed. */
         bool
         Is_completed() const
@@ -325,10 +400,46 @@ public:
         Is_completion_handler_present();
 
     private:
+        friend class Request_container;
+
+        /** Link of the request in a container queue. Queued request holds a
+         * reference to itself in the hook, so it is not destroyed while
+         * queued.
+         */
+        struct Queue_hook: Queue_entry {
+            /** Queued request. */
+            Request::Ptr request;
+            /** Hook is linked into some queue. */
+            std::atomic_bool in_use = { false };
+            /** Hook is allocated separately from the request. */
+            bool is_dynamic = false;
+        };
+
+        /** Number of hooks embedded in the request. A request can be queued
+         * in its processor and completion context at the same time, e.g. when
+         * it is aborted while still pending.
+         */
+        static constexpr int NUM_QUEUE_HOOKS = 2;
+
+        /** Embedded queue hooks, so queueing does not allocate memory. */
+        Queue_hook queue_hooks[NUM_QUEUE_HOOKS];
+
+        /** Get a free hook of the request and link the request to it. A hook
+         * is allocated if all embedded ones are in use.
+         */
+        static Queue_hook*
+        Acquire_queue_hook(Request::Ptr request);
+
+        /** Unlink the request from the popped hook.
+         * @return The request which was queued.
+         */
+        static Request::Ptr
+        Release_queue_hook(Queue_hook* hook);
+
         /** Request processing handler. Called when request is about to be processed. */
-        Handler processing_handler;
+        Inline_handler processing_handler;
         /** Request completion handler. Called when request is completed. */
-        Handler completion_handler;
+        Inline_handler completion_handler;
         /** Cancellation handler is called when request is aborted in processing
          * state.
          */
@@ -344,6 +455,10 @@ public:
          */
         /** request has timed out. This must be set/read under request lock */
         bool timed_out = false;
+        /** Priority class used on submission. */
+        std::atomic<Priority> priority = { Priority::NORMAL };
+        /** Request can be dropped on queue overflow. */
+        std::atomic_bool coalescable = { false };
         std::atomic<Status> status = { Status::PENDING };
         /** Was the Complete() method invoked. */
         std::atomic_bool completion_processed = { false },
@@ -369,7 +484,10 @@ public:
 
         class Locker;
 
-        /** Notify all listeners about request submission. */
+        /** Notify listeners about request submission. Does nothing if there
+         * are no threads waiting on this waiter, so submitting to a busy or
+         * idle-without-waiters context costs no lock and no wakeup.
+         */
         virtual void
         Notify();
 
@@ -390,8 +508,8 @@ public:
          * are processed. After processing the method exits.
          *
          * @param containers List of containers to check and wait for.
-         * @param timeout Timeout in milliseconds. Zero value indicates indefinite
-         *      waiting.
+         * @param timeout Timeout, microseconds precision is available for
+         *      sub-millisecond waits. Zero value indicates indefinite waiting.
          * @param requests_limit Limit of requests to process at once. Zero means no
          *      limit.
          * @param predicate Predicate to check during waiting. It overrides
@@ -400,7 +518,7 @@ public:
          */
         int
         Wait_and_process(const std::initializer_list<Request_container::Ptr> &containers,
-                         std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
+                         std::chrono::microseconds timeout = std::chrono::microseconds::zero(),
                          int requests_limit = 0, Predicate predicate = Predicate());
 
         /** Wait for request submission. It blocks until request submitted or the
@@ -408,8 +526,8 @@ public:
          * are processed. After processing the method exits.
          *
          * @param containers List of containers to check and wait for.
-         * @param timeout Timeout in milliseconds. Zero value indicates indefinite
-         *      waiting.
+         * @param timeout Timeout, microseconds precision is available for
+         *      sub-millisecond waits. Zero value indicates indefinite waiting.
          * @param requests_limit Limit of requests to process at once. Zero means no
          *      limit.
          * @param predicate Predicate to check during waiting. It overrides
@@ -418,7 +536,7 @@ public:
          */
         int
         Wait_and_process(const std::list<Request_container::Ptr> &containers,
-                         std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
+                         std::chrono::microseconds timeout = std::chrono::microseconds::zero(),
                          int requests_limit = 0, Predicate predicate = Predicate());
 
         virtual
@@ -431,6 +549,12 @@ public:
         std::mutex mutex;
         /** Condition variable for waiting and notifying about requests. */
         std::condition_variable cond_var;
+        /** Number of threads which are going to block or blocked on the
+         * condition variable. Incremented before the last predicate check,
+         * so a notifier either sees the waiter or the waiter sees the
+         * submitted request.
+         */
+        std::atomic_int num_waiters = { 0 };
 
         /** Implementation for public methods Wait_and_process.
          * @see Wait_and_process
@@ -438,7 +562,7 @@ public:
         template <class Container_list>
         int
         Wait_and_process_impl(const Container_list &containers,
-                              std::chrono::milliseconds timeout,
+                              std::chrono::microseconds timeout,
                               int requests_limit, Predicate ext_predicate);
     };
 
@@ -496,6 +620,61 @@ public:
                 Request::Ptr request,
                 Request_waiter::Locker locker);
 
+    /** Post a fire-and-forget task to the container. The callable is invoked
+     * in the container context in order with submitted requests. There is no
+     * completion notification, cancellation or waiting for the task, it is
+     * just destroyed without invocation if the container is disabled before
+     * the task is run. Much cheaper than a request with processing handler.
+     *
+     * @param callable Callable object without arguments.
+     * @param priority Priority class of the task.
+     * @return false if the container is disabled and the task was not
+     *      queued.
+     */
+    template <class Callable>
+    bool
+    Post(Callable &&callable, Request::Priority priority = Request::Priority::NORMAL)
+    {
+        return Post_task(Inline_callback<void>(std::forward<Callable>(callable)),
+                         priority);
+    }
+
+    /** Submit several requests at once. The waiter is notified once after
+     * all the requests are queued. If submission of some request throws, the
+     * waiter is still notified about the requests queued before it.
+     *
+     * @param begin Iterator of the first request.
+     * @param end Iterator past the last request.
+     */
+    template <class Iterator>
+    void
+    Submit_requests(Iterator begin, Iterator end)
+    {
+        /* Notifies on scope exit, including exceptions. */
+        struct Notifier {
+            Request_waiter &waiter;
+
+            ~Notifier()
+            {
+                waiter.Notify();
+            }
+        } notifier {*waiter};
+
+        for (auto it = begin; it != end; it++) {
+            Push_request(*it);
+        }
+    }
+
+    /** Submit all requests from the range (any container of Request::Ptr).
+     * The waiter is notified once.
+     */
+    template <class Range>
+    void
+    Submit_requests(const Range& requests)
+    {
+        Submit_requests(std::begin(requests), std::end(requests));
+    }
+
     /** Process all currently queued requests.
      *
      * @param requests_limit Limit of requests to process at once. Zero means no limit.
@@ -529,6 +708,62 @@ public:
         return waiter;
     }
 
+    /** Action taken when a request is submitted to a full container. */
+    enum class Overflow_policy {
+        /** Submitting thread waits until there is space in the queue.
+         * Submissions from a thread which processes containers of the same
+         * waiter would never end waiting, so they are queued over the
+         * capacity. Waits between different workers are not detected: if
+         * two containers served by different workers both use this policy
+         * and their handlers submit into each other, the workers deadlock
+         * once both queues are full. Such cycles should use another policy
+         * on at least one side.
+         */
+        BLOCK,
+        /** The request is aborted instead of being queued, posted task is
+         * not queued and Post() returns false.
+         */
+        REJECT,
+        /** The head entry of a priority class is aborted to free space,
+         * starting from the lowest class, HIGH class is never touched. The
+         * head is the oldest entry of its class, but not necessarily the
+         * oldest in the container, and entries behind the heads are not
+         * inspected since the queues are removed from only at the head. If
+         * no head is a coalescable request still pending processing, the new
+         * request is rejected. Completion notifications are never dropped.
+         */
+        DROP_HEAD
+    };
+
+    /** Counters of overflow events. */
+    struct Overflow_counters {
+        /** Number of submissions which waited for space. */
+        uint64_t blocked = 0;
+        /** Number of rejected requests and tasks. */
+        uint64_t rejected = 0;
+        /** Number of dropped queued requests. */
+        uint64_t dropped = 0;
+    };
+
+    /** Maximal number of entries taken from higher priority classes in a
+     * row while entries of a lower class are waiting. The oldest entry of the
+     * starving class is processed next when the limit is reached.
+     */
+    static constexpr int STARVATION_LIMIT = 32;
+
+    /** Get number of requests currently queued in the container. The value
+     * is approximate if there are concurrent submissions.
+     */
+    size_t
+    Get_queue_size() const
+    {
+        size_t size = 0;
+        for (auto &queue : request_queues) {
+            size += queue.Get_size();
+        }
+        return size;
+    }
+
     /** Get the name of the container. */
     const std::string&
     Get_name()
@@ -536,6 +771,39 @@ public:
         return name;
     }
 
+    /** Limit the number of queued requests and posted tasks. Entries of
+     * HIGH priority class, completion notifications, requests being aborted
+     * and requests submitted with Submit_request_locked() are always queued,
+     * so the limit can be exceeded by them. Hence Request::Complete() never
+     * blocks or loses the notification when the completion context is full.
+     * @param capacity Maximal queue size, zero means unlimited (default).
+     * @param policy Action taken when the queue is full.
+     */
+    void
+    Set_capacity(size_t capacity, Overflow_policy policy = Overflow_policy::REJECT);
+
+    /** Get counters of overflow events since the container creation. */
+    Overflow_counters
+    Get_overflow_counters() const;
+
+    /** Collect processing statistics of the container in
+     * Request_stats_registry under the container name. Collection is
+     * also enabled for all containers when the registry is enabled. Should be
+     * called before the container is enabled.
+     * @throws Invalid_op_exception if the container is already enabled.
+     */
+    void
+    Enable_stats();
+
+    /** Get statistics of the container.
+     * @return Statistics or nullptr if not collected.
+     */
+    Request_container_stats::Ptr
+    Get_stats() const
+    {
+        return stats;
+    }
+
     /** Enable the container. The container is ready to accept requests after that.
      * Derived class can start dedicated threads there.
      * @throws Invalid_op_exception if the container is already enabled.
@@ -562,10 +830,30 @@ protected:
      * to the request queue in derived classes.
      */
     Request_waiter::Ptr waiter;
-    /** Queue of pending requests, i.e. waiting for completion notification
-     * processing.
+    /** Queues of pending requests, i.e. waiting for completion notification
+     * processing, one per priority class. Requests are pushed without locking,
+     * pop is serialized by the waiter lock.
      */
-    std::list<Request::Ptr> request_queue;
+    Mpsc_queue<Queue_entry> request_queues[Request::NUM_PRIORITIES];
+
+    /** Number of entries taken from higher classes while the class was not
+     * empty, for each priority class. Protected by the waiter lock.
+     */
+    int starvation_counts[Request::NUM_PRIORITIES] = {};
+
+    /** Pop the next entry to process according to priorities. Waiter lock
+     * should be held.
+     * @return Entry or nullptr if all queues are empty.
+     */
+    Queue_entry *
+    Pop_entry();
+
+    /** Pop the oldest request from the queue discarding posted tasks. Waiter
+     * lock should be held.
+     * @return Request or nullptr if the queue is empty.
+     */
+    Request::Ptr
+    Pop_request();
 
     /** Request processing loop implementation. It does not return while the
      * container is enabled.
@@ -614,6 +902,60 @@ private:
             Request::Ptr request,
             Request_waiter::Locker locker);
 
+    friend class Request_batch;
+
+    /** Posted task. */
+    struct Task: Queue_entry {
+        Inline_callback<void> handler;
+    };
+
+    /** Queue posted task. */
+    bool
+    Post_task(Inline_callback<void> &&handler, Request::Priority priority);
+
+    /** Make space for a new entry according to the overflow policy.
+     * @param request Request being submitted, nullptr for a posted task.
+     * @return false if the entry should be rejected.
+     */
+    bool
+    Reserve_space(Request *request);
+
+    /** Abort the coalescable head request of the lowest possible priority
+     * class.
+     * @return true if a request was dropped.
+     */
+    bool
+    Drop_head();
+
+    /** Wake up producers blocked on a full queue if any.
+     * @param force Wake up even if no producers are seen blocked.
+     */
+    void
+    Notify_space(bool force = false);
+
+    /** Queue the entry stamping it for statistics. */
+    void
+    Push_entry(Queue_entry *entry, Request::Priority priority);
+
+    /** Process popped queue entry, either request or task. */
+    void
+    Process_entry(Queue_entry *entry);
+
+    /** Process popped entry without statistics recording. */
+    void
+    Process_entry_impl(Queue_entry *entry);
+
+    /** Queue the request without notifying the waiter. */
+    void
+    Push_request(Request::Ptr request);
+
+    /** Check if the request can be submitted to the container.
+     * @throws Internal_error_exception if the container is disabled and the
+     *      request is not being aborted.
+     */
+    void
+    Check_submit(const Request::Ptr& request);
+
     /** Abort all requests which are currently queued in request queue. */
     void
     Abort_requests();
@@ -630,11 +972,34 @@ private:
      */
     std::atomic_bool abort_ongoing = { false };
 
+    /** Number of submissions which passed the enabled check and are pushing
+     * the request. Disabling waits for them before aborting the queue.
+     */
+    std::atomic_int submits_in_flight = { 0 };
+
     /** Human readable name of the container to ease the debugging. */
     const std::string name;
 
-    /** Queue of the requests being abort during context disabling. */
-    std::list<Request::Ptr> aborted_request_queue;
+    /** Processing statistics, null if not collected. Set only while the
+     * container is disabled.
+     */
+    Request_container_stats::Ptr stats;
+
+    /** Queue capacity, zero if unlimited. */
+    std::atomic<size_t> capacity = { 0 };
+    /** Action on queue overflow. */
+    std::atomic<Overflow_policy> overflow_policy = { Overflow_policy::REJECT };
+    /** Overflow counters. */
+    std::atomic<uint64_t> num_blocked = { 0 }, num_rejected = { 0 }, num_dropped = { 0 };
+    /** Number of producers waiting for space. */
+    std::atomic_int blocked_producers = { 0 };
+    /** Protects waiting for space. */
+    std::mutex capacity_mutex;
+    /** Signaled when space appears in the queue or the container is
+     * disabled.
+     */
+    std::condition_variable capacity_cond;
+
 };
 
 /** Request waiter type for convenient usage. */
@@ -693,6 +1058,70 @@ private:
 /** Request type for convenient usage. */
 typedef Request_container::Request Request;
 
+/** Scoped batch of request submissions, possibly to different containers.
+ * Requests are queued immediately but waiters are notified only when the
+ * batch is closed or destroyed, once per distinct waiter. So submitting N
+ * requests to the same worker costs one wakeup.
+ * @code
+ * {
+ *     Request_batch batch;
+ *     for (auto& dev : devices) {
+ *         batch.Submit(dev->Get_processing_ctx(), Make_request(dev));
+ *     }
+ * } // Workers are woken up here.
+ * @endcode
+ */
+class Request_batch {
+public:
+    Request_batch() = default;
+
+    Request_batch(const Request_batch&) = delete;
+
+    /** Notifies pending waiters. */
+    ~Request_batch();
+
+    /** Queue the request into the container, notification is deferred.
+     * @throws Internal_error_exception if the container does not accept the
+     *      request, see Request_container::Submit_request().
+     */
+    void
+    Submit(const Request_container::Ptr& container, Request::Ptr request);
+
+    /** Notify waiters of all containers submitted to so far. The batch can
+     * be reused after that.
+     */
+    void
+    Close();
+
+    /** Makes the batch current for the calling thread while in scope, so
+     * completion notifications of requests completed by the thread (see
+     * Request::Complete()) are submitted through the batch.
+     */
+    class Scope {
+    public:
+        /** Make the batch current. */
+        Scope(Request_batch &batch);
+
+        Scope(const Scope&) = delete;
+
+        /** Restore previously current batch. */
+        ~Scope();
+
+    private:
+        Request_batch *prev;
+    };
+
+    /** Get the batch current for the calling thread.
+     * @return Current batch or nullptr if none.
+     */
+    static Request_batch *
+    Get_current();
+
+private:
+    /** Distinct waiters to notify, usually just a few. */
+    std::vector<Request_waiter::Ptr> waiters;
+};
+
 } /* namespace vsm */
 } /* namespace ugcs */
 
@@ -0,0 +1,208 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file request_pool.h
+ *
+ * Thread pool for processing requests of many request contexts.
+ */
+
+#ifndef _UGCS_VSM_REQUEST_POOL_H_
+#define _UGCS_VSM_REQUEST_POOL_H_
+
+#include <ugcs/vsm/request_context.h>
+
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Fixed size work-stealing thread pool which serves any number of request
+ * contexts created by it. Each context is a strand: its requests are
+ * processed in submission order and never in parallel, but different
+ * contexts are processed by any of the pool threads. It allows many mostly
+ * idle devices to share few threads instead of owning a worker each.
+ * @code
+ * auto pool = Request_pool::Create("Vehicles pool", 4);
+ * pool->Enable();
+ * auto processor = pool->Create_processor("Vehicle processor");
+ * auto completion_ctx = pool->Create_completion_context("Vehicle completion");
+ * processor->Enable();
+ * completion_ctx->Enable();
+ * auto vehicle = My_vehicle::Create(processor, completion_ctx);
+ * @endcode
+ * Pooled contexts should not be added to a Request_worker since it replaces
+ * their waiter.
+ */
+class Request_pool: public std::enable_shared_from_this<Request_pool> {
+    DEFINE_COMMON_CLASS(Request_pool, Request_pool)
+
+public:
+    /** Maximal number of requests processed from one context at once before
+     * the thread switches to another context.
+     */
+    static constexpr int STRAND_BATCH_SIZE = 16;
+
+    /** Waiter of a pooled context. Submission schedules the context for
+     * processing in the pool.
+     */
+    class Strand: public Request_waiter {
+        DEFINE_COMMON_CLASS(Strand, Request_waiter)
+
+    public:
+        /** Construct strand for the pool. */
+        Strand(Request_pool::Ptr pool);
+
+        virtual void
+        Notify() override;
+
+        /** Bind the context which is served by the strand. */
+        void
+        Set_container(Request_container::Ptr container);
+
+        /** Wait until the strand is not being processed by any pool thread.
+         * Returns immediately if called from the strand itself.
+         */
+        void
+        Wait_idle();
+
+    private:
+        friend class Request_pool;
+
+        /** Pool the strand belongs to. */
+        Request_pool::Ptr pool;
+
+        /** Served container. */
+        Request_container::Weak_ptr container;
+
+        /** Strand is queued in the pool or being processed. */
+        std::atomic_bool scheduled = { false };
+
+        /** Protects running flag. */
+        std::mutex run_mutex;
+        std::condition_variable run_cond;
+        /** Strand is currently processed by a pool thread. */
+        bool running = false;
+
+        /** Process a batch of requests, called by a pool thread. */
+        void
+        Run();
+    };
+
+    /** Construct pool.
+     * @param name Pool name, used for logging.
+     * @param num_threads Number of threads, zero to use number of hardware
+     *      threads.
+     */
+    Request_pool(const std::string& name, size_t num_threads = 0);
+
+    virtual
+    ~Request_pool();
+
+    /** Start pool threads. */
+    void
+    Enable();
+
+    /** Stop pool threads. Contexts of the pool should be disabled before. */
+    void
+    Disable();
+
+    /** Create request processor served by the pool. */
+    Request_processor::Ptr
+    Create_processor(const std::string& name);
+
+    /** Create completion context served by the pool. */
+    Request_completion_context::Ptr
+    Create_completion_context(const std::string& name);
+
+    /** Get number of pool threads. */
+    size_t
+    Get_num_threads() const
+    {
+        return workers.size();
+    }
+
+    /** Get number of strands taken by a thread from another thread queue. */
+    uint64_t
+    Get_steal_count() const
+    {
+        return steal_count;
+    }
+
+private:
+    /** Pool thread with its own queue of scheduled strands. */
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Strand::Ptr> queue;
+        std::thread thread;
+    };
+
+    std::string name;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    /** Protects idle state. */
+    std::mutex idle_mutex;
+    std::condition_variable idle_cond;
+    /** Number of threads sleeping on idle_cond. */
+    int num_idle = 0;
+    /** Threads should exit. */
+    bool stop = false;
+
+    /** Number of strands in worker queues. */
+    std::atomic_int num_scheduled = { 0 };
+
+    /** Round-robin index for submissions from foreign threads. */
+    std::atomic<size_t> next_worker = { 0 };
+
+    std::atomic<uint64_t> steal_count = { 0 };
+
+    bool is_enabled = false;
+
+    /** Queue the strand for processing. */
+    void
+    Schedule(Strand::Ptr strand);
+
+    /** Take a strand from own queue or steal from others.
+     * @return Strand or nullptr if all queues are empty.
+     */
+    Strand::Ptr
+    Take(size_t index);
+
+    void
+    Thread_loop(size_t index);
+};
+
+/** Request context which is processed by a Request_pool strand.
+ * @param is_processor Request processor if "true", request completion context
+ *      otherwise.
+ */
+template <bool is_processor>
+class Pooled_request_context: public Request_context<is_processor> {
+    DEFINE_COMMON_CLASS(Pooled_request_context, Request_container)
+
+public:
+    /** Construct context served by the given strand. */
+    Pooled_request_context(const std::string& name, Request_pool::Strand::Ptr strand):
+        Request_context<is_processor>(name, strand), strand(strand)
+    {}
+
+private:
+    Request_pool::Strand::Ptr strand;
+
+    /** Stop processing, wait for a batch in progress if any. */
+    virtual void
+    On_disable() override
+    {
+        this->Set_disabled();
+        strand->Wait_idle();
+    }
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_REQUEST_POOL_H_ */
@@ -0,0 +1,198 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file request_stats.h
+ *
+ * Optional processing statistics of request containers.
+ */
+
+#ifndef _UGCS_VSM_REQUEST_STATS_H_
+#define _UGCS_VSM_REQUEST_STATS_H_
+
+#include <ugcs/vsm/utils.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Lock-free histogram of durations with power of two buckets in
+ * microseconds. Recording is wait-free and can be done from any thread.
+ */
+class Latency_histogram {
+public:
+    /** Number of buckets. Bucket 0 holds values below 1us, bucket i holds
+     * values in [2^(i-1), 2^i) us, the last one holds everything above.
+     */
+    static constexpr int NUM_BUCKETS = 32;
+
+    /** Consistent enough copy of the histogram. */
+    struct Snapshot {
+        /** Number of recorded values. */
+        uint64_t count = 0;
+        /** Sum of recorded values. */
+        std::chrono::microseconds total = std::chrono::microseconds::zero();
+        /** Maximal recorded value. */
+        std::chrono::microseconds max = std::chrono::microseconds::zero();
+        /** Number of values in each bucket. */
+        uint64_t buckets[NUM_BUCKETS] = {};
+
+        /** Get the upper bound of the bucket where the given percentile
+         * falls, but not more than the maximal value.
+         * @param percentile Percentile in range [0; 100].
+         */
+        std::chrono::microseconds
+        Get_percentile(double percentile) const;
+
+        /** Get mean value. */
+        std::chrono::microseconds
+        Get_mean() const;
+    };
+
+    /** Record a value. */
+    void
+    Record(std::chrono::steady_clock::duration value);
+
+    /** Get current values. */
+    Snapshot
+    Get_snapshot() const;
+
+    /** Clear the histogram. Values recorded concurrently may be lost. */
+    void
+    Reset();
+
+private:
+    std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+    std::atomic<uint64_t> total_us = { 0 };
+    std::atomic<uint64_t> max_us = { 0 };
+};
+
+/** Statistics of request containers with the same name. */
+class Request_container_stats: public std::enable_shared_from_this<Request_container_stats> {
+    DEFINE_COMMON_CLASS(Request_container_stats, Request_container_stats)
+
+public:
+    /** Statistics values for a period. */
+    struct Snapshot {
+        /** Container name. */
+        std::string name;
+        /** Time between submission and the start of processing. */
+        Latency_histogram::Snapshot queue_latency;
+        /** Time spent in processing handlers. */
+        Latency_histogram::Snapshot processing_time;
+        /** Number of submitted requests and tasks. */
+        uint64_t submitted = 0;
+        /** Maximal queue depth seen on submission. */
+        size_t max_queue_depth = 0;
+        /** Duration of the period. */
+        std::chrono::steady_clock::duration period;
+
+        /** Get processed requests per second over the period. */
+        double
+        Get_throughput() const;
+    };
+
+    /** Construct statistics for the given container name. */
+    Request_container_stats(const std::string &name);
+
+    /** Record entry submission.
+     * @param queue_depth Queue size after the entry is queued.
+     */
+    void
+    Record_submit(size_t queue_depth);
+
+    /** Record entry processing.
+     * @param queue_latency Time the entry spent in the queue.
+     * @param processing_time Time spent in the handler.
+     */
+    void
+    Record_process(std::chrono::steady_clock::duration queue_latency,
+                   std::chrono::steady_clock::duration processing_time);
+
+    /** Get the values collected since creation or last reset.
+     * @param reset Start new period.
+     */
+    Snapshot
+    Get_snapshot(bool reset = false);
+
+    /** Get the container name. */
+    const std::string &
+    Get_name() const
+    {
+        return name;
+    }
+
+private:
+    const std::string name;
+    Latency_histogram queue_latency;
+    Latency_histogram processing_time;
+    std::atomic<uint64_t> submitted = { 0 };
+    std::atomic<size_t> max_queue_depth = { 0 };
+    /** Start of the current period. */
+    std::atomic<std::chrono::steady_clock::rep> period_start;
+};
+
+/** Global registry of request container statistics keyed by container name.
+ * Containers collect statistics if the registry is enabled when they are
+ * enabled, or if requested by Request_container::Enable_stats().
+ * @code
+ * Request_stats_registry::Get_instance()->Set_enabled(true);
+ * ...
+ * // Periodically, e.g. from a timer.
+ * Request_stats_registry::Get_instance()->Dump();
+ * @endcode
+ */
+class Request_stats_registry {
+public:
+    /** Get global instance. */
+    static Request_stats_registry *
+    Get_instance();
+
+    /** Enable statistics collection for all containers enabled after
+     * this call.
+     */
+    void
+    Set_enabled(bool enabled);
+
+    /** Check if collection for all containers is enabled. */
+    bool
+    Is_enabled() const
+    {
+        return enabled;
+    }
+
+    /** Get statistics object for the given container name. It is created
+     * if not yet exists.
+     */
+    Request_container_stats::Ptr
+    Get_stats(const std::string &name);
+
+    /** Get values of all registered containers sorted by name.
+     * @param reset Start new period for each container.
+     */
+    std::vector<Request_container_stats::Snapshot>
+    Get_snapshots(bool reset = false);
+
+    /** Write statistics of all registered containers to the log, one line
+     * per container, and start new period.
+     */
+    void
+    Dump();
+
+private:
+    std::atomic_bool enabled = { false };
+    std::mutex mutex;
+    std::map<std::string, Request_container_stats::Ptr> stats;
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_REQUEST_STATS_H_ */
@@ -12,6 +12,7 @@
 #define _UGCS_VSM_REQUEST_WORKER_H_
 
 #include <ugcs/vsm/request_context.h>
+#include <ugcs/vsm/local_timer_queue.h>
 
 #include <thread>
 
@@ -54,11 +55,32 @@ public:
     void
     Disable_containers();
 
+    /** Local timer type. */
+    typedef Local_timer_queue::Timer Timer;
+
+    /** Create and schedule a timer processed by the worker thread. The
+     * handler is invoked directly in the worker thread, the nearest timer
+     * expiration is used as the worker wait deadline. So timers owned by
+     * the worker thread never involve Timer_processor thread. Timers are
+     * canceled when the worker is disabled. See
+     * Timer_processor::Create_timer() for the handler semantics.
+     *
+     * @param interval Timer interval.
+     * @param handler Handler to invoke, should be non-empty.
+     * @return Timer object which can be used to cancel running timer.
+     * @throw Invalid_param_exception if handler is not set.
+     */
+    Timer::Ptr
+    Create_timer(std::chrono::microseconds interval,
+                 const Local_timer_queue::Handler &handler);
+
 private:
     /** Dedicated thread. */
     std::thread thread;
     /** Associated containers. */
     std::list<Request_container::Ptr> containers;
+    /** Timers processed by the worker thread. */
+    Local_timer_queue::Ptr timers = Local_timer_queue::Create();
 
     /** Handle container enabling. */
     virtual void
@@ -14,6 +14,7 @@
 #include <ugcs/vsm/utils.h>
 #include <ugcs/vsm/reference_guard.h>
 #include <ugcs/vsm/sockets.h>
+#include <cstring>
 #include <string>
 
 namespace ugcs {
@@ -35,6 +36,38 @@ public:
 
     virtual ~Socket_address();
 
+    /** Compact endpoint identity (family, address and port) which is built
+     * from raw sockaddr without allocations. Used for fast lookup of known
+     * peers, Socket_address objects are created only for the new ones.
+     */
+    struct Key {
+        uint16_t family = AF_UNSPEC;
+        /** Port in network byte order. */
+        uint16_t port = 0;
+        /** Address in network byte order, IPv4 one occupies first four
+         * bytes.
+         */
+        uint8_t address[16] = {};
+
+        Key() = default;
+
+        /** Make key of IPv4 or IPv6 endpoint. Only the family is kept for
+         * other ones.
+         */
+        explicit Key(const sockaddr_storage &storage);
+
+        bool
+        operator ==(const Key &other) const
+        {
+            return family == other.family && port == other.port &&
+                   memcmp(address, other.address, sizeof(address)) == 0;
+        }
+    };
+
+    /** Get the key of this address. */
+    Key
+    Get_key();
+
     /** Set the generic address
      */
     void
@@ -131,6 +164,20 @@ template<> struct hash<::ugcs::vsm::Socket_address::Ptr>
     size_t
     operator()(::ugcs::vsm::Socket_address::Ptr const& s) const;
 };
+template<> struct hash<::ugcs::vsm::Socket_address::Key>
+{
+    size_t
+    operator()(::ugcs::vsm::Socket_address::Key const& k) const
+    {
+        uint64_t high, low;
+        memcpy(&high, k.address, sizeof(high));
+        memcpy(&low, k.address + sizeof(high), sizeof(low));
+        uint64_t h = (uint64_t(k.family) << 16) | k.port;
+        h ^= high + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+        h ^= low + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
 template<> struct equal_to<::ugcs::vsm::Socket_address::Ptr>
 {
     bool
@@ -11,6 +11,7 @@
 #define _UGCS_VSM_SOCKET_PROCESSOR_H_
 
 #include <ugcs/vsm/io_request.h>
+#include <ugcs/vsm/local_timer_queue.h>
 #include <ugcs/vsm/piped_request_waiter.h>
 #include <ugcs/vsm/singleton.h>
 #include <ugcs/vsm/socket_address.h>
@@ -37,12 +38,27 @@ class Socket_processor: public Request_processor
 {
     DEFINE_COMMON_CLASS(Socket_processor, Request_container)
 public:
+    /** Readiness notification mechanism of the processor loop. */
+    enum class Backend {
+        /** select() with descriptor sets rebuilt on each loop pass from all
+         * streams. Limited by FD_SETSIZE descriptors.
+         */
+        SELECT,
+        /** Level-triggered epoll with persistent registrations, modified
+         * only when the interest set of a stream changes. Linux only, SELECT
+         * is used if not supported.
+         */
+        EPOLL
+    };
+
     /**
      * Constructor.
      * @param piped_waiter Request waiter based on a pipe to multiplex socket
      * and request operations using select.
+     * @param backend Readiness notification mechanism.
      */
-    Socket_processor(Piped_request_waiter::Ptr piped_waiter = Piped_request_waiter::Create());
+    Socket_processor(Piped_request_waiter::Ptr piped_waiter = Piped_request_waiter::Create(),
+                     Backend backend = Backend::SELECT);
 
     virtual
     ~Socket_processor();
@@ -51,6 +67,13 @@ public:
     static Ptr
     Create();
 
+    /** Get readiness notification mechanism used. */
+    Backend
+    Get_backend() const
+    {
+        return backend;
+    }
+
     /** Get global or create new processor instance. */
     template <typename... Args>
     static Ptr
@@ -236,7 +259,7 @@ public:
         // UDP multi-stream specific stuff.
         typedef std::pair<Buf_ptr, Socket_address::Ptr> Cache_entry;
         // Accepted UDP streams for this stream/socket.
-        std::unordered_map<Socket_address::Ptr, Stream::Ptr> substreams;
+        std::unordered_map<Socket_address::Key, Stream::Ptr> substreams;
         // If present then this is a substream of another stream.
         Stream::Ptr parent_stream = nullptr;
         // Packet cache. Keeps unread packets until Read called.
@@ -245,6 +268,30 @@ public:
         // When cache is full packets will be dropped.
         static constexpr size_t MAX_CACHED_COUNT = 50;
 
+        // TCP receive ring. One recv() reads ahead as much as the socket has,
+        // read requests get zero-copy slices of receive_buffer. The ring is
+        // written only after receive_end, so given out slices are intact.
+        static constexpr size_t RECEIVE_RING_SIZE = 65536;
+        // Reads up to this size are copied out of the ring. A slice keeps the
+        // whole ring allocated, so a small buffer held by the user would pin
+        // 64 KB. Larger reads still get slices, retaining the ring while they
+        // are alive.
+        static constexpr size_t RECEIVE_COPY_SIZE = 1024;
+        // Whole ring, nullptr until the first read.
+        Io_buffer::Ptr receive_buffer;
+        // Writable ring memory owned by receive_buffer.
+        uint8_t *receive_data = nullptr;
+        // Received but not yet consumed data range.
+        size_t receive_begin = 0, receive_end = 0;
+
+        // EPOLL backend registration state, see Socket_processor::Sync_polled_streams().
+        // Socket registered in epoll, INVALID_SOCKET if none.
+        sockets::Socket_handle polled_socket = INVALID_SOCKET;
+        // Registered interest flags.
+        int polled_interest = 0;
+        // Stream is queued for registration update.
+        bool is_dirty = false;
+
         friend class Socket_processor;
 
         sockets::Socket_handle
@@ -275,8 +322,44 @@ public:
         Close_impl(Close_handler completion_handler,
                    Request_completion_context::Ptr comp_ctx) override;
 
+        /** @see Io_stream::Write_inline_impl */
+        Operation_waiter
+        Write_inline_impl(Io_buffer::Ptr buffer, Offset offset, Io_result &result_arg,
+                          Request::Inline_handler &&completion_handler,
+                          Request_completion_context::Ptr comp_ctx) override;
+
+        /** @see Io_stream::Read_inline_impl */
+        Operation_waiter
+        Read_inline_impl(size_t max_to_read, size_t min_to_read, Offset offset,
+                         Io_buffer::Ptr &buffer_arg, Io_result &result_arg,
+                         Request::Inline_handler &&completion_handler,
+                         Request_completion_context::Ptr comp_ctx) override;
+
+        /** Set processing and cancellation handlers of the write request
+         * and submit it.
+         */
+        void
+        Submit_write(Write_request::Ptr request);
+
+        /** Set processing and cancellation handlers of the read request and
+         * submit it.
+         */
+        void
+        Submit_read(Read_request::Ptr request);
+
         void
         Process_udp_read_requests();
+
+        /** Make sure the receive ring can hold size bytes after
+         * receive_begin. Otherwise new ring is started with the data not
+         * consumed yet, the old one is kept alive by the slices.
+         */
+        void
+        Reserve_receive_ring(size_t size);
+
+        /** Drop the receive ring with the data not consumed. */
+        void
+        Release_receive_ring();
     };
 
     /** Stream type is used for listener socket type also. */
@@ -440,6 +523,39 @@ public:
     static std::list<Local_interface>
     Enumerate_local_interfaces();
 
+    /** Local timer type. */
+    typedef Local_timer_queue::Timer Timer;
+
+    /** Create and schedule a timer processed by the processor thread. The
+     * handler is invoked directly in the processor thread, the nearest timer
+     * expiration is used as the select() timeout. See
+     * Timer_processor::Create_timer() for the handler semantics.
+     *
+     * @param interval Timer interval. Coarser durations, e.g.
+     *      std::chrono::milliseconds, are converted implicitly.
+     * @param handler Handler to invoke, should be non-empty.
+     * @return Timer object which can be used to cancel running timer.
+     * @throw Invalid_param_exception if handler is not set.
+     */
+    Timer::Ptr
+    Create_timer(std::chrono::microseconds interval,
+                 const Local_timer_queue::Handler &handler);
+
+    /** Schedule timeout for an operation of this processor. Unlike
+     * Operation_waiter::Timeout(), the deadline is enforced in the processor
+     * thread, so no other threads are involved. The operation is completed
+     * with Io_result::TIMED_OUT if it is not done when the timeout elapses.
+     * Replaces the done handler of the request, so should not be used
+     * together with Operation_waiter::Timeout() or
+     * Operation_waiter::Set_done_handler().
+     *
+     * @param waiter Operation returned by this processor or its stream.
+     * @param timeout Timeout for the operation, the same unit as for
+     *      Create_timer().
+     */
+    void
+    Set_timeout(Operation_waiter &waiter, std::chrono::microseconds timeout);
+
 protected:
     /** Worker thread of socket processor. */
     std::thread thread;
@@ -451,6 +567,9 @@ protected:
      */
     Request_completion_context::Ptr completion_ctx;
 
+    /** Timers processed by the processor thread. */
+    Local_timer_queue::Ptr timers = Local_timer_queue::Create();
+
     /** Handle processor enabling. */
     void
     On_enable() override;
@@ -518,6 +637,58 @@ private:
 
     Streams_map streams;
 
+    /** Readiness notification mechanism used. */
+    Backend backend;
+
+    /** Stream interest flags, see Get_interest(). */
+    enum {
+        INTEREST_READ = 1,
+        INTEREST_WRITE = 2,
+        INTEREST_ERROR = 4
+    };
+
+    /** Readiness of a socket reported by epoll. */
+    struct Poll_event {
+        sockets::Socket_handle socket;
+        /** Interest flags the socket is ready for. */
+        int events;
+    };
+
+    /** epoll instance descriptor, -1 if not used. */
+    int epoll_fd = -1;
+    /** Registered streams by socket. Stream lifetime is controlled by the
+     * streams map, so a stream closed and destroyed without registration
+     * update is detected by the expired pointer.
+     */
+    std::unordered_map<sockets::Socket_handle, std::weak_ptr<Stream>> polled_streams;
+    /** Streams which registration should be updated before waiting. */
+    std::vector<Stream::Ptr> dirty_streams;
+    /** Events returned by the last Epoll_wait(). */
+    std::vector<Poll_event> poll_events;
+
+    /** Maximal number of datagrams transferred by one UDP batch system
+     * call.
+     */
+    static constexpr size_t UDP_BATCH_SIZE = 32;
+
+    /** Write request collected for Udp_send_batch(). */
+    struct Udp_write_entry {
+        Stream::Ptr stream;
+        Write_request::Ptr request;
+        /** Keeps the request from being aborted until it is sent. */
+        Request::Locker locker;
+        Io_buffer::Ptr buffer;
+        /** Destination, nullptr for connected socket. */
+        Socket_address::Ptr address;
+    };
+
+    /** Receive buffer of UDP batch reads, UDP_BATCH_SIZE slots of
+     * MIN_UDP_PAYLOAD_SIZE_TO_READ bytes, allocated on first use.
+     */
+    std::vector<uint8_t> udp_read_buffer;
+    /** Write requests being sent by Handle_udp_write_requests(). */
+    std::vector<Udp_write_entry> udp_write_batch;
+
     /** Socket processor singleton instance. */
     static Singleton<Socket_processor> singleton;
 
@@ -541,9 +712,35 @@ private:
     void
     Handle_read_requests(Stream::Ptr stream);
 
+    /** Serve read requests of TCP stream from its receive ring, refilling it
+     * from the socket when it has less data than requested.
+     */
+    void
+    Handle_tcp_read_requests(Stream::Ptr stream);
+
     void
     Handle_udp_read_requests(Stream::Ptr stream);
 
+    /** Pass received datagram to the substream of its sender, to a pending
+     * accept request or to the stream packet cache. Sender address object is
+     * created only if it is not a known substream peer.
+     */
+    void
+    Handle_udp_datagram(const Stream::Ptr &stream, Stream::Buf_ptr data,
+                        const sockaddr_storage &address);
+
+    /** Send pending writes of UDP stream and its substreams, which share the
+     * socket, in batches of up to UDP_BATCH_SIZE datagrams.
+     */
+    void
+    Handle_udp_write_requests(Stream::Ptr stream);
+
+    /** Collect processable write requests of the stream to udp_write_batch
+     * until it is full.
+     */
+    void
+    Collect_udp_write_requests(const Stream::Ptr &stream);
+
     /** Close and remove from streams. must be called with all stream requests unlocked!*/
     void
     Close_stream(Stream::Ptr stream, bool remove_from_streams = true);
@@ -554,6 +751,91 @@ private:
     /** return true if request was cancelled successfully */
     bool
     Check_for_cancel_request(Io_request::Ptr request, bool force_cancel);
+
+    /** Operation timeout set by Set_timeout() elapsed. */
+    bool
+    On_operation_timeout(Io_request::Ptr request);
+
+    /** Get interest flags of the stream according to its state and pending
+     * requests.
+     */
+    static int
+    Get_interest(const Stream::Ptr &stream);
+
+    /** Wait for events using select() and handle them. */
+    void
+    Wait_select(std::chrono::microseconds delay);
+
+    /** Wait for events using epoll and handle them. */
+    void
+    Wait_epoll(std::chrono::microseconds delay);
+
+    /** Handle readiness events of the stream.
+     * @param events Interest flags the stream socket is ready for.
+     */
+    void
+    Handle_stream_events(const Stream::Ptr &stream, int events);
+
+    /** Queue registration update of the stream (or its parent for
+     * substreams). Does nothing for SELECT backend.
+     */
+    void
+    Mark_dirty(const Stream::Ptr &stream);
+
+    /** Update epoll registrations of streams marked dirty. Registrations
+     * are re-armed for streams which are still interested in events, so
+     * readiness which was not consumed is reported again.
+     */
+    void
+    Sync_polled_streams();
+
+    /** Remove epoll registration of the stream if any. */
+    void
+    Unpoll_stream(const Stream::Ptr &stream);
+
+    /** Create epoll instance and register wait pipe there.
+     * @return false if epoll is not supported on the platform.
+     */
+    bool
+    Epoll_open();
+
+    /** Close epoll instance. */
+    void
+    Epoll_close();
+
+    /** Add or modify socket registration with the given interest flags. */
+    void
+    Epoll_control(sockets::Socket_handle s, int interest, bool add);
+
+    /** Remove socket registration. */
+    void
+    Epoll_remove(sockets::Socket_handle s);
+
+    /** Wait for events filling poll_events.
+     * @param delay Wait timeout, zero for indefinite wait.
+     * @return true if the wait pipe is signalled.
+     */
+    bool
+    Epoll_wait(std::chrono::microseconds delay);
+
+    /** Receive up to UDP_BATCH_SIZE datagrams into udp_read_buffer slots,
+     * with a single system call where the platform allows.
+     * @param addresses Filled with sender addresses.
+     * @param lengths Filled with datagram lengths.
+     * @return Number of datagrams received, less than UDP_BATCH_SIZE if no
+     *      more are queued, -1 on error (including no data available).
+     */
+    int
+    Udp_receive_batch(sockets::Socket_handle s, sockaddr_storage *addresses,
+                      size_t *lengths);
+
+    /** Send datagrams of udp_write_batch, with a single system call where the
+     * platform allows.
+     * @return Number of datagrams sent from the batch start, -1 if the
+     *      first one failed.
+     */
+    int
+    Udp_send_batch(sockets::Socket_handle s);
 };
 
 // @{
@@ -6,6 +6,7 @@
 #define _UGCS_VSM_SUBSYSTEM_H_
 
 #include <ugcs/vsm/property.h>
+#include <ugcs/vsm/request_container.h>
 
 #include <memory>
 #include <unordered_map>
@@ -70,12 +71,24 @@ public:
     Is_mission_item()
         {return in_mission;}
 
+    // Priority class of the requests which execute the command. Commands
+    // are executed in arrival order only within one class, so commands which
+    // may undo each other (e.g. takeoff and land) should share it.
+    void
+    Set_priority(Request::Priority priority)
+    {this->priority = priority;}
+
+    Request::Priority
+    Get_priority()
+        {return priority;}
+
 private:
     uint32_t command_id = 0;
     std::unordered_map<int, Property::Ptr> parameters;
     std::string name;
 
     bool in_mission = false;
+    Request::Priority priority = Request::Priority::NORMAL;
 
     bool is_available = false;
     bool is_enabled = false;
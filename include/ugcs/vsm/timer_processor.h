@@ -12,9 +12,11 @@
 #define _UGCS_VSM_TIMER_PROCESSOR_H_
 
 #include <ugcs/vsm/request_context.h>
+#include <ugcs/vsm/request_stats.h>
 #include <ugcs/vsm/singleton.h>
 #include <thread>
 #include <map>
+#include <vector>
 
 namespace ugcs {
 namespace vsm {
@@ -32,7 +34,109 @@ public:
         return singleton.Get_instance(std::forward<Args>(args)...);
     }
 
-    Timer_processor();
+    /** Data structure for pending timers. */
+    enum class Backend {
+        /** Ordered map, O(log n) insertion and cancellation, no wakeups
+         * except for timer expiration.
+         */
+        TREE,
+        /** Hierarchical timing wheel with millisecond slots, O(1) insertion
+         * and cancellation. The processor thread wakes up at least every
+         * Timer_wheel::LEVEL_SIZE milliseconds while there are pending
+         * timers. Preferable for many short-living timers, e.g. operation
+         * timeouts which are mostly canceled before expiration.
+         */
+        WHEEL
+    };
+
+    /** Precision of timers firing. */
+    enum class Resolution {
+        /** Fire time is rounded to milliseconds. */
+        MILLISECONDS,
+        /** Fire time is tracked in microseconds and the processor thread
+         * waits with microseconds precision, so periodic timers have less
+         * jitter. Supported by TREE backend only.
+         */
+        MICROSECONDS
+    };
+
+    /** Construct timer processor.
+     * @param backend Data structure for pending timers.
+     * @param resolution Precision of timers firing.
+     * @throw Invalid_param_exception if the resolution is not supported by
+     *      the backend.
+     */
+    Timer_processor(Backend backend = Backend::TREE,
+                    Resolution resolution = Resolution::MILLISECONDS);
+
+    /** Get precision of timers firing. */
+    Resolution
+    Get_resolution() const
+    {
+        return resolution;
+    }
+
+    /** Set coalescing window. Timers which are due within the window after
+     * an expiring timer are fired together with it, so periodic timers with
+     * close phases cause a single wakeup of the processor and of each
+     * completion context they are serving.
+     * @param window Maximal time a timer can be fired before its fire time.
+     *      Zero (default) disables coalescing.
+     */
+    void
+    Set_coalescing_window(std::chrono::microseconds window)
+    {
+        coalescing_window = window.count();
+    }
+
+    /** Get coalescing window. */
+    std::chrono::microseconds
+    Get_coalescing_window() const
+    {
+        return std::chrono::microseconds(coalescing_window);
+    }
+
+    /** Get the data structure used for pending timers. */
+    Backend
+    Get_backend() const
+    {
+        return backend;
+    }
+
+    /** Timers load and lateness statistics. */
+    struct Stats {
+        /** Time between the timer fire time and its firing by the processor
+         * thread. Early fired timers (see Set_coalescing_window()) are
+         * recorded as zero.
+         */
+        Latency_histogram::Snapshot fire_lateness;
+        /** Time between the timer fire time and its handler invocation, i.e.
+         * includes queueing in the handler container.
+         */
+        Latency_histogram::Snapshot handler_lateness;
+        /** Number of running timers. */
+        size_t active_timers = 0;
+        /** Maximal number of running timers. */
+        size_t max_active_timers = 0;
+        /** Number of timers attached to another timer with the same fire
+         * tick, TREE backend only.
+         */
+        uint64_t attached_timers = 0;
+        /** Maximal length of timers chain with the same fire tick, TREE
+         * backend only.
+         */
+        size_t max_attach_chain = 0;
+    };
+
+    /** Get timers statistics collected since creation or last reset.
+     * @param reset Start new period.
+     */
+    Stats
+    Get_stats(bool reset = false);
+
+    /** Write timers statistics to the log and start new period. */
+    void
+    Dump_stats();
 
     /** Timer handler. It should return boolean value with the following
      * meanings:
@@ -41,6 +145,8 @@ public:
      */
     typedef Callback_proxy<bool> Handler;
 
+    class Timer_wheel;
+
     /** Represents timer instance. */
     class Timer: public std::enable_shared_from_this<Timer> {
         DEFINE_COMMON_CLASS(Timer, Timer)
@@ -48,7 +154,7 @@ public:
     public:
         /** Construct timer instance associated with a processor. */
         Timer(const Timer_processor::Ptr &processor,
-              std::chrono::milliseconds interval);
+              std::chrono::microseconds interval);
 
         /** Cancel running timer. Do nothing if timer is not running. */
         void
@@ -69,13 +175,14 @@ public:
 
     private:
         friend class Timer_processor;
+        friend class Timer_wheel;
 
         /** Related processor. */
         Timer_processor::Ptr processor;
         /** Indicates that timer is currently running. */
         bool is_running = true;
         /** Timer interval. */
-        std::chrono::milliseconds interval;
+        std::chrono::microseconds interval;
         /** Time when the timer should be fired next time. */
         std::chrono::steady_clock::time_point fire_time;
         /** Associated request. */
@@ -84,6 +191,12 @@ public:
         mutable std::mutex mutex;
         /** List of attached timers in the same slot. */
         std::list<Ptr> attached_timers;
+        /** Next timer in the same wheel slot. */
+        Ptr wheel_next;
+        /** Previous timer in the same wheel slot. */
+        Timer *wheel_prev = nullptr;
+        /** Wheel slot head, nullptr if not linked to the wheel. */
+        Ptr *wheel_slot = nullptr;
 
         /** Set associated request. */
         void
@@ -101,8 +214,10 @@ public:
         void
         Destroy(bool cancel = false);
 
-        /** Attach timer which occupies the same slot. */
-        void
+        /** Attach timer which occupies the same slot.
+         * @return Number of attached timers.
+         */
+        size_t
         Attach(Timer::Ptr &timer);
 
         /** Attach timers which were previously attached to another timer. */
@@ -123,7 +238,8 @@ public:
      * one-shot is defined by the provided handler - while it is returning "true"
      * the timer is re-scheduled with the same interval.
      *
-     * @param interval Timer interval.
+     * @param interval Timer interval, sub-millisecond part is used in
+     *      Resolution::MICROSECONDS mode only.
      * @param handler Handler to invoke, should be non-empty. See {@link Handler}.
      * @param container Container where the handler will be executed.
      * @return Timer object which can be used, for example, to cancel running
@@ -131,23 +247,127 @@ public:
      * @throw Invalid_param_exception if Handler or container is not set.
      */
     Timer::Ptr
-    Create_timer(std::chrono::milliseconds interval, const Handler &handler,
+    Create_timer(std::chrono::microseconds interval, const Handler &handler,
                  Request_container::Ptr container);
 
     /** Cancel the specified timer in case it is running. */
     void
     Cancel_timer(Timer::Ptr timer);
 
-private:
     /** Type used for indexing timers tree, effectively ticks counter type. */
     typedef decltype(std::chrono::milliseconds().count()) Tick_type;
 
+    /** Hierarchical timing wheel. Level 0 has a slot for each millisecond
+     * tick, each next level slot covers the whole previous level. Timers are
+     * moved to lower levels when the wheel time reaches their slot. Timers
+     * beyond the last level are kept in its farthest slot and re-inserted
+     * when reached. Not thread-safe.
+     */
+    class Timer_wheel {
+    public:
+        /** Number of bits of tick count for level slot index. */
+        static constexpr int LEVEL_BITS = 6;
+        /** Number of slots in a level. */
+        static constexpr int LEVEL_SIZE = 1 << LEVEL_BITS;
+        /** Number of levels, covers about 12 days. */
+        static constexpr int NUM_LEVELS = 5;
+
+        Timer_wheel(const Timer_wheel &) = delete;
+
+        Timer_wheel() = default;
+
+        /** Insert the timer according to its fire time.
+         * @param timer Timer to insert.
+         * @param now Current ticks.
+         */
+        void
+        Insert(const Timer::Ptr &timer, Tick_type now);
+
+        /** Remove the timer if it is in the wheel. */
+        void
+        Remove(Timer &timer);
+
+        /** Advance wheel time to the given tick removing expired timers.
+         * @param now Current ticks.
+         * @param expired Expired timers are appended there.
+         */
+        void
+        Advance(Tick_type now, std::vector<Timer::Ptr> &expired);
+
+        /** Remove timers which expire not later than the given tick without
+         * advancing the wheel time, e.g. to fire them early with the expired
+         * ones. Only timers within LEVEL_SIZE ticks from the wheel time are
+         * collected.
+         * @param until Last tick to collect timers for.
+         * @param expired Collected timers are appended there.
+         */
+        void
+        Collect(Tick_type until, std::vector<Timer::Ptr> &expired);
+
+        /** Get the tick when Advance() should be called next time. Valid if
+         * the wheel is not empty.
+         */
+        Tick_type
+        Get_next_tick() const;
+
+        /** Check if there are no timers in the wheel. */
+        bool
+        Is_empty() const
+        {
+            return !size;
+        }
+
+        /** Get any timer from the wheel, nullptr if empty. */
+        Timer::Ptr
+        Get_any() const;
+
+    private:
+        /** Slots heads, timers are linked by Timer::wheel_next. */
+        Timer::Ptr slots[NUM_LEVELS][LEVEL_SIZE];
+        /** Next tick to process. */
+        Tick_type current = 0;
+        /** Number of timers in the wheel. */
+        size_t size = 0;
+
+        /** Link the timer to the slot according to its fire time. */
+        void
+        Link(Timer::Ptr timer);
+
+        /** Unlink all timers from the slot.
+         * @return Unlinked timers.
+         */
+        std::vector<Timer::Ptr>
+        Take_slot(Timer::Ptr &slot);
+    };
+
+private:
+
     /** Dedicated processor thread. */
     std::thread thread;
-    /** Timer tree. */
+    /** Data structure used for pending timers. */
+    const Backend backend;
+    /** Precision of timers firing. */
+    const Resolution resolution;
+    /** Coalescing window in microseconds. */
+    std::atomic<std::chrono::microseconds::rep> coalescing_window = { 0 };
+    /** Timer tree, used by TREE backend. */
     std::map<Tick_type, Timer::Ptr> tree;
+    /** Timing wheel, used by WHEEL backend. Protected by tree_lock. */
+    Timer_wheel wheel;
     /** Mutex for protecting tree access. */
     std::mutex tree_lock;
+    /** Lateness of timers firing. */
+    Latency_histogram fire_lateness;
+    /** Lateness of timer handlers invocation. */
+    Latency_histogram handler_lateness;
+    /** Number of running timers. */
+    std::atomic<size_t> active_timers = { 0 };
+    /** Maximal number of running timers in the current period. */
+    std::atomic<size_t> max_active_timers = { 0 };
+    /** Number of attached timers in the current period. */
+    std::atomic<uint64_t> attached_timers = { 0 };
+    /** Maximal attach chain length in the current period. */
+    std::atomic<size_t> max_attach_chain = { 0 };
     /** Singleton object. */
     static Singleton<Timer_processor> singleton;
 
@@ -163,6 +383,28 @@ private:
     virtual void
     On_wait_and_process() override;
 
+    /** Fire expired timers of TREE backend. Tree lock should be held.
+     * @return Delay until the next timer expiration, zero if no timers.
+     */
+    std::chrono::microseconds
+    Fire_tree_timers();
+
+    /** Fire expired timers of WHEEL backend. Tree lock should be held.
+     * @return Delay until the next wheel advance, zero if no timers.
+     */
+    std::chrono::microseconds
+    Fire_wheel_timers();
+
+    /** Get tree key for the time according to the resolution. */
+    Tick_type
+    Get_tree_key(const std::chrono::steady_clock::time_point &time) const;
+
+    /** Get delay until the timer should be fired, rounded according to the
+     * resolution.
+     */
+    std::chrono::microseconds
+    Get_fire_delay(const std::chrono::steady_clock::time_point &fire_time) const;
+
     /** Called when timer request processing started. */
     void
     Timer_process_handler(Timer::Ptr timer);
@@ -176,7 +418,11 @@ private:
     void
     Insert_timer(Timer::Ptr &timer);
 
-    /** Get absolute ticks count from clock time. */
+    /** Update atomic maximum. */
+    static void
+    Update_max(std::atomic<size_t> &max, size_t value);
+
+    /** Get absolute milliseconds ticks count from clock time. */
     static Tick_type
     Get_ticks(const std::chrono::steady_clock::time_point &time);
 
@@ -435,7 +435,9 @@ private:
      */
     template<class Request_ptr>
     void
-    Submit_vehicle_request(Request_ptr vehicle_request)
+    Submit_vehicle_request(
+            Request_ptr vehicle_request,
+            Request::Priority priority = Request::Priority::NORMAL)
     {
         using Request = typename Request_ptr::element_type;
         using Handle = typename Request::Handle;
@@ -446,6 +448,7 @@ private:
                                           Shared_from_this(),
                                           Handle(vehicle_request));
         vehicle_request->request->Set_processing_handler(proc_handler);
+        vehicle_request->request->Set_priority(priority);
         processor->Submit_request(vehicle_request->request);
     }
 
@@ -17,10 +17,15 @@
 #include <ugcs/vsm/socket_processor.h>
 #include <ugcs/vsm/hid_processor.h>
 #include <ugcs/vsm/mavlink_stream.h>
+#include <ugcs/vsm/mavlink_mission_uploader.h>
+#include <ugcs/vsm/mavlink_param_fetcher.h>
+#include <ugcs/vsm/mavlink_tlog.h>
 #include <ugcs/vsm/actions.h>
 #include <ugcs/vsm/transport_detector.h>
 #include <ugcs/vsm/optional.h>
 #include <ugcs/vsm/param_setter.h>
+#include <ugcs/vsm/request_pool.h>
+#include <ugcs/vsm/request_stats.h>
 
 #include <ios>
 
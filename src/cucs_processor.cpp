@@ -688,9 +688,11 @@ Cucs_processor::Close_ucs_stream(size_t stream_id)
         // For all devices registered with the closed connection we gather
         // all other connections the device is registered to.
         // And tell that to the device via Handle_ucs_info call.
+        Request_batch batch;
         for (auto dev_id : devices) {
-            Notify_device_about_ucs_connections(dev_id);
+            Notify_device_about_ucs_connections(dev_id, &batch);
         }
+        batch.Close();
 
         if (ucs_connections.size() == 0) {
             if (!transport_detector_on_when_diconnected) {
@@ -701,7 +703,7 @@ Cucs_processor::Close_ucs_stream(size_t stream_id)
 }
 
 void
-Cucs_processor::Notify_device_about_ucs_connections(uint32_t dev_id)
+Cucs_processor::Notify_device_about_ucs_connections(uint32_t dev_id, Request_batch* batch)
 {
     auto dev = Get_device(dev_id);
     if (dev) {
@@ -725,7 +727,11 @@ Cucs_processor::Notify_device_about_ucs_connections(uint32_t dev_id)
             request,
             dev,
             ucs_data));
-        dev->Get_processing_ctx()->Submit_request(request);
+        if (batch) {
+            batch->Submit(dev->Get_processing_ctx(), request);
+        } else {
+            dev->Get_processing_ctx()->Submit_request(request);
+        }
     }
 }
 
@@ -169,6 +169,14 @@ Device::On_ucs_message(
             Shared_from_this(),
             request));
 
+    /* Commands run ahead of queued bulk work of the LOW class. */
+    if (request->request.device_commands_size() == 1) {
+        auto cmd = Get_command(request->request.device_commands(0).command_id());
+        if (cmd) {
+            request->Set_priority(cmd->Get_priority());
+        }
+    }
+
     processor->Submit_request(request);
 }
 
@@ -66,6 +66,37 @@ Io_stream::Release_ref()
     }
 }
 
+Operation_waiter
+Io_stream::Write_inline_impl(Io_buffer::Ptr buffer, Offset offset,
+                             Io_result &result_arg,
+                             Request::Inline_handler &&completion_handler,
+                             Request_completion_context::Ptr comp_ctx)
+{
+    auto handler = std::make_shared<Request::Inline_handler>(std::move(completion_handler));
+    return Write_impl(buffer, offset, Make_write_callback(
+            [&result_arg, handler](Io_result result)
+            {
+                result_arg = result;
+                (*handler)();
+            }), comp_ctx);
+}
+
+Operation_waiter
+Io_stream::Read_inline_impl(size_t max_to_read, size_t min_to_read, Offset offset,
+                            Io_buffer::Ptr &buffer_arg, Io_result &result_arg,
+                            Request::Inline_handler &&completion_handler,
+                            Request_completion_context::Ptr comp_ctx)
+{
+    auto handler = std::make_shared<Request::Inline_handler>(std::move(completion_handler));
+    return Read_impl(max_to_read, min_to_read, offset, Make_read_callback(
+            [&buffer_arg, &result_arg, handler](Io_buffer::Ptr buffer, Io_result result)
+            {
+                buffer_arg = buffer;
+                result_arg = result;
+                (*handler)();
+            }), comp_ctx);
+}
+
 std::string
 Io_stream::Get_name() const
 {
@@ -0,0 +1,174 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Local_timer_queue class implementation.
+ */
+
+#include <ugcs/vsm/local_timer_queue.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace ugcs::vsm;
+
+/* Local_timer_queue::Timer class implementation. */
+
+Local_timer_queue::Timer::Timer(const Local_timer_queue::Ptr &queue,
+                                std::chrono::microseconds interval,
+                                const Handler &handler):
+    queue(queue),
+    interval(interval),
+    fire_time(std::chrono::steady_clock::now() + interval),
+    handler(handler)
+{
+}
+
+void
+Local_timer_queue::Timer::Cancel()
+{
+    if (auto q = queue.lock()) {
+        q->Cancel_timer(Shared_from_this());
+    }
+}
+
+bool
+Local_timer_queue::Timer::Is_running() const
+{
+    auto q = queue.lock();
+    if (!q) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(q->mutex);
+    return is_running;
+}
+
+std::chrono::steady_clock::time_point
+Local_timer_queue::Timer::Get_fire_time() const
+{
+    auto q = queue.lock();
+    if (!q) {
+        return fire_time;
+    }
+    std::unique_lock<std::mutex> lock(q->mutex);
+    return fire_time;
+}
+
+/* Local_timer_queue class implementation. */
+
+Local_timer_queue::Timer::Ptr
+Local_timer_queue::Create_timer(std::chrono::microseconds interval,
+                                const Handler &handler)
+{
+    if (!handler) {
+        VSM_EXCEPTION(Invalid_param_exception, "Handler not set");
+    }
+    auto timer = Timer::Create(Shared_from_this(), interval, handler);
+    std::unique_lock<std::mutex> lock(mutex);
+    Queue_timer(timer);
+    return timer;
+}
+
+void
+Local_timer_queue::Cancel_timer(const Timer::Ptr &timer)
+{
+    Handler handler;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!timer->is_running) {
+        return;
+    }
+    timer->is_running = false;
+    if (timer->is_queued) {
+        timers.erase(timer->pos);
+        timer->is_queued = false;
+        /* Released outside of the lock. */
+        handler = std::move(timer->handler);
+    }
+}
+
+void
+Local_timer_queue::Queue_timer(const Timer::Ptr &timer)
+{
+    timer->pos = timers.emplace(timer->fire_time, timer);
+    timer->is_queued = true;
+}
+
+std::chrono::microseconds
+Local_timer_queue::Process_timers()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    /* Re-scheduled timers are queued after the loop, so zero interval timer
+     * is fired once per call.
+     */
+    std::vector<Timer::Ptr> rescheduled;
+    while (!timers.empty() && timers.begin()->first <= now) {
+        Timer::Ptr timer = timers.begin()->second;
+        timers.erase(timers.begin());
+        timer->is_queued = false;
+        num_firing++;
+        lock.unlock();
+        bool restart = false;
+        try {
+            restart = timer->handler();
+        } catch (...) {
+            lock.lock();
+            num_firing--;
+            timer->is_running = false;
+            for (auto &t : rescheduled) {
+                Queue_timer(t);
+            }
+            throw;
+        }
+        lock.lock();
+        num_firing--;
+        if (restart && timer->is_running) {
+            timer->fire_time += timer->interval;
+            /* Do not allow to accumulate firings. */
+            if (timer->fire_time < now) {
+                timer->fire_time = now;
+            }
+            rescheduled.push_back(timer);
+        } else {
+            timer->is_running = false;
+            Handler handler = std::move(timer->handler);
+            lock.unlock();
+            handler = Handler();
+            lock.lock();
+        }
+    }
+    for (auto &timer : rescheduled) {
+        Queue_timer(timer);
+    }
+    if (timers.empty()) {
+        return std::chrono::microseconds::zero();
+    }
+    auto delay = std::chrono::ceil<std::chrono::microseconds>(
+            timers.begin()->first - std::chrono::steady_clock::now());
+    return std::max(delay, std::chrono::microseconds(1));
+}
+
+void
+Local_timer_queue::Clear()
+{
+    Timers cleared;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto &entry : timers) {
+        entry.second->is_running = false;
+        entry.second->is_queued = false;
+    }
+    /* Handlers are released outside of the lock. */
+    cleared.swap(timers);
+    lock.unlock();
+    for (auto &entry : cleared) {
+        entry.second->handler = Handler();
+    }
+}
+
+size_t
+Local_timer_queue::Get_size() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return timers.size() + num_firing;
+}
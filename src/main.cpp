@@ -83,7 +83,13 @@ ugcs::vsm::Initialize(const std::string &props_file)
     timer_proc = Timer_processor::Get_instance();
     timer_proc->Enable();
 
-    socket_processor = Socket_processor::Get_instance();
+    auto socket_backend = Socket_processor::Backend::SELECT;
+    if (    properties->Exists("socket_processor.backend")
+        &&  properties->Get("socket_processor.backend") == "epoll") {
+        socket_backend = Socket_processor::Backend::EPOLL;
+    }
+    socket_processor = Socket_processor::Get_instance(Piped_request_waiter::Create(),
+                                                      socket_backend);
     socket_processor->Enable();
 
     // transport_detector must initialize before cucs_processor because
@@ -0,0 +1,305 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Mavlink_mission_uploader class implementation.
+ */
+
+#include <ugcs/vsm/mavlink_mission_uploader.h>
+
+using namespace ugcs::vsm;
+
+constexpr std::chrono::milliseconds Mavlink_mission_uploader::DEFAULT_TIMEOUT;
+constexpr int Mavlink_mission_uploader::DEFAULT_MAX_RETRIES;
+
+Mavlink_mission_uploader::Mavlink_mission_uploader(
+        Mavlink_stream::Ptr stream,
+        uint8_t system_id,
+        uint8_t component_id,
+        uint8_t target_system,
+        uint8_t target_component,
+        Request_processor::Ptr processor,
+        Request_completion_context::Ptr completion_ctx):
+    stream(stream),
+    system_id(system_id),
+    component_id(component_id),
+    target_system(target_system),
+    target_component(target_component),
+    processor(processor),
+    completion_ctx(completion_ctx)
+{
+}
+
+void
+Mavlink_mission_uploader::Set_items(
+        std::vector<mavlink::Pld_mission_item_int> items,
+        mavlink::MAV_MISSION_TYPE mission_type)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (active) {
+        VSM_EXCEPTION(Invalid_op_exception, "Mission upload is in progress");
+    }
+    this->mission_type = mission_type;
+    std::vector<uint8_t> data;
+    data.reserve(items.size() * (mavlink::MAVLINK_2_MIN_FRAME_LEN +
+            (items.empty() ? 0 : items.front().Get_size_v2())));
+    item_frames.clear();
+    item_frames.reserve(items.size());
+
+    Mavlink_encoder encoder;
+    bool mav2 = stream->Is_mavlink_v2();
+    for (size_t seq = 0; seq < items.size(); seq++) {
+        auto& item = items[seq];
+        item->seq = seq;
+        item->target_system = target_system;
+        item->target_component = target_component;
+        item->mission_type = mission_type;
+        auto frame = mav2 ?
+                encoder.Encode_v2(item, system_id, component_id) :
+                encoder.Encode_v1(item, system_id, component_id);
+        auto frame_data = static_cast<const uint8_t*>(frame->Get_data());
+        item_frames.emplace_back(data.size(), frame->Get_length());
+        data.insert(data.end(), frame_data, frame_data + frame->Get_length());
+    }
+    /* Fresh buffer, slices of the previous one may still be referenced by
+     * pending writes.
+     */
+    frames = Io_buffer::Create(std::move(data));
+}
+
+void
+Mavlink_mission_uploader::Set_window(size_t window)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->window = window ? window : 1;
+}
+
+void
+Mavlink_mission_uploader::Set_timeout(std::chrono::milliseconds timeout, int max_retries)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->timeout = timeout;
+    this->max_retries = max_retries;
+}
+
+bool
+Mavlink_mission_uploader::Is_active() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return active;
+}
+
+void
+Mavlink_mission_uploader::Upload(
+        Completion_handler completion_handler,
+        Progress_handler progress_handler)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (active) {
+        VSM_EXCEPTION(Invalid_op_exception, "Mission upload is already in progress");
+    }
+    active = true;
+    requested = false;
+    requested_seq = 0;
+    sent_count = 0;
+    retries = 0;
+    last_activity = std::chrono::steady_clock::now();
+    this->completion_handler = completion_handler;
+    this->progress_handler = progress_handler;
+
+    auto& demuxer = stream->Get_demuxer();
+    request_int_key = demuxer.Register_handler<mavlink::MESSAGE_ID::MISSION_REQUEST_INT, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::MISSION_REQUEST_INT, mavlink::Extension>(
+                    &Mavlink_mission_uploader::On_mission_request_int, Shared_from_this()),
+            target_system, Mavlink_demuxer::COMPONENT_ID_ANY, processor,
+            Request::Priority::LOW);
+    request_key = demuxer.Register_handler<mavlink::MESSAGE_ID::MISSION_REQUEST, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::MISSION_REQUEST, mavlink::Extension>(
+                    &Mavlink_mission_uploader::On_mission_request, Shared_from_this()),
+            target_system, Mavlink_demuxer::COMPONENT_ID_ANY, processor,
+            Request::Priority::LOW);
+    ack_key = demuxer.Register_handler<mavlink::MESSAGE_ID::MISSION_ACK, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::MISSION_ACK, mavlink::Extension>(
+                    &Mavlink_mission_uploader::On_mission_ack, Shared_from_this()),
+            target_system, Mavlink_demuxer::COMPONENT_ID_ANY, processor,
+            Request::Priority::LOW);
+
+    /* One timer serves all retries. It ticks at the timeout rate and checks
+     * the time of last vehicle activity.
+     */
+    timer = Timer_processor::Get_instance()->Create_timer(
+            timeout,
+            Make_callback(&Mavlink_mission_uploader::On_timer, Shared_from_this()),
+            completion_ctx);
+
+    Send_count();
+}
+
+void
+Mavlink_mission_uploader::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    Finish(lock, Result::CANCELED, mavlink::MAV_MISSION_OPERATION_CANCELLED);
+}
+
+void
+Mavlink_mission_uploader::Send_count()
+{
+    mavlink::Pld_mission_count count;
+    count->count = item_frames.size();
+    count->target_system = target_system;
+    count->target_component = target_component;
+    count->mission_type = mission_type;
+    stream->Send_message(count, system_id, component_id, timeout,
+            Operation_waiter::Timeout_handler(), completion_ctx);
+}
+
+void
+Mavlink_mission_uploader::Send_item(size_t seq)
+{
+    auto& location = item_frames[seq];
+    stream->Send_buffer(
+            frames->Slice(location.first, location.second),
+            timeout, Operation_waiter::Timeout_handler(), completion_ctx);
+}
+
+void
+Mavlink_mission_uploader::On_item_request(size_t seq, uint8_t type)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active || type != mission_type) {
+        return;
+    }
+    if (seq >= item_frames.size()) {
+        LOG_WARN("Vehicle requested mission item %zu out of %zu.",
+                seq, item_frames.size());
+        return;
+    }
+    bool advanced = !requested || seq > requested_seq;
+    requested = true;
+    requested_seq = seq;
+    retries = 0;
+    last_activity = std::chrono::steady_clock::now();
+
+    /* Requested item is always sent, it might be a retransmission request. */
+    Send_item(seq);
+    if (seq >= sent_count) {
+        sent_count = seq + 1;
+    }
+    /* Send ahead the rest of the window which was not sent yet. */
+    size_t window_end = std::min(seq + window, item_frames.size());
+    for (; sent_count < window_end; sent_count++) {
+        Send_item(sent_count);
+    }
+
+    if (advanced && progress_handler) {
+        auto handler = progress_handler;
+        float progress = static_cast<float>(seq) / item_frames.size();
+        lock.unlock();
+        handler(progress);
+    }
+}
+
+void
+Mavlink_mission_uploader::On_mission_request_int(
+        mavlink::Message<mavlink::MESSAGE_ID::MISSION_REQUEST_INT>::Ptr message)
+{
+    On_item_request(message->payload->seq, message->payload->mission_type);
+}
+
+void
+Mavlink_mission_uploader::On_mission_request(
+        mavlink::Message<mavlink::MESSAGE_ID::MISSION_REQUEST>::Ptr message)
+{
+    /* Legacy request, answered with MISSION_ITEM_INT anyway. */
+    On_item_request(message->payload->seq, message->payload->mission_type);
+}
+
+void
+Mavlink_mission_uploader::On_mission_ack(
+        mavlink::Message<mavlink::MESSAGE_ID::MISSION_ACK>::Ptr message)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active || message->payload->mission_type != mission_type) {
+        return;
+    }
+    auto mission_result = static_cast<mavlink::MAV_MISSION_RESULT>(message->payload->type.Get());
+    if (mission_result == mavlink::MAV_MISSION_ACCEPTED) {
+        if (progress_handler) {
+            auto handler = progress_handler;
+            lock.unlock();
+            handler(1.0);
+            lock.lock();
+            if (!active) {
+                return;
+            }
+        }
+        Finish(lock, Result::OK, mission_result);
+    } else {
+        Finish(lock, Result::REJECTED, mission_result);
+    }
+}
+
+bool
+Mavlink_mission_uploader::On_timer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_activity < timeout) {
+        return true;
+    }
+    if (retries >= max_retries) {
+        LOG_WARN("Mission upload timed out, %zu of %zu items requested.",
+                requested ? requested_seq + 1 : 0, item_frames.size());
+        Finish(lock, Result::TIMED_OUT, mavlink::MAV_MISSION_ERROR);
+        return false;
+    }
+    retries++;
+    last_activity = now;
+    if (!requested) {
+        Send_count();
+    } else {
+        /* Resend the whole window starting from the last requested item. */
+        size_t window_end = std::min(requested_seq + window, item_frames.size());
+        for (size_t seq = requested_seq; seq < window_end; seq++) {
+            Send_item(seq);
+        }
+    }
+    return true;
+}
+
+void
+Mavlink_mission_uploader::Finish(
+        std::unique_lock<std::mutex>& lock,
+        Result result,
+        mavlink::MAV_MISSION_RESULT mission_result)
+{
+    active = false;
+    auto& demuxer = stream->Get_demuxer();
+    if (request_int_key) {
+        demuxer.Unregister_handler(request_int_key);
+    }
+    if (request_key) {
+        demuxer.Unregister_handler(request_key);
+    }
+    if (ack_key) {
+        demuxer.Unregister_handler(ack_key);
+    }
+    auto timer_tmp = std::move(timer);
+    auto handler = std::move(completion_handler);
+    progress_handler = Progress_handler();
+    lock.unlock();
+    if (timer_tmp) {
+        timer_tmp->Cancel();
+    }
+    if (handler) {
+        handler(result, mission_result);
+    }
+}
@@ -0,0 +1,442 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Mavlink_param_fetcher class implementation.
+ */
+
+#include <ugcs/vsm/mavlink_param_fetcher.h>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+using namespace ugcs::vsm;
+
+constexpr const char* Mavlink_param_fetcher::HASH_PARAM_NAME;
+constexpr std::chrono::milliseconds Mavlink_param_fetcher::DEFAULT_TIMEOUT;
+constexpr int Mavlink_param_fetcher::DEFAULT_MAX_RETRIES;
+constexpr size_t Mavlink_param_fetcher::DEFAULT_BATCH_SIZE;
+
+namespace {
+
+/** Parameter index value used for by-name requests and responses. */
+constexpr uint16_t NO_INDEX = 65535;
+
+/** Maximal parameter name length accepted from the cache. */
+constexpr size_t MAX_NAME_LEN = 256;
+
+/** Maximal index which fits into int16 param_index of PARAM_REQUEST_READ. */
+constexpr size_t MAX_READ_INDEX = std::numeric_limits<int16_t>::max();
+
+uint32_t
+Float_bits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float
+Bits_float(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} /* anonymous namespace */
+
+Mavlink_param_fetcher::Mavlink_param_fetcher(
+        Mavlink_stream::Ptr stream,
+        uint8_t system_id,
+        uint8_t component_id,
+        uint8_t target_system,
+        uint8_t target_component,
+        Request_processor::Ptr processor,
+        Request_completion_context::Ptr completion_ctx):
+    stream(stream),
+    system_id(system_id),
+    component_id(component_id),
+    target_system(target_system),
+    target_component(target_component),
+    processor(processor),
+    completion_ctx(completion_ctx)
+{
+}
+
+void
+Mavlink_param_fetcher::Set_cache_dir(const std::string& dir)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cache_dir = dir;
+}
+
+void
+Mavlink_param_fetcher::Set_timeout(std::chrono::milliseconds timeout, int max_retries)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->timeout = timeout;
+    this->max_retries = max_retries;
+}
+
+void
+Mavlink_param_fetcher::Set_batch_size(size_t batch_size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->batch_size = batch_size ? batch_size : 1;
+}
+
+bool
+Mavlink_param_fetcher::Is_active() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return active;
+}
+
+bool
+Mavlink_param_fetcher::Is_from_cache() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return from_cache;
+}
+
+std::vector<Mavlink_param_fetcher::Param>
+Mavlink_param_fetcher::Get_params() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::vector<Param> result;
+    result.reserve(received_count);
+    for (size_t i = 0; i < params.size(); i++) {
+        if (received[i]) {
+            result.push_back(params[i]);
+        }
+    }
+    return result;
+}
+
+size_t
+Mavlink_param_fetcher::Get_missing_count() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return params.size() - received_count;
+}
+
+void
+Mavlink_param_fetcher::Fetch(
+        Completion_handler completion_handler,
+        Progress_handler progress_handler)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (active) {
+        VSM_EXCEPTION(Invalid_op_exception, "Parameters fetch is already in progress");
+    }
+    active = true;
+    params.clear();
+    received.clear();
+    received_count = 0;
+    reported_percent = -1;
+    gaps_pending = 0;
+    hash_valid = false;
+    from_cache = false;
+    retries = 0;
+    last_activity = std::chrono::steady_clock::now();
+    this->completion_handler = completion_handler;
+    this->progress_handler = progress_handler;
+
+    value_key = stream->Get_demuxer().Register_handler<mavlink::MESSAGE_ID::PARAM_VALUE, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::PARAM_VALUE, mavlink::Extension>(
+                    &Mavlink_param_fetcher::On_param_value, Shared_from_this()),
+            target_system, target_component, processor,
+            Request::Priority::LOW);
+
+    timer = Timer_processor::Get_instance()->Create_timer(
+            timeout,
+            Make_callback(&Mavlink_param_fetcher::On_timer, Shared_from_this()),
+            completion_ctx);
+
+    if (cache_dir.empty()) {
+        stage = Stage::LIST;
+        Send_request_list();
+    } else {
+        stage = Stage::HASH_CHECK;
+        Send_request_read(-1, HASH_PARAM_NAME);
+    }
+}
+
+void
+Mavlink_param_fetcher::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    Finish(lock, Result::CANCELED);
+}
+
+void
+Mavlink_param_fetcher::Send_request_list()
+{
+    mavlink::Pld_param_request_list req;
+    req->target_system = target_system;
+    req->target_component = target_component;
+    stream->Send_message(req, system_id, component_id, timeout,
+            Operation_waiter::Timeout_handler(), completion_ctx);
+}
+
+void
+Mavlink_param_fetcher::Send_request_read(int index, const char* name)
+{
+    if (index < -1 || index > static_cast<int>(MAX_READ_INDEX)) {
+        LOG_ERR("Parameter index %d cannot be requested by PARAM_REQUEST_READ.", index);
+        return;
+    }
+    mavlink::Pld_param_request_read req;
+    req->target_system = target_system;
+    req->target_component = target_component;
+    req->param_index = index;
+    req->param_id = name;
+    stream->Send_message(req, system_id, component_id, timeout,
+            Operation_waiter::Timeout_handler(), completion_ctx);
+}
+
+void
+Mavlink_param_fetcher::Request_gaps()
+{
+    gaps_pending = 0;
+    for (size_t i = 0; i < received.size() && gaps_pending < batch_size; i++) {
+        if (!received[i]) {
+            if (i > MAX_READ_INDEX) {
+                /* Not addressable by index, only the whole list brings it.
+                 * Next batch is driven by the timer then.
+                 */
+                Send_request_list();
+                gaps_pending = 0;
+                return;
+            }
+            Send_request_read(i);
+            gaps_pending++;
+        }
+    }
+}
+
+std::string
+Mavlink_param_fetcher::Get_cache_file(uint32_t hash) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "params_%08x.cache", hash);
+    return cache_dir + "/" + name;
+}
+
+bool
+Mavlink_param_fetcher::Load_cache()
+{
+    std::ifstream f(Get_cache_file(hash));
+    if (!f.is_open()) {
+        return false;
+    }
+    size_t count;
+    if (!(f >> count)) {
+        return false;
+    }
+    std::vector<Param> loaded(count);
+    std::vector<bool> loaded_bits(count, false);
+    for (size_t i = 0; i < count; i++) {
+        unsigned index, type;
+        uint32_t bits;
+        size_t name_len;
+        /* Name is length-prefixed, it can contain any characters. */
+        if (!(f >> index >> type >> std::hex >> bits >> std::dec >> name_len) ||
+            f.get() != ' ' || index >= count || name_len > MAX_NAME_LEN) {
+            LOG_WARN("Malformed parameters cache file, ignored.");
+            return false;
+        }
+        std::string name(name_len, '\0');
+        if (!f.read(&name[0], name_len)) {
+            LOG_WARN("Malformed parameters cache file, ignored.");
+            return false;
+        }
+        loaded[index] = Param {static_cast<uint16_t>(index), name,
+                               Bits_float(bits), static_cast<uint8_t>(type)};
+        loaded_bits[index] = true;
+    }
+    for (bool bit : loaded_bits) {
+        if (!bit) {
+            LOG_WARN("Incomplete parameters cache file, ignored.");
+            return false;
+        }
+    }
+    params = std::move(loaded);
+    received = std::move(loaded_bits);
+    received_count = count;
+    return true;
+}
+
+void
+Mavlink_param_fetcher::Save_cache()
+{
+    auto file_name = Get_cache_file(hash);
+    std::ofstream f(file_name, std::ios::trunc);
+    if (!f.is_open()) {
+        LOG_WARN("Failed to write parameters cache file %s.", file_name.c_str());
+        return;
+    }
+    f << params.size() << "\n";
+    for (auto& param : params) {
+        f << param.index << " " << static_cast<unsigned>(param.type) << " " <<
+             std::hex << Float_bits(param.value) << std::dec << " " <<
+             param.name.size() << " " << param.name << "\n";
+    }
+}
+
+void
+Mavlink_param_fetcher::On_param_value(
+        mavlink::Message<mavlink::MESSAGE_ID::PARAM_VALUE>::Ptr message)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    auto& pld = message->payload;
+    std::string name = pld->param_id.Get_string();
+    uint16_t index = pld->param_index;
+
+    if (name == HASH_PARAM_NAME) {
+        hash = Float_bits(pld->param_value);
+        hash_valid = true;
+        if (stage == Stage::HASH_CHECK) {
+            if (Load_cache()) {
+                from_cache = true;
+                LOG_INFO("Parameters loaded from cache, hash %08x.", hash);
+                Finish(lock, Result::OK);
+                return;
+            }
+            stage = Stage::LIST;
+            last_activity = std::chrono::steady_clock::now();
+            Send_request_list();
+        }
+        return;
+    }
+    if (stage != Stage::LIST) {
+        return;
+    }
+
+    size_t count = pld->param_count;
+    if (count != params.size()) {
+        /* First value or the vehicle changed parameters set, restart tracking. */
+        params.assign(count, Param());
+        received.assign(count, false);
+        received_count = 0;
+        gaps_pending = 0;
+    }
+    if (index == NO_INDEX) {
+        /* Response to by-name request, not used for fetching, but still
+         * updates the known value.
+         */
+        for (auto& param : params) {
+            if (param.name == name) {
+                param.value = pld->param_value;
+            }
+        }
+        return;
+    }
+    if (index >= count) {
+        return;
+    }
+    params[index] = Param {index, name, pld->param_value.Get(),
+                           static_cast<uint8_t>(pld->param_type.Get())};
+    if (received[index]) {
+        return;
+    }
+    received[index] = true;
+    received_count++;
+    retries = 0;
+    last_activity = std::chrono::steady_clock::now();
+
+    if (received_count == count) {
+        Report_progress(lock);
+        if (!active) {
+            return;
+        }
+        if (hash_valid && !cache_dir.empty()) {
+            Save_cache();
+        }
+        Finish(lock, Result::OK);
+        return;
+    }
+    if (gaps_pending && !--gaps_pending) {
+        /* Batch answered, no need to wait for the timer. */
+        Request_gaps();
+    }
+    Report_progress(lock);
+}
+
+bool
+Mavlink_param_fetcher::On_timer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_activity < timeout) {
+        return true;
+    }
+    last_activity = now;
+    if (stage == Stage::HASH_CHECK) {
+        /* Hash is not supported by the vehicle. */
+        stage = Stage::LIST;
+        Send_request_list();
+        return true;
+    }
+    if (retries >= max_retries) {
+        LOG_WARN("Parameters fetch timed out, %zu of %zu received.",
+                received_count, params.size());
+        Finish(lock, Result::TIMED_OUT);
+        return false;
+    }
+    retries++;
+    if (params.empty()) {
+        Send_request_list();
+    } else {
+        Request_gaps();
+    }
+    return true;
+}
+
+void
+Mavlink_param_fetcher::Report_progress(std::unique_lock<std::mutex>& lock)
+{
+    if (!progress_handler || params.empty()) {
+        return;
+    }
+    int percent = received_count * 100 / params.size();
+    if (percent == reported_percent) {
+        return;
+    }
+    reported_percent = percent;
+    auto handler = progress_handler;
+    lock.unlock();
+    handler(percent / 100.0);
+    lock.lock();
+}
+
+void
+Mavlink_param_fetcher::Finish(std::unique_lock<std::mutex>& lock, Result result)
+{
+    active = false;
+    if (value_key) {
+        stream->Get_demuxer().Unregister_handler(value_key);
+    }
+    auto timer_tmp = std::move(timer);
+    auto handler = std::move(completion_handler);
+    progress_handler = Progress_handler();
+    lock.unlock();
+    if (timer_tmp) {
+        timer_tmp->Cancel();
+    }
+    if (handler) {
+        handler(result);
+    }
+}
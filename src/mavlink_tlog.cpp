@@ -0,0 +1,401 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Mavlink_tlog_writer and Mavlink_tlog_replay_stream classes implementation.
+ */
+
+#include <ugcs/vsm/mavlink_tlog.h>
+
+#include <algorithm>
+
+using namespace ugcs::vsm;
+
+constexpr size_t Mavlink_tlog_writer::DEFAULT_BUFFER_SIZE;
+constexpr std::chrono::milliseconds Mavlink_tlog_writer::FLUSH_PERIOD;
+constexpr double Mavlink_tlog_replay_stream::AS_FAST_AS_POSSIBLE;
+
+namespace {
+
+/** Size of record timestamp. */
+constexpr size_t TIMESTAMP_SIZE = sizeof(uint64_t);
+
+/** Mavlink 2 incompatibility flag indicating signed frame. */
+constexpr uint8_t IFLAG_SIGNED = 0x01;
+
+/** Mavlink 2 signature length. */
+constexpr size_t SIGNATURE_LEN = 13;
+
+/** Minimal number of bytes needed for @ref Get_frame_length. */
+constexpr size_t FRAME_PREFIX_LEN = 3;
+
+/** Get full length of the frame starting with the start sign at data. At
+ * least FRAME_PREFIX_LEN bytes should be available.
+ */
+size_t
+Get_frame_length(const uint8_t* data)
+{
+    if (data[0] == mavlink::START_SIGN) {
+        return mavlink::MAVLINK_1_MIN_FRAME_LEN + data[1];
+    }
+    size_t len = mavlink::MAVLINK_2_MIN_FRAME_LEN + data[1];
+    if (data[2] & IFLAG_SIGNED) {
+        len += SIGNATURE_LEN;
+    }
+    return len;
+}
+
+bool
+Is_start_sign(uint8_t byte)
+{
+    return byte == mavlink::START_SIGN || byte == mavlink::START_SIGN2;
+}
+
+} /* anonymous namespace */
+
+/* Mavlink_tlog_writer class. */
+
+Mavlink_tlog_writer::Mavlink_tlog_writer(
+        Io_stream::Ref file,
+        Request_completion_context::Ptr completion_ctx,
+        size_t buffer_size):
+    file(file),
+    completion_ctx(completion_ctx),
+    buffer_size(buffer_size)
+{
+    buffer.reserve(buffer_size);
+}
+
+void
+Mavlink_tlog_writer::Enable()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    timer = Timer_processor::Get_instance()->Create_timer(
+            FLUSH_PERIOD,
+            Make_callback(&Mavlink_tlog_writer::On_timer, Shared_from_this()),
+            completion_ctx);
+}
+
+void
+Mavlink_tlog_writer::Disable()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Flush_locked();
+    auto timer_tmp = std::move(timer);
+    lock.unlock();
+    if (timer_tmp) {
+        timer_tmp->Cancel();
+    }
+}
+
+Mavlink_decoder::Frame_handler
+Mavlink_tlog_writer::Get_frame_handler()
+{
+    return Mavlink_decoder::Make_frame_handler(
+            &Mavlink_tlog_writer::On_frame, Shared_from_this());
+}
+
+void
+Mavlink_tlog_writer::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Flush_locked();
+}
+
+uint64_t
+Mavlink_tlog_writer::Get_frame_count() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return frame_count;
+}
+
+void
+Mavlink_tlog_writer::On_frame(Io_buffer::Ptr frame)
+{
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    auto bytes = static_cast<const uint8_t*>(frame->Get_data());
+    size_t len = frame->Get_length();
+    if (bytes[0] == mavlink::START_SIGN2 && (bytes[2] & IFLAG_SIGNED)) {
+        /* Decoder does not consume the signature, the frame would break the
+         * record framing.
+         */
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        buffer.push_back(timestamp >> shift);
+    }
+    buffer.insert(buffer.end(), bytes, bytes + len);
+    frame_count++;
+    if (buffer.size() >= buffer_size) {
+        Flush_locked();
+    }
+}
+
+void
+Mavlink_tlog_writer::Flush_locked()
+{
+    if (buffer.empty() || !file) {
+        return;
+    }
+    /* Write is queued by the file processor, so the caller does not wait
+     * for the disk.
+     */
+    file->Write(Io_buffer::Create(std::move(buffer)),
+                Make_dummy_callback<void, Io_result>(), completion_ctx);
+    buffer = std::vector<uint8_t>();
+    buffer.reserve(buffer_size);
+}
+
+bool
+Mavlink_tlog_writer::On_timer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!timer) {
+        return false;
+    }
+    Flush_locked();
+    return true;
+}
+
+/* Mavlink_tlog_replay_stream class. */
+
+Mavlink_tlog_replay_stream::Mavlink_tlog_replay_stream(
+        const std::string& file_name,
+        Request_completion_context::Ptr completion_ctx,
+        double speed):
+    Io_stream(Io_stream::Type::FILE),
+    file(file_name, std::ios::binary),
+    speed(speed),
+    pending(Io_buffer::Create()),
+    completion_ctx(completion_ctx)
+{
+    if (!file.is_open()) {
+        VSM_EXCEPTION(Invalid_param_exception, "Failed to open tlog file %s",
+                      file_name.c_str());
+    }
+    Set_name(file_name);
+    state = State::OPENED;
+}
+
+uint64_t
+Mavlink_tlog_replay_stream::Get_frame_count() const
+{
+    std::unique_lock<std::mutex> lock(op_mutex);
+    return frame_count;
+}
+
+Operation_waiter
+Mavlink_tlog_replay_stream::Write_impl(Io_buffer::Ptr,
+                                       Offset offset,
+                                       Write_handler completion_handler,
+                                       Request_completion_context::Ptr comp_ctx)
+{
+    /* Data are discarded, the replayed vehicle does not listen. */
+    if (!completion_handler) {
+        completion_handler = Make_dummy_callback<void, Io_result>();
+        comp_ctx = completion_ctx;
+    }
+    auto request = Write_request::Create(nullptr, Shared_from_this(), offset,
+                                         completion_handler.template Get_arg<0>());
+    request->Set_processing_handler(
+            Make_callback([](Write_request::Ptr r) {
+                r->Complete();
+            }, request));
+    request->Set_completion_handler(comp_ctx, completion_handler);
+    request->Set_result_arg(state == State::CLOSED ? Io_result::CLOSED : Io_result::OK);
+    request->Process(true);
+    return request;
+}
+
+Operation_waiter
+Mavlink_tlog_replay_stream::Read_impl(size_t max_to_read, size_t min_to_read,
+                                      Offset offset,
+                                      Read_handler completion_handler,
+                                      Request_completion_context::Ptr comp_ctx)
+{
+    if (!completion_handler) {
+        completion_handler = Make_dummy_callback<void, Io_buffer::Ptr, Io_result>();
+        comp_ctx = completion_ctx;
+    }
+    auto request = Read_request::Create(completion_handler.template Get_arg<0>(),
+                                        max_to_read, min_to_read,
+                                        Shared_from_this(), offset,
+                                        completion_handler.template Get_arg<1>());
+    request->Set_completion_handler(comp_ctx, completion_handler);
+    /* Request is processed right away and stays in processing state until
+     * the data are due.
+     */
+    request->Set_processing_handler(Make_dummy_callback<void>());
+    request->Set_cancellation_handler(
+            Make_callback(&Mavlink_tlog_replay_stream::Handle_read_cancel,
+                          Shared_from_this(), request));
+    request->Process(true);
+
+    std::unique_lock<std::mutex> lock(op_mutex);
+    if (state == State::CLOSED) {
+        auto request_lock = request->Lock();
+        request->Set_result_arg(Io_result::CLOSED, request_lock);
+        request->Set_buffer_arg(Io_buffer::Create(), request_lock);
+        request->Complete(Request::Status::OK, std::move(request_lock));
+        return request;
+    }
+    read_queue.push_back(request);
+    Process_reads();
+    return request;
+}
+
+Operation_waiter
+Mavlink_tlog_replay_stream::Close_impl(Close_handler completion_handler,
+                                       Request_completion_context::Ptr comp_ctx)
+{
+    std::unique_lock<std::mutex> lock(op_mutex);
+    state = State::CLOSED;
+    for (auto& request : read_queue) {
+        auto request_lock = request->Lock();
+        request->Set_result_arg(Io_result::CLOSED, request_lock);
+        request->Set_buffer_arg(Io_buffer::Create(), request_lock);
+        request->Complete(Request::Status::OK, std::move(request_lock));
+    }
+    read_queue.clear();
+    auto timer_tmp = std::move(timer);
+    lock.unlock();
+    if (timer_tmp) {
+        timer_tmp->Cancel();
+    }
+
+    Request::Ptr request = Request::Create();
+    request->Set_processing_handler(
+            Make_callback([](Request::Ptr r) {
+                r->Complete();
+            }, request));
+    request->Set_completion_handler(comp_ctx, completion_handler);
+    request->Process(true);
+    return request;
+}
+
+bool
+Mavlink_tlog_replay_stream::Load_record()
+{
+    uint8_t header[TIMESTAMP_SIZE + FRAME_PREFIX_LEN];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        eof = true;
+        return false;
+    }
+    uint8_t* prefix = header + TIMESTAMP_SIZE;
+    if (!Is_start_sign(prefix[0])) {
+        LOG_WARN("Malformed tlog file %s, replay stopped.", Get_name().c_str());
+        eof = true;
+        return false;
+    }
+    next_time = 0;
+    for (size_t i = 0; i < TIMESTAMP_SIZE; i++) {
+        next_time = (next_time << 8) | header[i];
+    }
+    size_t frame_len = Get_frame_length(prefix);
+    next_frame.assign(prefix, prefix + FRAME_PREFIX_LEN);
+    next_frame.resize(frame_len);
+    if (!file.read(reinterpret_cast<char*>(next_frame.data() + FRAME_PREFIX_LEN),
+                   frame_len - FRAME_PREFIX_LEN)) {
+        /* Truncated last record. */
+        eof = true;
+        return false;
+    }
+    next_loaded = true;
+    return true;
+}
+
+void
+Mavlink_tlog_replay_stream::Process_reads()
+{
+    while (!read_queue.empty()) {
+        auto request = read_queue.front();
+        size_t min_to_read = std::max<size_t>(request->Get_min_to_read(), 1);
+        while (pending->Get_length() < min_to_read) {
+            if (!next_loaded && (eof || !Load_record())) {
+                break;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (!started) {
+                started = true;
+                first_time = next_time;
+                start_time = now;
+            }
+            if (speed > AS_FAST_AS_POSSIBLE && next_time > first_time) {
+                auto due = start_time + std::chrono::microseconds(
+                        static_cast<int64_t>((next_time - first_time) / speed));
+                if (due > now) {
+                    if (!timer) {
+                        /* Round up, so the timer does not fire early. */
+                        auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                due - now + std::chrono::microseconds(999));
+                        std::weak_ptr<Mavlink_tlog_replay_stream> weak_this = Shared_from_this();
+                        timer = Timer_processor::Get_instance()->Create_timer(
+                                delay,
+                                Make_callback(
+                                    [](std::weak_ptr<Mavlink_tlog_replay_stream> weak)
+                                    {
+                                        auto stream = weak.lock();
+                                        return stream ? stream->On_timer() : false;
+                                    },
+                                    weak_this),
+                                completion_ctx);
+                    }
+                    return;
+                }
+            }
+            pending = pending->Concatenate(Io_buffer::Create(std::move(next_frame)));
+            next_frame = std::vector<uint8_t>();
+            next_loaded = false;
+            frame_count++;
+        }
+
+        Io_buffer::Ptr data;
+        Io_result result = Io_result::OK;
+        if (pending->Get_length()) {
+            /* At end of file the rest is returned even if it is less than
+             * requested minimum.
+             */
+            data = pending->Slice(0, std::min(pending->Get_length(),
+                                              request->Get_max_to_read()));
+            pending = pending->Slice(data->Get_length());
+        } else {
+            data = Io_buffer::Create();
+            result = Io_result::END_OF_FILE;
+        }
+        read_queue.pop_front();
+        auto request_lock = request->Lock();
+        request->Set_result_arg(result, request_lock);
+        request->Set_buffer_arg(data, request_lock);
+        request->Complete(Request::Status::OK, std::move(request_lock));
+    }
+}
+
+void
+Mavlink_tlog_replay_stream::Handle_read_cancel(Read_request::Ptr request)
+{
+    std::unique_lock<std::mutex> lock(op_mutex);
+    auto iter = std::find(read_queue.begin(), read_queue.end(), request);
+    if (iter == read_queue.end()) {
+        return;
+    }
+    read_queue.erase(iter);
+    auto request_lock = request->Lock();
+    request->Set_result_arg(Io_result::CANCELED, request_lock);
+    request->Set_buffer_arg(Io_buffer::Create(), request_lock);
+    request->Complete(Request::Status::CANCELED, std::move(request_lock));
+}
+
+bool
+Mavlink_tlog_replay_stream::On_timer()
+{
+    std::unique_lock<std::mutex> lock(op_mutex);
+    timer = nullptr;
+    if (state != State::CLOSED) {
+        Process_reads();
+    }
+    return false;
+}
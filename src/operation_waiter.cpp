@@ -90,6 +90,16 @@ Operation_waiter::Destroy()
     }
 }
 
+void
+Operation_waiter::Set_done_handler(Request::Handler handler)
+{
+    if (!request) {
+        handler();
+        return;
+    }
+    request->Set_done_handler(std::move(handler));
+}
+
 bool
 Operation_waiter::Timeout_cbk(Request::Ptr request, Timeout_handler handler,
                               bool cancel_operation)
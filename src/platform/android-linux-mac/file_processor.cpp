@@ -9,6 +9,9 @@
 
 #include <ugcs/vsm/posix_file_handle.h>
 #include <ugcs/vsm/debug.h>
+#ifdef VSM_IO_URING
+#include <ugcs/vsm/io_uring_io_controller.h>
+#endif
 #include <cstring>
 
 using namespace ugcs::vsm;
@@ -24,6 +27,11 @@ File_processor::Open_native_handle(
 std::unique_ptr<File_processor::Native_controller>
 File_processor::Native_controller::Create()
 {
+#ifdef VSM_IO_URING
+    if (internal::Io_uring::Is_supported()) {
+        return std::make_unique<internal::Io_uring_io_controller>();
+    }
+#endif
     return std::make_unique<internal::Poll_io_controller>();
 }
 
@@ -21,3 +21,90 @@ ugcs::vsm::Socket_processor::On_bind_can(
     request->Complete();
     return;
 }
+
+// epoll is not available, select is used.
+bool
+ugcs::vsm::Socket_processor::Epoll_open()
+{
+    return false;
+}
+
+void
+ugcs::vsm::Socket_processor::Epoll_close()
+{
+}
+
+void
+ugcs::vsm::Socket_processor::Epoll_control(sockets::Socket_handle, int, bool)
+{
+    ASSERT(false);
+}
+
+void
+ugcs::vsm::Socket_processor::Epoll_remove(sockets::Socket_handle)
+{
+    ASSERT(false);
+}
+
+bool
+ugcs::vsm::Socket_processor::Epoll_wait(std::chrono::microseconds)
+{
+    ASSERT(false);
+    return false;
+}
+
+// recvmmsg() is not available, datagrams are received one by one.
+int
+ugcs::vsm::Socket_processor::Udp_receive_batch(
+        sockets::Socket_handle s,
+        sockaddr_storage *addresses,
+        size_t *lengths)
+{
+    int count = 0;
+    while (count < static_cast<int>(UDP_BATCH_SIZE)) {
+        socklen_t len = sizeof(sockaddr_storage);
+        auto read_bytes = recvfrom(
+                s,
+                reinterpret_cast<char*>(&udp_read_buffer[count * MIN_UDP_PAYLOAD_SIZE_TO_READ]),
+                MIN_UDP_PAYLOAD_SIZE_TO_READ,
+                0,
+                reinterpret_cast<sockaddr *>(&addresses[count]),
+                &len);
+        if (read_bytes < 0) {
+            // Error is reported if nothing is received.
+            return count ? count : -1;
+        }
+        lengths[count++] = read_bytes;
+    }
+    return count;
+}
+
+// sendmmsg() is not available, datagrams are sent one by one.
+int
+ugcs::vsm::Socket_processor::Udp_send_batch(sockets::Socket_handle s)
+{
+    int count = 0;
+    for (auto &entry : udp_write_batch) {
+        ssize_t written;
+        if (entry.address) {
+            written = sendto(
+                    s,
+                    reinterpret_cast<const char*>(entry.buffer->Get_data()),
+                    entry.buffer->Get_length(),
+                    sockets::SEND_FLAGS,
+                    entry.address->Get_sockaddr_ref(),
+                    entry.address->Get_len());
+        } else {
+            written = send(
+                    s,
+                    reinterpret_cast<const char*>(entry.buffer->Get_data()),
+                    entry.buffer->Get_length(),
+                    sockets::SEND_FLAGS);
+        }
+        if (written < 0) {
+            return count ? count : -1;
+        }
+        count++;
+    }
+    return count;
+}
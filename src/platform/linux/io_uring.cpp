@@ -0,0 +1,179 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * io_uring rings implementation.
+ */
+
+#ifdef VSM_IO_URING
+
+#include <ugcs/vsm/io_uring.h>
+#include <ugcs/vsm/log.h>
+
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace ugcs::vsm;
+using namespace ugcs::vsm::internal;
+
+/* Io_uring class. */
+
+Io_uring::Io_uring(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd < 0) {
+        VSM_SYS_EXCEPTION("io_uring_setup failed");
+    }
+    features = params.features;
+    sq_entries = params.sq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = nullptr;
+        Release();
+        VSM_SYS_EXCEPTION("io_uring submission ring mapping failed");
+    }
+    if (features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            cq_ring = nullptr;
+            Release();
+            VSM_SYS_EXCEPTION("io_uring completion ring mapping failed");
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_map == MAP_FAILED) {
+        Release();
+        VSM_SYS_EXCEPTION("io_uring submission entries mapping failed");
+    }
+    sqes = static_cast<io_uring_sqe *>(sqes_map);
+
+    auto sq = static_cast<uint8_t *>(sq_ring);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    auto cq = static_cast<uint8_t *>(cq_ring);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    sq_local_tail = *sq_tail;
+}
+
+Io_uring::~Io_uring()
+{
+    Release();
+}
+
+void
+Io_uring::Release()
+{
+    if (sqes) {
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+    if (cq_ring && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    cq_ring = nullptr;
+    if (sq_ring) {
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = nullptr;
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+}
+
+bool
+Io_uring::Is_supported()
+{
+    static const bool supported = []()
+    {
+        try {
+            Io_uring ring(1);
+            /* Current position reads are the most recent feature used. */
+            unsigned required = IORING_FEAT_NODROP | IORING_FEAT_RW_CUR_POS;
+            return (ring.features & required) == required;
+        } catch (const System_exception &) {
+            return false;
+        }
+    }();
+    return supported;
+}
+
+io_uring_sqe *
+Io_uring::Get_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sq_local_tail - head >= sq_entries) {
+        Submit();
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (sq_local_tail - head >= sq_entries) {
+            VSM_EXCEPTION(System_exception, "io_uring submission queue is full");
+        }
+    }
+    unsigned idx = sq_local_tail & *sq_mask;
+    io_uring_sqe *sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[idx] = idx;
+    sq_local_tail++;
+    to_submit++;
+    return sqe;
+}
+
+int
+Io_uring::Enter(unsigned submit, unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    return syscall(__NR_io_uring_enter, ring_fd, submit, min_complete, flags,
+                   nullptr, 0);
+}
+
+void
+Io_uring::Submit()
+{
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    while (to_submit) {
+        int rc = Enter(to_submit, 0);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            VSM_SYS_EXCEPTION("io_uring submission failed");
+        }
+        to_submit -= rc;
+    }
+}
+
+bool
+Io_uring::Wait()
+{
+    if (Enter(0, 1) < 0) {
+        if (errno == EINTR) {
+            return false;
+        }
+        VSM_SYS_EXCEPTION("io_uring wait failed");
+    }
+    return true;
+}
+
+#endif /* VSM_IO_URING */
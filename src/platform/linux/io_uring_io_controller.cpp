@@ -0,0 +1,238 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+#ifdef VSM_IO_URING
+
+#include <ugcs/vsm/io_uring_io_controller.h>
+
+#include <poll.h>
+
+using namespace ugcs::vsm::internal;
+
+namespace {
+
+/** Submission queue size. Each stream has at most one read and one write
+ * submitted.
+ */
+constexpr unsigned IO_URING_ENTRIES = 128;
+
+/** User data of the request to stop the completion thread. */
+constexpr uint64_t QUIT_USER_DATA = 0;
+
+/** User data of cancellation requests, their completions are ignored. */
+constexpr uint64_t CANCEL_USER_DATA = 1;
+
+} /* anonymous namespace */
+
+Io_uring_io_controller::Io_uring_io_controller():
+    ring(IO_URING_ENTRIES)
+{
+}
+
+void
+Io_uring_io_controller::Enable()
+{
+    completion_thread = std::thread(&Io_uring_io_controller::Completion_thread,
+                                    this);
+}
+
+void
+Io_uring_io_controller::Disable()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        disabling = true;
+        /* Operations left in the ring would complete into released memory,
+         * so cancel them and let the completion thread drain the results.
+         */
+        for (Io_cb *io_cb: submitted) {
+            Submit_cancel(*io_cb);
+        }
+        io_uring_sqe *sqe = ring.Get_sqe();
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = QUIT_USER_DATA;
+        ring.Submit();
+    }
+    completion_thread.join();
+}
+
+void
+Io_uring_io_controller::Completion_thread()
+{
+    bool quit = false;
+    while (!quit || !Is_drained()) {
+        if (!ring.Wait()) {
+            /* Ignore signals. */
+            continue;
+        }
+        ring.Process_completions([&](const io_uring_cqe &cqe)
+        {
+            if (cqe.user_data == QUIT_USER_DATA) {
+                quit = true;
+                return;
+            }
+            if (cqe.user_data == CANCEL_USER_DATA) {
+                return;
+            }
+            Io_cb &io_cb = *reinterpret_cast<Io_cb *>(cqe.user_data);
+            int res = cqe.res;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                bool is_canceled = canceled.count(&io_cb);
+                if (polling.erase(&io_cb)) {
+                    /* Readiness poll of the operation which returned EAGAIN,
+                     * poll errors are reported by the operation itself.
+                     */
+                    if (res >= 0 && !is_canceled && !disabling) {
+                        if (Submit_operation(io_cb)) {
+                            return;
+                        }
+                        res = -errno;
+                    } else if (res >= 0) {
+                        res = -ECANCELED;
+                    }
+                } else if (res == -EAGAIN && !is_canceled && !disabling) {
+                    /* Non-blocking descriptor (e.g. tty opened with
+                     * O_NONBLOCK), wait for readiness and try again.
+                     */
+                    if (Submit_poll(io_cb)) {
+                        return;
+                    }
+                    res = -errno;
+                }
+                canceled.erase(&io_cb);
+                submitted.erase(&io_cb);
+                auto it = fd_map.find(io_cb.fd);
+                ASSERT(it != fd_map.end());
+                if (!--it->second.num_submitted) {
+                    if (it->second.close_on_complete) {
+                        close(it->first);
+                    }
+                    fd_map.erase(it);
+                }
+            }
+            if (res < 0) {
+                io_cb.return_value = -1;
+                io_cb.error = -res;
+            } else {
+                io_cb.return_value = res;
+                io_cb.error = 0;
+            }
+            /* Callback can queue next operation with the same block. */
+            if (io_cb.cbk) {
+                io_cb.cbk(io_cb);
+            }
+        });
+    }
+}
+
+bool
+Io_uring_io_controller::Is_drained()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return submitted.empty();
+}
+
+bool
+Io_uring_io_controller::Submit_operation(Io_cb &io_cb)
+{
+    try {
+        io_uring_sqe *sqe = ring.Get_sqe();
+        sqe->opcode = io_cb.op == Io_cb::Operation::READ ?
+                IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = io_cb.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(io_cb.buf);
+        sqe->len = io_cb.size;
+        /* Current file position is used for -1. */
+        sqe->off = io_cb.offset == Io_stream::OFFSET_NONE ?
+                ~uint64_t(0) : io_cb.offset;
+        sqe->user_data = reinterpret_cast<uint64_t>(&io_cb);
+        ring.Submit();
+    } catch (const System_exception &) {
+        return false;
+    }
+    return true;
+}
+
+bool
+Io_uring_io_controller::Submit_poll(Io_cb &io_cb)
+{
+    try {
+        io_uring_sqe *sqe = ring.Get_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = io_cb.fd;
+        sqe->poll32_events = io_cb.op == Io_cb::Operation::READ ?
+                POLLIN : POLLOUT;
+        sqe->user_data = reinterpret_cast<uint64_t>(&io_cb);
+        ring.Submit();
+    } catch (const System_exception &) {
+        return false;
+    }
+    polling.insert(&io_cb);
+    return true;
+}
+
+void
+Io_uring_io_controller::Submit_cancel(Io_cb &io_cb)
+{
+    io_uring_sqe *sqe = ring.Get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&io_cb);
+    sqe->user_data = CANCEL_USER_DATA;
+    canceled.insert(&io_cb);
+}
+
+bool
+Io_uring_io_controller::Queue_operation(Io_cb &io_cb)
+{
+    if (io_cb.offset == Io_stream::OFFSET_END) {
+        off_t result = lseek(io_cb.fd, 0, SEEK_END);
+        if (result == -1) {
+            return false;
+        }
+        io_cb.offset = result;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (disabling) {
+        errno = ECANCELED;
+        return false;
+    }
+    if (!Submit_operation(io_cb)) {
+        return false;
+    }
+    submitted.insert(&io_cb);
+    fd_map[io_cb.fd].num_submitted++;
+    return true;
+}
+
+bool
+Io_uring_io_controller::Cancel_operation(Io_cb &io_cb)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (submitted.count(&io_cb)) {
+        /* Also cancels the readiness poll if the operation is waiting. */
+        Submit_cancel(io_cb);
+        ring.Submit();
+    }
+    /* Completion is reported anyway. */
+    return false;
+}
+
+void
+Io_uring_io_controller::Delete_handle(int fd)
+{
+    if (fd > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = fd_map.find(fd);
+        if (it == fd_map.end()) {
+            close(fd);
+        } else {
+            /* Submitted operations hold the file anyway. */
+            it->second.close_on_complete = true;
+        }
+    }
+}
+
+#endif /* VSM_IO_URING */
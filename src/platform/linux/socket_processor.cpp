@@ -8,8 +8,11 @@
 #include <ugcs/vsm/socket_processor.h>
 #include <ugcs/vsm/log.h>
 
+#include <cstring>
 #include <net/if.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
 
@@ -58,6 +61,7 @@ ugcs::vsm::Socket_processor::On_bind_can(
         if (request->Is_processing()) {
             // request status is still OK
             streams[stream] = stream;
+            Mark_dirty(stream);
             stream->Set_socket(s);
             stream->Set_state(Io_stream::State::OPENED);
             request->Set_result_arg(Io_result::OK, locker);
@@ -72,3 +76,153 @@ ugcs::vsm::Socket_processor::On_bind_can(
         LOG_INFO("Bind failed: %s", Log::Get_system_error().c_str());
     }
 }
+
+namespace {
+
+/** Maximal number of events taken by one epoll_wait() call. */
+constexpr int MAX_EPOLL_EVENTS = 256;
+
+} /* anonymous namespace */
+
+bool
+ugcs::vsm::Socket_processor::Epoll_open()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        VSM_SYS_EXCEPTION("epoll_create1 failed");
+    }
+    /* Level triggered, the pipe is acknowledged once per wakeup. */
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = piped_waiter->Get_wait_pipe();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+        VSM_SYS_EXCEPTION("Wait pipe registration in epoll failed");
+    }
+    return true;
+}
+
+void
+ugcs::vsm::Socket_processor::Epoll_close()
+{
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+void
+ugcs::vsm::Socket_processor::Epoll_control(sockets::Socket_handle s, int interest, bool add)
+{
+    epoll_event ev = {};
+    if (!interest) {
+        /* Errors and hangups are reported regardless of the mask, so an idle
+         * level triggered registration would report them continuously.
+         */
+        ev.events = EPOLLET;
+    }
+    if (interest & INTEREST_READ) {
+        ev.events |= EPOLLIN;
+    }
+    if (interest & (INTEREST_WRITE | INTEREST_ERROR)) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = s;
+    int rc = epoll_ctl(epoll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, s, &ev);
+    if (rc && add && errno == EEXIST) {
+        rc = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s, &ev);
+    } else if (rc && !add && errno == ENOENT) {
+        rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s, &ev);
+    }
+    if (rc) {
+        LOG_ERR("Socket %d epoll registration failed: %s", s,
+                Log::Get_system_error().c_str());
+    }
+}
+
+void
+ugcs::vsm::Socket_processor::Epoll_remove(sockets::Socket_handle s)
+{
+    /* Fails if the socket is already closed, the kernel removes it then. */
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s, nullptr);
+}
+
+bool
+ugcs::vsm::Socket_processor::Epoll_wait(std::chrono::microseconds delay)
+{
+    epoll_event events[MAX_EPOLL_EVENTS];
+    int timeout = -1;
+    if (delay.count()) {
+        timeout = std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+    }
+    poll_events.clear();
+    int rc = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, timeout);
+    if (rc < 0) {
+        if (errno == EINTR) {
+            return false;
+        }
+        VSM_SYS_EXCEPTION("Socket_processor epoll_wait error");
+    }
+    bool wakeup = false;
+    auto wait_pipe = piped_waiter->Get_wait_pipe();
+    for (int i = 0; i < rc; i++) {
+        if (events[i].data.fd == wait_pipe) {
+            wakeup = true;
+            continue;
+        }
+        /* Errors and hangups are reported as readiness, like select() does. */
+        int ready = 0;
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            ready |= INTEREST_READ;
+        }
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            ready |= INTEREST_WRITE;
+        }
+        poll_events.push_back({events[i].data.fd, ready});
+    }
+    return wakeup;
+}
+
+int
+ugcs::vsm::Socket_processor::Udp_receive_batch(
+        sockets::Socket_handle s,
+        sockaddr_storage *addresses,
+        size_t *lengths)
+{
+    mmsghdr msgs[UDP_BATCH_SIZE];
+    iovec iovs[UDP_BATCH_SIZE];
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < UDP_BATCH_SIZE; i++) {
+        iovs[i].iov_base = &udp_read_buffer[i * MIN_UDP_PAYLOAD_SIZE_TO_READ];
+        iovs[i].iov_len = MIN_UDP_PAYLOAD_SIZE_TO_READ;
+        msgs[i].msg_hdr.msg_name = &addresses[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int count = recvmmsg(s, msgs, UDP_BATCH_SIZE, 0, nullptr);
+    for (int i = 0; i < count; i++) {
+        lengths[i] = msgs[i].msg_len;
+    }
+    return count;
+}
+
+int
+ugcs::vsm::Socket_processor::Udp_send_batch(sockets::Socket_handle s)
+{
+    mmsghdr msgs[UDP_BATCH_SIZE];
+    iovec iovs[UDP_BATCH_SIZE];
+    memset(msgs, 0, sizeof(msgs));
+    size_t count = udp_write_batch.size();
+    for (size_t i = 0; i < count; i++) {
+        auto &entry = udp_write_batch[i];
+        iovs[i].iov_base = const_cast<void *>(entry.buffer->Get_data());
+        iovs[i].iov_len = entry.buffer->Get_length();
+        if (entry.address) {
+            msgs[i].msg_hdr.msg_name = entry.address->Get_sockaddr_ref();
+            msgs[i].msg_hdr.msg_namelen = entry.address->Get_len();
+        }
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return sendmmsg(s, msgs, count, sockets::SEND_FLAGS);
+}
@@ -25,11 +25,20 @@ Request::Set_processing_handler(const Handler &handler)
     if (status != Status::PENDING) {
         VSM_EXCEPTION(Invalid_op_exception, "Request not in pending state");
     }
-    processing_handler = handler;
+    processing_handler = Inline_handler(handler);
 }
 
 void
 Request::Set_processing_handler(Handler &&handler)
+{
+    if (status != Status::PENDING) {
+        VSM_EXCEPTION(Invalid_op_exception, "Request not in pending state");
+    }
+    processing_handler = Inline_handler(std::move(handler));
+}
+
+void
+Request::Set_processing_handler(Inline_handler &&handler)
 {
     if (status != Status::PENDING) {
         VSM_EXCEPTION(Invalid_op_exception, "Request not in pending state");
@@ -50,12 +59,28 @@ Request::Set_completion_handler(const Request_container::Ptr &context,
                 "and vice versa.");
     }
     completion_context = context;
-    completion_handler = handler;
+    completion_handler = Inline_handler(handler);
 }
 
 void
 Request::Set_completion_handler(const Request_container::Ptr &context,
                                 Handler &&handler)
+{
+    if (status != Status::PENDING) {
+        VSM_EXCEPTION(Invalid_op_exception, "Request not in pending state");
+    }
+    if (!!context != !!handler) {
+        VSM_EXCEPTION(Invalid_op_exception,
+                "Completion handler can not be set without completion context "
+                "and vice versa.");
+    }
+    completion_context = context;
+    completion_handler = Inline_handler(std::move(handler));
+}
+
+void
+Request::Set_completion_handler(const Request_container::Ptr &context,
+                                Inline_handler &&handler)
 {
     if (status != Status::PENDING) {
         VSM_EXCEPTION(Invalid_op_exception, "Request not in pending state");
@@ -150,7 +175,7 @@ Request::Process(bool process_request)
         status = Status::ABORTED;
         ASSERT(completion_handler);
         ASSERT(!completion_context);
-        Handler completion_handler_tmp = std::move(completion_handler);
+        Inline_handler completion_handler_tmp = std::move(completion_handler);
         Destroy();
         /* Possible destruction of the user provided completion handler may have
          * arbitrary side effects, so do it outside the lock.
@@ -174,7 +199,7 @@ Request::Process(bool process_request)
         }
         cond_var.notify_all();
         /* Invoke processing handler. */
-        Handler handler = std::move(processing_handler);
+        Inline_handler handler = std::move(processing_handler);
         lock.unlock();
         handler();
     } else {
@@ -183,7 +208,7 @@ Request::Process(bool process_request)
                           "Attempted to process request notification in invalid state");
         }
         Request_container::Ptr comp_ctx;
-        Handler comp_handler;
+        Inline_handler comp_handler;
         if (completion_handler) {
             /* Abort cannot be done after that. */
             comp_ctx = std::move(completion_context);
@@ -241,7 +266,11 @@ Request::Complete(Status status, Locker locker)
     if (completion_context) {
         Request_container::Ptr comp_ctx = completion_context;
         lock.unlock();
-        comp_ctx->Submit_request(Shared_from_this());
+        if (auto batch = Request_batch::Get_current()) {
+            batch->Submit(comp_ctx, Shared_from_this());
+        } else {
+            comp_ctx->Submit_request(Shared_from_this());
+        }
     } else {
         /* No notification requested. Destroy this request. */
         completion_delivered = true;
@@ -322,7 +351,7 @@ Request::Abort(Locker locker)
         lock.lock();
     }
     /* Destroy possible cyclic references. */
-    Handler proc_handler_tmp = std::move(processing_handler);
+    Inline_handler proc_handler_tmp = std::move(processing_handler);
     Request_container::Ptr completion_context_tmp = std::move(completion_context);
     Handler cancellation_handler_tmp = std::move(cancellation_handler);
     if (status == Status::ABORTED && !submit_needed) {
@@ -395,3 +424,31 @@ Request::Wait_done(bool process_ctx, std::chrono::milliseconds timeout)
                              Make_callback(predicate));
     return Is_done();
 }
+
+Request::Queue_hook*
+Request::Acquire_queue_hook(Request::Ptr request)
+{
+    for (auto& hook : request->queue_hooks) {
+        if (!hook.in_use.exchange(true, std::memory_order_acquire)) {
+            hook.request = std::move(request);
+            return &hook;
+        }
+    }
+    /* Queued in several containers at once, rare case. */
+    auto hook = new Queue_hook();
+    hook->is_dynamic = true;
+    hook->request = std::move(request);
+    return hook;
+}
+
+Request::Ptr
+Request::Release_queue_hook(Queue_hook* hook)
+{
+    Request::Ptr request = std::move(hook->request);
+    if (hook->is_dynamic) {
+        delete hook;
+    } else {
+        hook->in_use.store(false, std::memory_order_release);
+    }
+    return request;
+}
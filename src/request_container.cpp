@@ -9,8 +9,23 @@
 #include <ugcs/vsm/debug.h>
 #include <ugcs/vsm/request_container.h>
 
+#include <algorithm>
+#include <thread>
+
 using namespace ugcs::vsm;
 
+namespace {
+
+/** Waiter of the container which entry is being processed by the current
+ * thread.
+ */
+thread_local Request_container::Request_waiter *processing_waiter = nullptr;
+
+/** Batch current for the thread, see Request_batch::Scope. */
+thread_local Request_batch *current_batch = nullptr;
+
+} /* anonymous namespace */
+
 Request_container::Request_container(
         const std::string& name,
         Request_waiter::Ptr waiter):
@@ -27,13 +42,37 @@ Request_container::~Request_container()
      * longer return pointers).
      */
     ASSERT(!is_enabled);
+    /* Release references of the requests left in the queue, if any. */
+    while (Pop_request());
 }
 
 void
 Request_container::Submit_request(
         Request::Ptr request)
 {
-    Submit_request_impl(request, waiter->Lock_notify());
+    Push_request(std::move(request));
+    waiter->Notify();
+}
+
+void
+Request_container::Push_request(Request::Ptr request)
+{
+    /* Push without the waiter lock, the caller wakes up the consumer. */
+    submits_in_flight++;
+    try {
+        Check_submit(request);
+    } catch (...) {
+        submits_in_flight--;
+        throw;
+    }
+    if (!Reserve_space(request.get())) {
+        submits_in_flight--;
+        request->Abort();
+        return;
+    }
+    auto priority = request->Get_priority();
+    Push_entry(Request::Acquire_queue_hook(std::move(request)), priority);
+    submits_in_flight--;
 }
 
 void
@@ -47,17 +86,15 @@ Request_container::Submit_request_locked(
 int
 Request_container::Process_requests(int requests_limit)
 {
-    Request::Ptr request;
     int num_processed = 0;
     while (!requests_limit || requests_limit > num_processed) {
         auto lock = waiter->Lock();
-        if (request_queue.empty()) {
+        auto entry = Pop_entry();
+        if (!entry) {
             break;
         }
-        request = request_queue.front();
-        request_queue.pop_front();
         lock.Unlock();
-        Process_request(request);
+        Process_entry(entry);
         num_processed++;
     }
     return num_processed;
@@ -66,16 +103,14 @@ Request_container::Process_requests(int requests_limit)
 int
 Request_container::Process_requests(std::unique_lock<std::mutex> &lock, int requests_limit)
 {
-    Request::Ptr request;
     int num_processed = 0;
     while (!requests_limit || requests_limit > num_processed) {
-        if (request_queue.empty()) {
+        auto entry = Pop_entry();
+        if (!entry) {
             break;
         }
-        request = request_queue.front();
-        request_queue.pop_front();
         lock.unlock();
-        Process_request(request);
+        Process_entry(entry);
         lock.lock();
         num_processed++;
     }
@@ -99,6 +134,9 @@ Request_container::Enable()
         VSM_EXCEPTION(Invalid_op_exception, "Container already enabled: %s",
                       name.c_str());
     }
+    if (!stats && Request_stats_registry::Get_instance()->Is_enabled()) {
+        stats = Request_stats_registry::Get_instance()->Get_stats(name);
+    }
     On_enable();
 }
 
@@ -124,10 +162,41 @@ Request_container::Disable()
     Abort_requests();
 
     lock.Lock();
-    if (!request_queue.empty()) {
+    if (Get_queue_size()) {
         VSM_EXCEPTION(Internal_error_exception,
                 "%zu requests still present after container is disabled.",
-                request_queue.size());
+                Get_queue_size());
+    }
+}
+
+void
+Request_container::Set_capacity(size_t capacity, Overflow_policy policy)
+{
+    overflow_policy = policy;
+    this->capacity = capacity;
+    Notify_space(true);
+}
+
+Request_container::Overflow_counters
+Request_container::Get_overflow_counters() const
+{
+    Overflow_counters counters;
+    counters.blocked = num_blocked;
+    counters.rejected = num_rejected;
+    counters.dropped = num_dropped;
+    return counters;
+}
+
+void
+Request_container::Enable_stats()
+{
+    if (is_enabled) {
+        VSM_EXCEPTION(Invalid_op_exception,
+                      "Statistics should be enabled before the container: %s",
+                      name.c_str());
+    }
+    if (!stats) {
+        stats = Request_stats_registry::Get_instance()->Get_stats(name);
     }
 }
 
@@ -155,6 +224,9 @@ Request_container::Set_disabled()
 {
     auto locker = waiter->Lock_notify();
     is_enabled = false;
+    locker.Unlock();
+    /* Blocked producers should not hold disabling. */
+    Notify_space(true);
 }
 
 void
@@ -162,9 +234,20 @@ Request_container::Abort_requests()
 {
     auto lock = waiter->Lock();
     abort_ongoing = true;
+    lock.Unlock();
+    /* Submissions which have seen the container enabled should land in the
+     * queue before it is drained.
+     */
+    while (submits_in_flight.load()) {
+        std::this_thread::yield();
+    }
+    lock.Lock();
+    std::vector<Request::Ptr> requests_copy;
+    while (auto req = Pop_request()) {
+        requests_copy.push_back(std::move(req));
+    }
     bool cont = true;
-    while (!request_queue.empty() && cont) {
-        auto requests_copy = std::move(request_queue);
+    while (!requests_copy.empty() && cont) {
         lock.Unlock();
 
         for (auto& req : requests_copy) {
@@ -175,8 +258,11 @@ Request_container::Abort_requests()
         requests_copy.clear();
 
         lock.Lock();
+        while (auto req = Pop_request()) {
+            requests_copy.push_back(std::move(req));
+        }
         cont = false;
-        for (auto& req : request_queue) {
+        for (auto& req : requests_copy) {
             if (req->Get_status() != Request::Status::ABORTED) {
                 /* Full abort of one request generated another request.
                  * This is potentially error prone, so assert in debug,
@@ -187,6 +273,12 @@ Request_container::Abort_requests()
             }
         }
     }
+    /* Keep the leftovers queued, disabling reports them. */
+    for (auto& req : requests_copy) {
+        auto priority = req->Get_priority();
+        request_queues[static_cast<int>(priority)].Push(
+                Request::Acquire_queue_hook(std::move(req)));
+    }
     /* New submissions are not allowed after this at all. */
     abort_ongoing = false;
 }
@@ -205,9 +297,9 @@ Request_container::Processing_loop()
         On_wait_and_process();
     }
     auto lock = waiter->Lock();
-    if (request_queue.size()) {
+    if (Get_queue_size()) {
         LOG_DEBUG("Request container [%s] still has %zu requests after processing "
-                  "loop exit.", name.c_str(), request_queue.size());
+                  "loop exit.", name.c_str(), Get_queue_size());
     }
 }
 
@@ -220,6 +312,15 @@ Request_container::Submit_request_impl(
 
     VERIFY(locker.Is_same_waiter(waiter), true);
 
+    Check_submit(request);
+    /* Locker notifies the waiter when released. */
+    auto priority = request->Get_priority();
+    Push_entry(Request::Acquire_queue_hook(std::move(request)), priority);
+}
+
+void
+Request_container::Check_submit(const Request::Ptr& request)
+{
     if (!Is_enabled()) {
         if (!abort_ongoing.load()) {
             VSM_EXCEPTION(Internal_error_exception,
@@ -233,5 +334,249 @@ Request_container::Submit_request_impl(
                     static_cast<int>(status), name.c_str());
         }
     }
-    request_queue.push_back(request);
+}
+
+Request::Ptr
+Request_container::Pop_request()
+{
+    while (auto entry = Pop_entry()) {
+        if (entry->is_task) {
+            delete static_cast<Task *>(entry);
+        } else {
+            return Request::Release_queue_hook(static_cast<Request::Queue_hook *>(entry));
+        }
+    }
+    return nullptr;
+}
+
+void
+Request_container::Push_entry(Queue_entry *entry, Request::Priority priority)
+{
+    auto &queue = request_queues[static_cast<int>(priority)];
+    if (!stats) {
+        queue.Push(entry);
+        return;
+    }
+    entry->submit_time = std::chrono::steady_clock::now();
+    queue.Push(entry);
+    /* Depth is approximate, the entry may be already popped. */
+    stats->Record_submit(Get_queue_size());
+}
+
+Request_container::Queue_entry *
+Request_container::Pop_entry()
+{
+    /* Lowest starving class goes first. */
+    for (int i = Request::NUM_PRIORITIES - 1; i > 0; i--) {
+        if (starvation_counts[i] >= STARVATION_LIMIT) {
+            starvation_counts[i] = 0;
+            if (auto entry = request_queues[i].Pop()) {
+                return entry;
+            }
+        }
+    }
+    for (int i = 0; i < Request::NUM_PRIORITIES; i++) {
+        auto entry = request_queues[i].Pop();
+        if (!entry) {
+            continue;
+        }
+        starvation_counts[i] = 0;
+        for (int j = i + 1; j < Request::NUM_PRIORITIES; j++) {
+            if (!request_queues[j].Is_empty()) {
+                starvation_counts[j]++;
+            }
+        }
+        if (capacity.load(std::memory_order_relaxed)) {
+            Notify_space();
+        }
+        return entry;
+    }
+    return nullptr;
+}
+
+bool
+Request_container::Reserve_space(Request *request)
+{
+    size_t limit = capacity.load(std::memory_order_relaxed);
+    if (!limit || Get_queue_size() < limit) {
+        return true;
+    }
+    /* Only fresh submissions are limited. Completion notifications and
+     * requests being aborted are the tail of already accepted work, losing or
+     * delaying them would leave their owners waiting forever.
+     */
+    if (request && (request->Get_priority() == Request::Priority::HIGH ||
+                    !request->Is_request_processing_needed())) {
+        return true;
+    }
+    switch (overflow_policy.load()) {
+    case Overflow_policy::BLOCK: {
+        if (processing_waiter == waiter.get()) {
+            /* Waiting for own processing would never end. */
+            return true;
+        }
+        num_blocked++;
+        std::unique_lock<std::mutex> lock(capacity_mutex);
+        blocked_producers++;
+        /* Pairs with the fence in Notify_space(). */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        capacity_cond.wait(lock, [this]()
+            {
+                size_t limit = capacity.load();
+                return !limit || Get_queue_size() < limit || !Is_enabled();
+            });
+        blocked_producers--;
+        return true;
+    }
+    case Overflow_policy::REJECT:
+        break;
+    case Overflow_policy::DROP_HEAD:
+        if (Drop_head()) {
+            num_dropped++;
+            return true;
+        }
+        break;
+    }
+    num_rejected++;
+    return false;
+}
+
+bool
+Request_container::Drop_head()
+{
+    Request::Ptr dropped;
+    {
+        auto lock = waiter->Lock();
+        /* Urgent requests are never dropped. */
+        for (int i = Request::NUM_PRIORITIES - 1; i > 0 && !dropped; i--) {
+            auto &queue = request_queues[i];
+            auto entry = queue.Peek();
+            if (!entry || entry->is_task) {
+                continue;
+            }
+            auto &request = static_cast<Request::Queue_hook *>(entry)->request;
+            /* Queued completion notification cannot be dropped. */
+            if (!request->Is_coalescable() ||
+                !request->Is_request_processing_needed()) {
+                continue;
+            }
+            /* Pop may fail if the entry is the last one being followed by a
+             * concurrent push.
+             */
+            if (queue.Pop() == entry) {
+                dropped = Request::Release_queue_hook(static_cast<Request::Queue_hook *>(entry));
+            }
+        }
+    }
+    if (!dropped) {
+        return false;
+    }
+    dropped->Abort();
+    return true;
+}
+
+void
+Request_container::Notify_space(bool force)
+{
+    /* Make the popped state visible before checking for blocked producers. */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (force || blocked_producers.load()) {
+        std::unique_lock<std::mutex> lock(capacity_mutex);
+        capacity_cond.notify_all();
+    }
+}
+
+void
+Request_container::Process_entry(Queue_entry *entry)
+{
+    auto prev_waiter = processing_waiter;
+    processing_waiter = waiter.get();
+    try {
+        if (stats) {
+            auto start = std::chrono::steady_clock::now();
+            auto queue_latency = start - entry->submit_time;
+            Process_entry_impl(entry);
+            stats->Record_process(queue_latency, std::chrono::steady_clock::now() - start);
+        } else {
+            Process_entry_impl(entry);
+        }
+    } catch (...) {
+        processing_waiter = prev_waiter;
+        throw;
+    }
+    processing_waiter = prev_waiter;
+}
+
+void
+Request_container::Process_entry_impl(Queue_entry *entry)
+{
+    if (entry->is_task) {
+        std::unique_ptr<Task> task(static_cast<Task *>(entry));
+        task->handler();
+    } else {
+        Process_request(Request::Release_queue_hook(static_cast<Request::Queue_hook *>(entry)));
+    }
+}
+
+bool
+Request_container::Post_task(Inline_callback<void> &&handler, Request::Priority priority)
+{
+    submits_in_flight++;
+    if (!Is_enabled() ||
+        (priority != Request::Priority::HIGH && !Reserve_space(nullptr))) {
+        submits_in_flight--;
+        return false;
+    }
+    auto task = new Task();
+    task->is_task = true;
+    task->handler = std::move(handler);
+    Push_entry(task, priority);
+    submits_in_flight--;
+    waiter->Notify();
+    return true;
+}
+
+/* Request_batch class implementation. */
+
+Request_batch::~Request_batch()
+{
+    Close();
+}
+
+void
+Request_batch::Submit(
+        const Request_container::Ptr& container,
+        Request::Ptr request)
+{
+    container->Push_request(std::move(request));
+    auto waiter = container->Get_waiter();
+    if (std::find(waiters.begin(), waiters.end(), waiter) == waiters.end()) {
+        waiters.push_back(std::move(waiter));
+    }
+}
+
+void
+Request_batch::Close()
+{
+    for (auto& waiter : waiters) {
+        waiter->Notify();
+    }
+    waiters.clear();
+}
+
+Request_batch::Scope::Scope(Request_batch &batch):
+    prev(current_batch)
+{
+    current_batch = &batch;
+}
+
+Request_batch::Scope::~Scope()
+{
+    current_batch = prev;
+}
+
+Request_batch *
+Request_batch::Get_current()
+{
+    return current_batch;
 }
@@ -0,0 +1,230 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Request_pool class implementation.
+ */
+
+#include <ugcs/vsm/request_pool.h>
+#include <ugcs/vsm/debug.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/** Pool and its thread index if the current thread is a pool thread. */
+thread_local Request_pool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+/** Strand being processed by the current thread. */
+thread_local Request_pool::Strand* current_strand = nullptr;
+
+} /* anonymous namespace */
+
+/* Request_pool::Strand class implementation. */
+
+Request_pool::Strand::Strand(Request_pool::Ptr pool):
+    pool(pool)
+{
+}
+
+void
+Request_pool::Strand::Set_container(Request_container::Ptr container)
+{
+    this->container = container;
+}
+
+void
+Request_pool::Strand::Notify()
+{
+    /* Someone may wait for the context explicitly, e.g. in Wait_done(). */
+    Request_waiter::Notify();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!scheduled.exchange(true)) {
+        pool->Schedule(Shared_from_this());
+    }
+}
+
+void
+Request_pool::Strand::Wait_idle()
+{
+    if (current_strand == this) {
+        /* Disabled from own handler. */
+        return;
+    }
+    std::unique_lock<std::mutex> lock(run_mutex);
+    run_cond.wait(lock, [this](){ return !running; });
+}
+
+void
+Request_pool::Strand::Run()
+{
+    auto cont = container.lock();
+    {
+        std::unique_lock<std::mutex> lock(run_mutex);
+        running = true;
+    }
+    current_strand = this;
+    if (cont && cont->Is_enabled()) {
+        cont->Process_requests(STRAND_BATCH_SIZE);
+    }
+    current_strand = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(run_mutex);
+        running = false;
+    }
+    run_cond.notify_all();
+
+    scheduled = false;
+    /* Pairs with the fence in Notify(), either the submitter schedules the
+     * strand or we see its request here.
+     */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (cont && cont->Is_enabled() && cont->Get_queue_size() &&
+        !scheduled.exchange(true)) {
+        /* Go to the queue tail to let other strands run. */
+        pool->Schedule(Shared_from_this());
+    }
+}
+
+/* Request_pool class implementation. */
+
+Request_pool::Request_pool(const std::string& name, size_t num_threads):
+    name(name)
+{
+    if (!num_threads) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        workers.emplace_back(new Worker());
+    }
+}
+
+Request_pool::~Request_pool()
+{
+    ASSERT(!is_enabled);
+}
+
+void
+Request_pool::Enable()
+{
+    if (is_enabled) {
+        VSM_EXCEPTION(Invalid_op_exception, "Pool already enabled: %s",
+                      name.c_str());
+    }
+    is_enabled = true;
+    stop = false;
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thread = std::thread(&Request_pool::Thread_loop, this, i);
+    }
+}
+
+void
+Request_pool::Disable()
+{
+    if (!is_enabled) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        stop = true;
+    }
+    idle_cond.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+        /* Strands reference the pool, break the cycle. */
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        worker->queue.clear();
+    }
+    num_scheduled = 0;
+    is_enabled = false;
+}
+
+Request_processor::Ptr
+Request_pool::Create_processor(const std::string& name)
+{
+    auto strand = Strand::Create(Shared_from_this());
+    auto ctx = Pooled_request_context<true>::Create(name, strand);
+    strand->Set_container(ctx);
+    return ctx;
+}
+
+Request_completion_context::Ptr
+Request_pool::Create_completion_context(const std::string& name)
+{
+    auto strand = Strand::Create(Shared_from_this());
+    auto ctx = Pooled_request_context<false>::Create(name, strand);
+    strand->Set_container(ctx);
+    return ctx;
+}
+
+void
+Request_pool::Schedule(Strand::Ptr strand)
+{
+    size_t index;
+    if (current_pool == this) {
+        /* Keep the work local, idle threads steal it if needed. */
+        index = current_worker;
+    } else {
+        index = next_worker++ % workers.size();
+    }
+    {
+        std::unique_lock<std::mutex> lock(workers[index]->mutex);
+        workers[index]->queue.push_back(std::move(strand));
+    }
+    num_scheduled++;
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    if (num_idle) {
+        idle_cond.notify_one();
+    }
+}
+
+Request_pool::Strand::Ptr
+Request_pool::Take(size_t index)
+{
+    Strand::Ptr strand;
+    {
+        auto& own = *workers[index];
+        std::unique_lock<std::mutex> lock(own.mutex);
+        if (!own.queue.empty()) {
+            strand = std::move(own.queue.front());
+            own.queue.pop_front();
+        }
+    }
+    for (size_t i = 1; !strand && i < workers.size(); i++) {
+        auto& victim = *workers[(index + i) % workers.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+        if (!victim.queue.empty()) {
+            /* Steal from the tail, the owner works on the head. */
+            strand = std::move(victim.queue.back());
+            victim.queue.pop_back();
+            steal_count++;
+        }
+    }
+    if (strand) {
+        num_scheduled--;
+    }
+    return strand;
+}
+
+void
+Request_pool::Thread_loop(size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+    while (true) {
+        auto strand = Take(index);
+        if (strand) {
+            strand->Run();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        if (stop) {
+            break;
+        }
+        num_idle++;
+        idle_cond.wait(lock, [this](){ return stop || num_scheduled > 0; });
+        num_idle--;
+    }
+    current_pool = nullptr;
+}
@@ -0,0 +1,212 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Request container statistics implementation.
+ */
+
+#include <ugcs/vsm/request_stats.h>
+#include <ugcs/vsm/log.h>
+
+#include <algorithm>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/** Update atomic maximum. */
+template <typename T>
+void
+Update_max(std::atomic<T> &max, T value)
+{
+    T cur = max.load(std::memory_order_relaxed);
+    while (value > cur &&
+           !max.compare_exchange_weak(cur, value, std::memory_order_relaxed));
+}
+
+} /* anonymous namespace */
+
+/* Latency_histogram class. */
+
+void
+Latency_histogram::Record(std::chrono::steady_clock::duration value)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+    uint64_t us_value = us > 0 ? us : 0;
+    int bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 && (us_value >> bucket)) {
+        bucket++;
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    total_us.fetch_add(us_value, std::memory_order_relaxed);
+    Update_max(max_us, us_value);
+}
+
+Latency_histogram::Snapshot
+Latency_histogram::Get_snapshot() const
+{
+    Snapshot snapshot;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.total = std::chrono::microseconds(total_us.load(std::memory_order_relaxed));
+    snapshot.max = std::chrono::microseconds(max_us.load(std::memory_order_relaxed));
+    return snapshot;
+}
+
+void
+Latency_histogram::Reset()
+{
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total_us.store(0, std::memory_order_relaxed);
+    max_us.store(0, std::memory_order_relaxed);
+}
+
+std::chrono::microseconds
+Latency_histogram::Snapshot::Get_percentile(double percentile) const
+{
+    if (!count) {
+        return std::chrono::microseconds::zero();
+    }
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS - 1; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(std::chrono::microseconds(uint64_t(1) << i), max);
+        }
+    }
+    return max;
+}
+
+std::chrono::microseconds
+Latency_histogram::Snapshot::Get_mean() const
+{
+    if (!count) {
+        return std::chrono::microseconds::zero();
+    }
+    return total / count;
+}
+
+/* Request_container_stats class. */
+
+Request_container_stats::Request_container_stats(const std::string &name):
+    name(name),
+    period_start(std::chrono::steady_clock::now().time_since_epoch().count())
+{
+}
+
+void
+Request_container_stats::Record_submit(size_t queue_depth)
+{
+    submitted.fetch_add(1, std::memory_order_relaxed);
+    Update_max(max_queue_depth, queue_depth);
+}
+
+void
+Request_container_stats::Record_process(
+        std::chrono::steady_clock::duration queue_latency,
+        std::chrono::steady_clock::duration processing_time)
+{
+    this->queue_latency.Record(queue_latency);
+    this->processing_time.Record(processing_time);
+}
+
+Request_container_stats::Snapshot
+Request_container_stats::Get_snapshot(bool reset)
+{
+    Snapshot snapshot;
+    auto now = std::chrono::steady_clock::now();
+    snapshot.name = name;
+    snapshot.queue_latency = queue_latency.Get_snapshot();
+    snapshot.processing_time = processing_time.Get_snapshot();
+    snapshot.submitted = submitted.load(std::memory_order_relaxed);
+    snapshot.max_queue_depth = max_queue_depth.load(std::memory_order_relaxed);
+    snapshot.period = now.time_since_epoch() -
+            std::chrono::steady_clock::duration(period_start.load());
+    if (reset) {
+        queue_latency.Reset();
+        processing_time.Reset();
+        submitted.store(0, std::memory_order_relaxed);
+        max_queue_depth.store(0, std::memory_order_relaxed);
+        period_start.store(now.time_since_epoch().count());
+    }
+    return snapshot;
+}
+
+double
+Request_container_stats::Snapshot::Get_throughput() const
+{
+    std::chrono::duration<double> seconds = period;
+    if (seconds.count() <= 0) {
+        return 0;
+    }
+    return processing_time.count / seconds.count();
+}
+
+/* Request_stats_registry class. */
+
+Request_stats_registry *
+Request_stats_registry::Get_instance()
+{
+    static Request_stats_registry instance;
+    return &instance;
+}
+
+void
+Request_stats_registry::Set_enabled(bool enabled)
+{
+    this->enabled = enabled;
+}
+
+Request_container_stats::Ptr
+Request_stats_registry::Get_stats(const std::string &name)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto &ptr = stats[name];
+    if (!ptr) {
+        ptr = Request_container_stats::Create(name);
+    }
+    return ptr;
+}
+
+std::vector<Request_container_stats::Snapshot>
+Request_stats_registry::Get_snapshots(bool reset)
+{
+    std::vector<Request_container_stats::Ptr> list;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (auto &entry : stats) {
+            list.push_back(entry.second);
+        }
+    }
+    std::vector<Request_container_stats::Snapshot> result;
+    for (auto &container_stats : list) {
+        result.push_back(container_stats->Get_snapshot(reset));
+    }
+    return result;
+}
+
+void
+Request_stats_registry::Dump()
+{
+    for (auto &s : Get_snapshots(true)) {
+        LOG_INFO("Container [%s]: %.1f req/s, depth max %zu, "
+                 "queued us p50 %lld p99 %lld max %lld, "
+                 "processing us p50 %lld p99 %lld max %lld",
+                 s.name.c_str(), s.Get_throughput(), s.max_queue_depth,
+                 static_cast<long long>(s.queue_latency.Get_percentile(50).count()),
+                 static_cast<long long>(s.queue_latency.Get_percentile(99).count()),
+                 static_cast<long long>(s.queue_latency.max.count()),
+                 static_cast<long long>(s.processing_time.Get_percentile(50).count()),
+                 static_cast<long long>(s.processing_time.Get_percentile(99).count()),
+                 static_cast<long long>(s.processing_time.max.count()));
+    }
+}
@@ -79,7 +79,7 @@ Request_waiter::Locker::Is_same_waiter(const Request_waiter::Ptr& other) const
 template <class Container_list>
 int
 Request_waiter::Wait_and_process_impl(const Container_list &containers,
-                                   std::chrono::milliseconds timeout,
+                                   std::chrono::microseconds timeout,
                                    int requests_limit, Predicate ext_predicate)
 {
     std::unique_lock<std::mutex> lock(mutex);
@@ -115,18 +115,28 @@ Request_waiter::Wait_and_process_impl(const Container_list &containers,
     if (predicate()) {
         return total_processed;
     }
-    /* No requests in the queues, so the lock was not released, safe to wait. */
-    if (timeout.count()) {
-        cond_var.wait_for(lock, timeout, predicate);
-    } else {
-        cond_var.wait(lock, predicate);
+    /* Announce the waiter before the predicate is checked again by the wait
+     * below, pairs with the fence in Notify().
+     */
+    num_waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    try {
+        if (timeout.count()) {
+            cond_var.wait_for(lock, timeout, predicate);
+        } else {
+            cond_var.wait(lock, predicate);
+        }
+    } catch (...) {
+        num_waiters.fetch_sub(1);
+        throw;
     }
+    num_waiters.fetch_sub(1);
     return total_processed;
 }
 
 int
 Request_waiter::Wait_and_process(const std::initializer_list<Request_container::Ptr> &containers,
-                              std::chrono::milliseconds timeout,
+                              std::chrono::microseconds timeout,
                               int requests_limit, Predicate predicate)
 {
     return Wait_and_process_impl(containers, timeout, requests_limit, predicate);
@@ -134,7 +144,7 @@ Request_waiter::Wait_and_process(const std::initializer_list<Request_container::
 
 int
 Request_waiter::Wait_and_process(const std::list<Request_container::Ptr> &containers,
-                              std::chrono::milliseconds timeout,
+                              std::chrono::microseconds timeout,
                               int requests_limit, Predicate predicate)
 {
     return Wait_and_process_impl(containers, timeout, requests_limit, predicate);
@@ -143,8 +153,19 @@ Request_waiter::Wait_and_process(const std::list<Request_container::Ptr> &contai
 void
 Request_waiter::Notify()
 {
+    /* Make submitted state visible before checking for waiters. */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!num_waiters.load()) {
+        return;
+    }
     std::unique_lock<std::mutex> lock(mutex);
-    cond_var.notify_all();
+    /* Counted waiters are blocked while the mutex is held. */
+    if (num_waiters.load() == 1) {
+        /* Single waiter, no need to wake anyone else. */
+        cond_var.notify_one();
+    } else {
+        cond_var.notify_all();
+    }
 }
 
 Request_waiter::Locker
@@ -71,12 +71,27 @@ Request_worker::On_disable()
     thread.join();
     containers.remove(Shared_from_this());
     containers.clear();
+    timers->Clear();
 }
 
 void
 Request_worker::On_wait_and_process()
 {
-    this->waiter->Wait_and_process(containers);
+    /* Zero delay means no timers, so wait indefinitely. */
+    auto delay = timers->Process_timers();
+    this->waiter->Wait_and_process(containers, delay);
+}
+
+Request_worker::Timer::Ptr
+Request_worker::Create_timer(std::chrono::microseconds interval,
+                             const Local_timer_queue::Handler &handler)
+{
+    auto timer = timers->Create_timer(interval, handler);
+    if (std::this_thread::get_id() != thread.get_id()) {
+        /* Wake the worker up to take the new deadline into account. */
+        Post([]() {});
+    }
+    return timer;
 }
 
 void
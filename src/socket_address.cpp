@@ -46,6 +46,26 @@ Socket_address::Socket_address(const std::string& address, const std::string& po
     Set(address, port);
 }
 
+Socket_address::Key::Key(const sockaddr_storage &storage):
+    family(storage.ss_family)
+{
+    if (family == AF_INET) {
+        auto &si = reinterpret_cast<const sockaddr_in &>(storage);
+        port = si.sin_port;
+        memcpy(address, &si.sin_addr, sizeof(si.sin_addr));
+    } else if (family == AF_INET6) {
+        auto &si6 = reinterpret_cast<const sockaddr_in6 &>(storage);
+        port = si6.sin6_port;
+        memcpy(address, &si6.sin6_addr, sizeof(si6.sin6_addr));
+    }
+}
+
+Socket_address::Key
+Socket_address::Get_key()
+{
+    return Key(storage);
+}
+
 size_t
 std::hash<Socket_address::Ptr>::operator() (const Socket_address::Ptr& a) const
 {
@@ -11,6 +11,7 @@
 #include <ugcs/vsm/utils.h>
 #include <ugcs/vsm/debug.h>
 
+#include <algorithm>
 #include <cstring>
 
 using namespace ugcs::vsm;
@@ -45,12 +46,36 @@ Socket_processor::Stream::Write_impl(Io_buffer::Ptr buffer,
                                                        offset,
                                                        completion_handler.template Get_arg<0>());
     request->Set_completion_handler(comp_ctx, completion_handler);
-    auto proc_handler = Make_callback(&Socket_processor::On_write, processor, request, nullptr);
-    request->Set_processing_handler(proc_handler);
+    Submit_write(request);
+    return request;
+}
+
+Operation_waiter
+Socket_processor::Stream::Write_inline_impl(Io_buffer::Ptr buffer,
+                                            Offset offset,
+                                            Io_result &result_arg,
+                                            Request::Inline_handler &&completion_handler,
+                                            Request_completion_context::Ptr comp_ctx)
+{
+    Write_request::Ptr request = Write_request::Create(buffer, Shared_from_this(),
+                                                       offset, result_arg);
+    request->Set_completion_handler(comp_ctx, std::move(completion_handler));
+    Submit_write(request);
+    return request;
+}
+
+void
+Socket_processor::Stream::Submit_write(Write_request::Ptr request)
+{
+    /* Fits the inline handler storage, no callback allocation per write. */
+    request->Set_processing_handler(Request::Inline_handler(
+            [processor = processor, request]()
+            {
+                processor->On_write(request, nullptr);
+            }));
     request->Set_cancellation_handler(Make_callback(&Socket_processor::Cancel_operation,
                                                     processor, request));
     processor->Submit_request(request);
-    return request;
 }
 
 Operation_waiter
@@ -74,12 +99,38 @@ Socket_processor::Stream::Read_impl(size_t max_to_read, size_t min_to_read,
                              max_to_read, min_to_read, Shared_from_this(), offset,
                              completion_handler.template Get_arg<1>());
     request->Set_completion_handler(comp_ctx, completion_handler);
-    auto proc_handler = Make_callback(&Socket_processor::On_read, processor, request, nullptr);
-    request->Set_processing_handler(proc_handler);
+    Submit_read(request);
+    return request;
+}
+
+Operation_waiter
+Socket_processor::Stream::Read_inline_impl(size_t max_to_read, size_t min_to_read,
+                                           Offset offset,
+                                           Io_buffer::Ptr &buffer_arg,
+                                           Io_result &result_arg,
+                                           Request::Inline_handler &&completion_handler,
+                                           Request_completion_context::Ptr comp_ctx)
+{
+    Read_request::Ptr request =
+        Read_request::Create(buffer_arg, max_to_read, min_to_read,
+                             Shared_from_this(), offset, result_arg);
+    request->Set_completion_handler(comp_ctx, std::move(completion_handler));
+    Submit_read(request);
+    return request;
+}
+
+void
+Socket_processor::Stream::Submit_read(Read_request::Ptr request)
+{
+    /* Fits the inline handler storage, no callback allocation per read. */
+    request->Set_processing_handler(Request::Inline_handler(
+            [processor = processor, request]()
+            {
+                processor->On_read(request, nullptr);
+            }));
     request->Set_cancellation_handler(Make_callback(&Socket_processor::Cancel_operation,
             processor, request));
     processor->Submit_request(request);
-    return request;
 }
 
 Operation_waiter
@@ -101,8 +152,12 @@ Socket_processor::Stream::Read_from(
     auto peer_addr = Socket_address::Create();
     completion_handler.Set_arg<2>(peer_addr);
 
-    request->Set_processing_handler(
-            Make_callback(&Socket_processor::On_read, processor, request, peer_addr));
+    /* Fits the inline handler storage, no callback allocation per read. */
+    request->Set_processing_handler(Request::Inline_handler(
+            [processor = processor, request, peer_addr]()
+            {
+                processor->On_read(request, peer_addr);
+            }));
 
     request->Set_cancellation_handler(
             Make_callback(&Socket_processor::Cancel_operation,
@@ -127,8 +182,11 @@ Socket_processor::Stream::Write_to(
 
     request->Set_completion_handler(comp_ctx, completion_handler);
 
-    request->Set_processing_handler(
-            Make_callback(&Socket_processor::On_write, processor, request, dest_addr));
+    request->Set_processing_handler(Request::Inline_handler(
+            [processor = processor, request, dest_addr]()
+            {
+                processor->On_write(request, dest_addr);
+            }));
 
     request->Set_cancellation_handler(
             Make_callback(&Socket_processor::Cancel_operation,
@@ -233,17 +291,23 @@ Socket_processor::Stream::Set_peer_address(Socket_address::Ptr addr)
     processor->Submit_request(request);
 }
 
-Socket_processor::Socket_processor(Piped_request_waiter::Ptr piped_waiter) :
+Socket_processor::Socket_processor(Piped_request_waiter::Ptr piped_waiter, Backend backend) :
         Request_processor("Socket processor", piped_waiter),
-        piped_waiter(piped_waiter)
+        piped_waiter(piped_waiter),
+        backend(backend)
 {
     /* Ignore SIGPIPE signal. We get this error from select. */
 //    Utils::Ignore_signal(SIGPIPE);
     sockets::Init_sockets();
+    if (backend == Backend::EPOLL && !Epoll_open()) {
+        LOG_WARNING("epoll is not supported, socket processor uses select.");
+        this->backend = Backend::SELECT;
+    }
 }
 
 Socket_processor::~Socket_processor()
 {
+    Epoll_close();
     sockets::Done_sockets();
 }
 
@@ -349,6 +413,10 @@ Socket_processor::On_read(Read_request::Ptr request, Socket_address::Ptr addr)
         // Try to satisfy request from cache, first.
         if (stream->Get_type() == Stream::Type::UDP) {
             stream->Process_udp_read_requests();
+        } else if (stream->Get_type() == Stream::Type::TCP &&
+                   stream->receive_begin < stream->receive_end) {
+            // Data taken into the receive ring is not reported by epoll.
+            Handle_read_requests(stream);
         }
     } else {
         request->Set_result_arg(Io_result::CLOSED);
@@ -421,6 +489,33 @@ Socket_processor::Stream::Process_udp_read_requests()
     }
 }
 
+void
+Socket_processor::Stream::Reserve_receive_ring(size_t size)
+{
+    if (receive_buffer && receive_buffer->Get_length() - receive_begin >= size) {
+        return;
+    }
+    size_t buffered = receive_end - receive_begin;
+    std::vector<uint8_t> ring(std::max(RECEIVE_RING_SIZE, size));
+    if (buffered) {
+        memcpy(ring.data(), receive_data + receive_begin, buffered);
+    }
+    /* Moved vector keeps its storage. */
+    receive_data = ring.data();
+    receive_buffer = Io_buffer::Create(std::move(ring));
+    receive_begin = 0;
+    receive_end = buffered;
+}
+
+void
+Socket_processor::Stream::Release_receive_ring()
+{
+    receive_buffer = nullptr;
+    receive_data = nullptr;
+    receive_begin = 0;
+    receive_end = 0;
+}
+
 void
 Socket_processor::On_enable()
 {
@@ -446,6 +541,10 @@ Socket_processor::On_disable()
     Set_disabled();
     /* Wait for worker thread terminates. */
     thread.join();
+    timers->Clear();
+    /* Closed streams could be not synchronized with epoll yet. */
+    dirty_streams.clear();
+    polled_streams.clear();
     completion_ctx->Disable();
     completion_ctx = nullptr;
 }
@@ -466,8 +565,42 @@ Socket_processor::Process_on_disable(Request::Ptr request)
     request->Complete();
 }
 
+int
+Socket_processor::Get_interest(const Stream::Ptr &stream)
+{
+    int interest = 0;
+    switch (stream->Get_state()) {
+    case Io_stream::State::OPENING:
+        interest = INTEREST_WRITE | INTEREST_ERROR;
+        break;
+    case Io_stream::State::OPENED:
+        if (!stream->write_requests.empty()) {
+            interest |= INTEREST_WRITE;
+        }
+        if (!stream->read_requests.empty() || !stream->accept_requests.empty()) {
+            interest |= INTEREST_READ;
+        }
+        break;
+    default:
+        break;
+    }
+    return interest;
+}
+
 void
 Socket_processor::On_wait_and_process()
+{
+    /* Local timers define the wait deadline, zero delay means no timers. */
+    auto delay = timers->Process_timers();
+    if (backend == Backend::EPOLL) {
+        Wait_epoll(delay);
+    } else {
+        Wait_select(delay);
+    }
+}
+
+void
+Socket_processor::Wait_select(std::chrono::microseconds delay)
 {
     fd_set rfds, wfds, efds;
     sockets::Socket_handle max_handle;
@@ -484,42 +617,38 @@ Socket_processor::On_wait_and_process()
         if (stream)
         {
             sockets::Socket_handle s = stream->Get_socket();
-            auto is_set = false;
-            switch (stream->Get_state()) {
-            case Io_stream::State::OPENING:
+            int interest = Get_interest(stream);
+            if (interest & INTEREST_READ) {
+                FD_SET(s, &rfds);
+            }
+            if (interest & INTEREST_WRITE) {
                 FD_SET(s, &wfds);
+            }
+            if (interest & INTEREST_ERROR) {
                 FD_SET(s, &efds);
-                is_set = true;
-                break;
-            case Io_stream::State::OPENED:
-                if (!stream->write_requests.empty()) {
-                    FD_SET(s, &wfds);
-                    is_set = true;
-                }
-                if (!stream->read_requests.empty()) {
-                    FD_SET(s, &rfds);
-                    is_set = true;
-                }
-                if (!stream->accept_requests.empty())
-                {
-                    FD_SET(s, &rfds);
-                    is_set = true;
-                }
-                break;
-            default:
-                break;
             }
-            if (is_set && s > max_handle) {
+            if (interest && s > max_handle) {
                 max_handle = s;
             }
         }
     }
 
-    int rc = select(max_handle + 1, &rfds, &wfds, &efds, nullptr);
+    timeval tv, *timeout = nullptr;
+    if (delay.count()) {
+        tv.tv_sec = delay.count() / 1000000;
+        tv.tv_usec = delay.count() % 1000000;
+        timeout = &tv;
+    }
+
+    int rc = select(max_handle + 1, &rfds, &wfds, &efds, timeout);
 
-    if (rc <= 0) {
+    if (rc < 0) {
         VSM_SYS_EXCEPTION("Socket_processor select error");
     }
+    if (rc == 0) {
+        /* Timers are fired on the next iteration. */
+        return;
+    }
     if (FD_ISSET(wait_pipe, &rfds)) {
         piped_waiter->Ack();
         Process_requests();
@@ -532,48 +661,20 @@ Socket_processor::On_wait_and_process()
         if (stream && stream->parent_stream == nullptr) {
             auto sock = stream->Get_socket();
             if (sock != INVALID_SOCKET) {
+                int events = 0;
                 if (FD_ISSET(sock, &wfds)) {
                     rc--;
-                    switch (stream->Get_state()) {
-                    case Io_stream::State::OPENING:
-                        Handle_select_connect(stream);
-                        /* Start also read/write requests immediately, if any. */
-                        Handle_write_requests(stream);
-                        if (stream->Get_type() == Io_stream::Type::UDP) {
-                            Handle_udp_read_requests(stream);
-                        } else {
-                            Handle_read_requests(stream);
-                        }
-                        break;
-                    case Io_stream::State::OPENED:
-                        Handle_write_requests(stream);
-                        break;
-                    default:
-                        ASSERT(false);
-                        break;
-                    }
+                    events |= INTEREST_WRITE;
                 }
-
                 if (FD_ISSET(sock, &rfds)) {
                     rc--;
-                    switch (stream->Get_state()) {
-                    case Io_stream::State::OPENED:
-                        if (stream->Get_type() == Io_stream::Type::UDP) {
-                            Handle_udp_read_requests(stream);
-                        } else {
-                            Handle_select_accept(stream);
-                            Handle_read_requests(stream);
-                        }
-                        break;
-                    default:
-                        break;
-                    }
+                    events |= INTEREST_READ;
                 }
-
                 if (FD_ISSET(sock, &efds)) {
                     rc--;
-                    Handle_select_connect(stream);
+                    events |= INTEREST_ERROR;
                 }
+                Handle_stream_events(stream, events);
             }
 
             if (stream->Is_closed()) {
@@ -587,6 +688,143 @@ Socket_processor::On_wait_and_process()
     }
 }
 
+void
+Socket_processor::Wait_epoll(std::chrono::microseconds delay)
+{
+    Sync_polled_streams();
+    if (Epoll_wait(delay)) {
+        piped_waiter->Ack();
+        Process_requests();
+        completion_ctx->Process_requests();
+    }
+    for (auto &event : poll_events) {
+        auto iter = polled_streams.find(event.socket);
+        if (iter == polled_streams.end()) {
+            continue;
+        }
+        Stream::Ptr stream = iter->second.lock();
+        if (!stream || stream->Get_socket() != event.socket) {
+            /* Closed while handling previous events. */
+            continue;
+        }
+        Handle_stream_events(stream, event.events & stream->polled_interest);
+        if (stream->Is_closed()) {
+            Unpoll_stream(stream);
+            streams.erase(stream);
+        } else {
+            /* Interest could change, registration is synchronized lazily. */
+            Mark_dirty(stream);
+        }
+    }
+}
+
+void
+Socket_processor::Mark_dirty(const Stream::Ptr &stream)
+{
+    if (backend != Backend::EPOLL) {
+        return;
+    }
+    /* Substreams share the parent socket. */
+    const Stream::Ptr &target = stream->parent_stream ? stream->parent_stream : stream;
+    if (!target->is_dirty) {
+        target->is_dirty = true;
+        dirty_streams.push_back(target);
+    }
+}
+
+void
+Socket_processor::Sync_polled_streams()
+{
+    std::vector<Stream::Ptr> dirty;
+    dirty.swap(dirty_streams);
+    for (auto &entry : dirty) {
+        entry->is_dirty = false;
+        /* UDP substream could be accepted after it was marked. */
+        Stream::Ptr stream = entry->parent_stream ? entry->parent_stream : entry;
+        auto s = stream->Get_socket();
+        if (stream->Is_closed() || s == INVALID_SOCKET) {
+            Unpoll_stream(stream);
+            continue;
+        }
+        int interest = Get_interest(stream);
+        for (auto &substream : stream->substreams) {
+            interest |= Get_interest(substream.second);
+        }
+        if (stream->polled_socket != s) {
+            Unpoll_stream(stream);
+            Epoll_control(s, interest, true);
+            polled_streams[s] = stream;
+            stream->polled_socket = s;
+        } else if (interest != stream->polled_interest) {
+            /* Epoll registration is level triggered and is modified only on
+             * interest change.
+             */
+            Epoll_control(s, interest, false);
+        }
+        stream->polled_interest = interest;
+    }
+}
+
+void
+Socket_processor::Unpoll_stream(const Stream::Ptr &stream)
+{
+    if (stream->polled_socket == INVALID_SOCKET) {
+        return;
+    }
+    auto iter = polled_streams.find(stream->polled_socket);
+    /* The socket can be already reused by another stream. */
+    if (iter != polled_streams.end() && iter->second.lock() == stream) {
+        Epoll_remove(stream->polled_socket);
+        polled_streams.erase(iter);
+    }
+    stream->polled_socket = INVALID_SOCKET;
+    stream->polled_interest = 0;
+}
+
+void
+Socket_processor::Handle_stream_events(const Stream::Ptr &stream, int events)
+{
+    if (events & INTEREST_WRITE) {
+        switch (stream->Get_state()) {
+        case Io_stream::State::OPENING:
+            Handle_select_connect(stream);
+            /* Start also read/write requests immediately, if any. */
+            Handle_write_requests(stream);
+            if (stream->Get_type() == Io_stream::Type::UDP) {
+                Handle_udp_read_requests(stream);
+            } else {
+                Handle_read_requests(stream);
+            }
+            break;
+        case Io_stream::State::OPENED:
+            Handle_write_requests(stream);
+            break;
+        default:
+            ASSERT(false);
+            break;
+        }
+    }
+
+    if (events & INTEREST_READ) {
+        switch (stream->Get_state()) {
+        case Io_stream::State::OPENED:
+            if (stream->Get_type() == Io_stream::Type::UDP) {
+                Handle_udp_read_requests(stream);
+            } else {
+                Handle_select_accept(stream);
+                Handle_read_requests(stream);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (events & INTEREST_ERROR) {
+        Handle_select_connect(stream);
+    }
+}
+
 void
 Socket_processor::Handle_select_connect(Stream::Ptr stream)
 {
@@ -713,17 +951,16 @@ Socket_processor::Handle_select_accept(Stream::Ptr listen_stream)
 void
 Socket_processor::Handle_write_requests(Stream::Ptr stream)
 {
+    if (stream->Get_type() == Io_stream::Type::UDP ||
+        stream->Get_type() == Io_stream::Type::UDP_MULTICAST) {
+        Handle_udp_write_requests(stream);
+        return;
+    }
     /* Try to process as much write operations as we can without blocking. */
     while (!stream->write_requests.empty()) {
         /* Last write request which is waiting */
         auto request = stream->write_requests.front().first;
 
-        auto dest_address = stream->write_requests.front().second;
-        if (!stream->is_connected && dest_address == nullptr) {
-            // Use default address if destination not specified explicitly in request
-            dest_address = stream->peer_address;
-        }
-
         // Lock the request for reading so it cannot get aborted in the middle of operation
         auto locker = request->Lock();
         auto buffer = request->Data_buffer();
@@ -732,22 +969,11 @@ Socket_processor::Handle_write_requests(Stream::Ptr stream)
         if (request->Is_processing()) {
             // Request is still fine to process.
             do {
-                ssize_t written;
-                if (dest_address) {
-                    written = sendto(
-                            stream->Get_socket(),
-                            reinterpret_cast<const char*>(buffer->Get_data()),
-                            buffer->Get_length(),
-                            sockets::SEND_FLAGS,
-                            dest_address->Get_sockaddr_ref(),
-                            dest_address->Get_len());
-                } else {
-                    written = send(
-                            stream->Get_socket(),
-                            reinterpret_cast<const char*>(buffer->Get_data()),
-                            buffer->Get_length(),
-                            sockets::SEND_FLAGS);
-                }
+                ssize_t written = send(
+                        stream->Get_socket(),
+                        reinterpret_cast<const char*>(buffer->Get_data()),
+                        buffer->Get_length(),
+                        sockets::SEND_FLAGS);
                 if (written > 0) {
                     // Success. Update Bytes_written and try again if there is more data. */
                     buffer = buffer->Slice(written);
@@ -793,21 +1019,15 @@ Socket_processor::Handle_write_requests(Stream::Ptr stream)
         }
         // try next request
     }
-    // handle pending writes for all substreams.
-    auto it = stream->substreams.begin();
-    while (it != stream->substreams.end()) {
-        if (it->second->Is_closed()) {
-            it = stream->substreams.erase(it);
-        } else {
-            Handle_write_requests(it->second);
-            ++it;
-        }
-    }
 }
 
 void
 Socket_processor::Handle_read_requests(Stream::Ptr stream)
 {
+    if (stream->Get_type() == Io_stream::Type::TCP) {
+        Handle_tcp_read_requests(stream);
+        return;
+    }
     /* Try to process as much read operations as we can without blocking. */
     while (!stream->read_requests.empty()) {
         /* Last read request which is waiting */
@@ -921,96 +1141,293 @@ Socket_processor::Handle_read_requests(Stream::Ptr stream)
 }
 
 void
-Socket_processor::Handle_udp_read_requests(Stream::Ptr stream)
+Socket_processor::Handle_tcp_read_requests(Stream::Ptr stream)
 {
-    while (true) {
-        auto address_ptr = Socket_address::Create();
-        // TODO: make this value configurable
-        ssize_t read_bytes = MIN_UDP_PAYLOAD_SIZE_TO_READ;
-        auto len = address_ptr->Get_len();
-        auto buffer = std::make_unique<std::vector<uint8_t>>(read_bytes);
-        read_bytes = recvfrom(
-                stream->Get_socket(),
-                reinterpret_cast<char*>(buffer->data()),
-                read_bytes,
-                0,
-                address_ptr->Get_sockaddr_ref(),
-                &len);
-
-        if (read_bytes > 0) {
-            // Got data. Let's look which stream it belongs to...
-            buffer->resize(read_bytes);
-            address_ptr->Set_resolved(true);
-            auto ss = stream->substreams.find(address_ptr);
-            if (ss != stream->substreams.end() && ss->second->Is_closed()) {
-                stream->substreams.erase(ss);
-                ss = stream->substreams.end();
+    /* Try to process as much read operations as we can without blocking. */
+    while (!stream->read_requests.empty()) {
+        /* Last read request which is waiting */
+        auto request = stream->read_requests.front().first;
+        auto address_ptr = stream->read_requests.front().second;
+
+        // Lock the request for reading so it cannot get aborted in the middle of operation
+        auto locker = request->Lock();
+        if (request->Is_processing()) {
+            // Request is still fine to process.
+            request->Set_result_arg(Io_result::OK, locker);
+            auto readmin = request->Get_min_to_read();
+            auto readmax = request->Get_max_to_read();
+            auto close_stream = false;
+            if (readmax == 0) {
+                LOG_WARN("Zero size read requested");
             }
-            if (ss == stream->substreams.end()) {
-                // New peer address. See if we have accepts waiting.
-                if (stream->accept_requests.empty()) {
-                    // No accepts pending. Go over pending reads.
-                    stream->packet_cache.Push(Stream::Cache_entry{std::move(buffer), address_ptr});
-                    stream->Process_udp_read_requests();
-                } else {
-                    // Satisfy pending accept request on master stream.
-                    auto req = stream->accept_requests.front();
-                    auto locker = req->Lock();
-                    if (req->Is_processing()) {
-                        auto substream = Lookup_stream(req->Get_stream());
-                        if (substream) {
-                            substream->peer_address = Socket_address::Create(address_ptr);
-                            substream->peer_address->Set_resolved(true);
-                            substream->local_address = Socket_address::Create(stream->Get_local_address());
-                            substream->local_address->Set_resolved(true);
-                            substream->Update_name();
-                            substream->Set_socket(stream->Get_socket());
-                            substream->Set_state(Io_stream::State::OPENED);
-                            substream->parent_stream = stream;
-
-                            // Insert new stream into substreams.
-                            stream->substreams.emplace(address_ptr, substream);
-
-                            // Save data for later read.
-                            substream->packet_cache.Push(Stream::Cache_entry{std::move(buffer), address_ptr});
-
-                            req->Set_result_arg(Io_result::OK, locker);
-                        } else {
-                            req->Set_result_arg(Io_result::CLOSED, locker);
-                        }
-                        req->Complete(Request::Status::OK, std::move(locker));
-                        stream->accept_requests.pop_front();
-                        // Try reading next packet.
-                        continue;
-                    } else {
-                        // aborted/cancelled requests are handled in On_cancel()
-                        // Let On_cancel handle the possibly cancelled request
-                        // and then get back here for other pending requests.
+            stream->Reserve_receive_ring(readmax);
+
+            /* Read ahead as much as fits the ring while the request can take
+             * more than it has.
+             */
+            while (stream->receive_end - stream->receive_begin < readmax) {
+                ssize_t read_bytes = recv(
+                        stream->Get_socket(),
+                        reinterpret_cast<char*>(stream->receive_data + stream->receive_end),
+                        stream->receive_buffer->Get_length() - stream->receive_end,
+                        0);
+                if (read_bytes > 0) {
+                    // got data, try again.
+                    stream->receive_end += read_bytes;
+                } else if (read_bytes == 0) {
+                    // zero read or other end closed. (half-closed connection)
+                    if (stream->receive_end - stream->receive_begin < readmin) {
+                        // readmin was not reached. Report the stream as closed
+                        // but return the read data anyway.
+                        LOG("Stream half-close: %s", stream->Get_name().c_str());
+                        request->Set_result_arg(Io_result::CLOSED, locker);
+                    }
+                    // Do not close the stream as it can possibly
+                    // still be used for writing...
+                    break;
+                } else if (sockets::Is_last_operation_pending()) {
+                    // read pending
+                    if (stream->receive_end - stream->receive_begin < readmin) {
+                        // min_to_read not reached yet, will finish later.
                         return;
                     }
+                    // we have reached the minimum requested size with next read pending.
+                    break;
+                } else {
+                    // Socket error. assume no other operation can be performed.
+                    LOG("Socket read error for stream '%s': %s",
+                        stream->Get_name().c_str(),
+                        Log::Get_system_error().c_str());
+                    request->Set_result_arg(Io_result::CLOSED, locker);
+                    close_stream = true;
+                    break;
                 }
+            }
+
+            auto length = std::min(stream->receive_end - stream->receive_begin, readmax);
+            if (length <= Stream::RECEIVE_COPY_SIZE) {
+                request->Set_buffer_arg(
+                        Io_buffer::Create(stream->receive_data + stream->receive_begin, length),
+                        locker);
             } else {
-                // This is known substream.
-                ss->second->packet_cache.Push(Stream::Cache_entry{std::move(buffer), address_ptr});
-                ss->second->Process_udp_read_requests();
+                request->Set_buffer_arg(
+                        stream->receive_buffer->Slice(stream->receive_begin, length),
+                        locker);
             }
-        } else if (read_bytes == 0) {
-            // zero read or other end closed. (half-closed connection)
-            // Do not close the stream as it can possibly
-            // still be used for writing...
-            LOG("0 read");
-            return;
-        } else if (sockets::Is_last_operation_pending()) {
-            // read pending. No more data for now.
-            return;
+            stream->receive_begin += length;
+            if (address_ptr && stream->peer_address) {
+                // Connected stream, data always comes from the peer.
+                *address_ptr = *stream->peer_address;
+            }
+
+            request->Complete(Request::Status::OK, std::move(locker));
+            stream->read_requests.pop_front();
+
+            if (close_stream)
+                Close_stream(stream, false);
+            // try next request
+        } else if (request->Is_aborted()) {
+            // Do not care about aborted requests.
+            stream->read_requests.pop_front();
         } else {
+            // cancelled requests are handled in On_cancel()
+            // Let On_cancel handle the possibly cancelled request and then get back here for other pending requests.
+            return;
+        }
+    }
+}
+
+void
+Socket_processor::Handle_udp_read_requests(Stream::Ptr stream)
+{
+    if (udp_read_buffer.empty()) {
+        udp_read_buffer.resize(UDP_BATCH_SIZE * MIN_UDP_PAYLOAD_SIZE_TO_READ);
+    }
+    sockaddr_storage addresses[UDP_BATCH_SIZE];
+    size_t lengths[UDP_BATCH_SIZE];
+    while (true) {
+        int count = Udp_receive_batch(stream->Get_socket(), addresses, lengths);
+        if (count < 0) {
+            if (sockets::Is_last_operation_pending()) {
+                // read pending. No more data for now.
+                return;
+            }
             // Socket error. assume no other operation can be performed.
             LOG("Socket read error for stream '%s': %s. Closing",
                 stream->Get_name().c_str(),
                 Log::Get_system_error().c_str());
             // Let the caller remove it streams.
             Close_stream(stream, false);
-            break;
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!lengths[i]) {
+                // Nothing to deliver.
+                LOG("0 read");
+                continue;
+            }
+            /* Copy the payload to exactly sized buffer, the receive buffer
+             * is reused.
+             */
+            auto data = &udp_read_buffer[i * MIN_UDP_PAYLOAD_SIZE_TO_READ];
+            Handle_udp_datagram(
+                    stream,
+                    std::make_unique<std::vector<uint8_t>>(data, data + lengths[i]),
+                    addresses[i]);
+            if (stream->Is_closed()) {
+                return;
+            }
+        }
+        if (count < static_cast<int>(UDP_BATCH_SIZE)) {
+            // Socket queue is drained.
+            return;
+        }
+    }
+}
+
+void
+Socket_processor::Handle_udp_datagram(
+        const Stream::Ptr &stream,
+        Stream::Buf_ptr buffer,
+        const sockaddr_storage &address)
+{
+    // Let's look which stream it belongs to...
+    Socket_address::Key key(address);
+    auto ss = stream->substreams.find(key);
+    if (ss != stream->substreams.end() && ss->second->Is_closed()) {
+        stream->substreams.erase(ss);
+        ss = stream->substreams.end();
+    }
+    if (ss != stream->substreams.end()) {
+        // This is known substream. Readers get a copy of the address.
+        ss->second->packet_cache.Push(Stream::Cache_entry{std::move(buffer), ss->second->peer_address});
+        ss->second->Process_udp_read_requests();
+        return;
+    }
+    auto address_ptr = Socket_address::Create(address);
+    address_ptr->Set_resolved(true);
+    // New peer address. See if we have accepts waiting.
+    if (!stream->accept_requests.empty()) {
+        // Satisfy pending accept request on master stream.
+        auto req = stream->accept_requests.front();
+        auto locker = req->Lock();
+        if (req->Is_processing()) {
+            auto substream = Lookup_stream(req->Get_stream());
+            if (substream) {
+                substream->peer_address = Socket_address::Create(address_ptr);
+                substream->peer_address->Set_resolved(true);
+                substream->local_address = Socket_address::Create(stream->Get_local_address());
+                substream->local_address->Set_resolved(true);
+                substream->Update_name();
+                substream->Set_socket(stream->Get_socket());
+                substream->Set_state(Io_stream::State::OPENED);
+                substream->parent_stream = stream;
+
+                // Insert new stream into substreams.
+                stream->substreams.emplace(key, substream);
+
+                // Save data for later read.
+                substream->packet_cache.Push(Stream::Cache_entry{std::move(buffer), address_ptr});
+
+                req->Set_result_arg(Io_result::OK, locker);
+            } else {
+                req->Set_result_arg(Io_result::CLOSED, locker);
+            }
+            req->Complete(Request::Status::OK, std::move(locker));
+            stream->accept_requests.pop_front();
+            return;
+        }
+        /* Cancelled requests are handled in On_cancel(). The datagram is
+         * already taken from the socket, so keep it for reads of the master
+         * stream, as if no accepts were pending.
+         */
+    }
+    // No accepts pending. Go over pending reads.
+    stream->packet_cache.Push(Stream::Cache_entry{std::move(buffer), address_ptr});
+    stream->Process_udp_read_requests();
+}
+
+void
+Socket_processor::Handle_udp_write_requests(Stream::Ptr stream)
+{
+    while (true) {
+        Collect_udp_write_requests(stream);
+        // Substreams share the socket, send their writes in the same batch.
+        auto it = stream->substreams.begin();
+        while (it != stream->substreams.end()) {
+            if (it->second->Is_closed()) {
+                it = stream->substreams.erase(it);
+            } else {
+                Collect_udp_write_requests(it->second);
+                ++it;
+            }
+        }
+        if (udp_write_batch.empty()) {
+            return;
+        }
+        size_t batch_size = udp_write_batch.size();
+        int sent = Udp_send_batch(stream->Get_socket());
+        Stream::Ptr failed_stream;
+        if (sent < 0) {
+            if (sockets::Is_last_operation_pending()) {
+                // write pending. will continue later.
+                udp_write_batch.clear();
+                return;
+            }
+            // socket error. assume no other operations can be performed.
+            LOG_DEBUG("socket send error=%s", Log::Get_system_error().c_str());
+            auto &entry = udp_write_batch.front();
+            entry.request->Set_result_arg(Io_result::CLOSED, entry.locker);
+            failed_stream = entry.stream;
+            sent = 1;
+        }
+        /* Release requests which were not sent first, they stay queued. */
+        udp_write_batch.resize(sent);
+        for (auto &entry : udp_write_batch) {
+            entry.request->Complete(Request::Status::OK, std::move(entry.locker));
+            entry.stream->write_requests.pop_front();
+        }
+        udp_write_batch.clear();
+        if (failed_stream) {
+            Close_stream(failed_stream, false);
+            return;
+        }
+        if (static_cast<size_t>(sent) < batch_size) {
+            // Socket buffer is full. will continue later.
+            return;
+        }
+        // try next requests
+    }
+}
+
+void
+Socket_processor::Collect_udp_write_requests(const Stream::Ptr &stream)
+{
+    auto it = stream->write_requests.begin();
+    while (it != stream->write_requests.end() &&
+           udp_write_batch.size() < UDP_BATCH_SIZE) {
+        auto request = it->first;
+        // Lock the request so it cannot get aborted in the middle of operation
+        auto locker = request->Lock();
+        if (request->Is_processing()) {
+            auto dest_address = it->second;
+            if (!stream->is_connected && dest_address == nullptr) {
+                // Use default address if destination not specified explicitly in request
+                dest_address = stream->peer_address;
+            }
+            request->Set_result_arg(Io_result::OK, locker);
+            auto buffer = request->Data_buffer();
+            udp_write_batch.push_back(Udp_write_entry{
+                stream, request, std::move(locker), buffer, dest_address});
+            ++it;
+        } else if (request->Is_aborted()) {
+            // Do not care about aborted requests.
+            locker.unlock();
+            it = stream->write_requests.erase(it);
+        } else {
+            // Cancelled requests are handled in On_cancel()
+            // Let On_cancel handle the possibly cancelled request and then get back here for other pending requests.
+            return;
         }
     }
 }
@@ -1146,6 +1563,7 @@ Socket_processor::On_connect(Io_request::Ptr request, Stream::Ptr stream)
                     request->Set_result_arg(Io_result::OK, locker);
                     // Add to our streams list.
                     streams[stream] = stream;
+                    Mark_dirty(stream);
                 } else {
                     // abort requested.
                     sockets::Close_socket(s);
@@ -1162,6 +1580,7 @@ Socket_processor::On_connect(Io_request::Ptr request, Stream::Ptr stream)
                 stream->Set_socket(s);
                 // Add to our streams list.
                 streams[stream] = stream;
+                Mark_dirty(stream);
                 ASSERT(stream->Get_connect_request());
                 break;
             }
@@ -1301,6 +1720,7 @@ Socket_processor::On_listen(Io_request::Ptr request, Stream::Ptr stream, Socket_
                     if (request->Is_processing()) {
                         // request status is still OK
                         streams[stream] = stream;
+                        Mark_dirty(stream);
                         stream->local_address = Socket_address::Create(addr);
                         stream->Set_name(stream->local_address->Get_as_string());
                         stream->Set_socket(s);
@@ -1450,6 +1870,7 @@ Socket_processor::On_accept(Io_request::Ptr request, Stream::Ptr stream, Socket_
 {
     streams[stream] = stream;
     listen_stream->accept_requests.push_back(request);
+    Mark_dirty(listen_stream->Shared_from_this());
     Check_for_cancel_request(request, false);
 }
 
@@ -1494,9 +1915,12 @@ Socket_processor::Close_stream(Stream::Ptr stream, bool remove_from_streams)
             Close_stream(s.second);
         }
         stream->substreams.clear();
+        /* Unregister while the descriptor is valid. */
+        Unpoll_stream(stream);
         stream->Close_socket();
         stream->Abort_pending_requests();
         stream->packet_cache.Clear();
+        stream->Release_receive_ring();
         if (remove_from_streams) {
             streams.erase(stream);
         }
@@ -1515,6 +1939,54 @@ Socket_processor::On_cancel(Io_request::Ptr cancel_request, Io_request::Ptr requ
     cancel_request->Complete();
 }
 
+Socket_processor::Timer::Ptr
+Socket_processor::Create_timer(std::chrono::microseconds interval,
+                               const Local_timer_queue::Handler &handler)
+{
+    auto timer = timers->Create_timer(interval, handler);
+    if (std::this_thread::get_id() != thread.get_id()) {
+        /* Wake the processor up to take the new deadline into account. */
+        Post([]() {});
+    }
+    return timer;
+}
+
+void
+Socket_processor::Set_timeout(Operation_waiter &waiter, std::chrono::microseconds timeout)
+{
+    auto request = std::dynamic_pointer_cast<Io_request>(waiter.request);
+    if (!request) {
+        VSM_EXCEPTION(Invalid_param_exception, "Not an I/O operation");
+    }
+    auto timer = Create_timer(timeout, Make_callback(
+            &Socket_processor::On_operation_timeout, Shared_from_this(), request));
+    request->Set_done_handler(Make_callback(
+            [](Timer::Ptr timer)
+            {
+                timer->Cancel();
+            }, timer));
+}
+
+bool
+Socket_processor::On_operation_timeout(Io_request::Ptr request)
+{
+    request->Set_done_handler(nullptr);
+    auto locker = request->Lock();
+    if (request->Is_completed() || request->Is_aborted()) {
+        return false;
+    }
+    request->Timed_out() = true;
+    if (request->Is_processing()) {
+        /* Already handled by this thread, cancel it in place. */
+        locker.unlock();
+        Check_for_cancel_request(request, true);
+    } else {
+        /* Still queued, canceled when taken for processing. */
+        request->Cancel(std::move(locker));
+    }
+    return false;
+}
+
 bool
 Socket_processor::Check_for_cancel_request(Io_request::Ptr request, bool force_cancel)
 {
@@ -1641,6 +2113,10 @@ Socket_processor::Lookup_stream(Io_stream::Ptr io_stream)
     auto iter = streams.find(io_stream);
     if (iter != streams.end()) {
         stream = iter->second;
+        /* Lookups are done for requests which can change the interest. */
+        if (stream) {
+            Mark_dirty(stream);
+        }
     }
     return stream;
 }
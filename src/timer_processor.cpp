@@ -8,12 +8,14 @@
 
 #include <ugcs/vsm/timer_processor.h>
 
+#include <algorithm>
+
 using namespace ugcs::vsm;
 
 /* Timer_processor::Timer class implementation. */
 
 Timer_processor::Timer::Timer(const Timer_processor::Ptr &processor,
-                              std::chrono::milliseconds interval):
+                              std::chrono::microseconds interval):
     processor(processor),
     interval(interval),
     fire_time(std::chrono::steady_clock::now() + interval)
@@ -55,6 +57,7 @@ Timer_processor::Timer::Fire()
          */
         return;
     }
+    processor->fire_lateness.Record(std::chrono::steady_clock::now() - fire_time);
     request->Complete();
 }
 
@@ -66,6 +69,7 @@ Timer_processor::Timer::Destroy(bool cancel)
         return;
     }
     is_running = false;
+    processor->active_timers--;
     if (request) {
         if (cancel) {
             auto req_lock = request->Lock();
@@ -81,11 +85,12 @@ Timer_processor::Timer::Destroy(bool cancel)
     processor = nullptr;
 }
 
-void
+size_t
 Timer_processor::Timer::Attach(Timer::Ptr &timer)
 {
     std::unique_lock<std::mutex> lock(mutex);
     attached_timers.push_back(timer);
+    return attached_timers.size();
 }
 
 void
@@ -134,9 +139,15 @@ Timer_processor::Timer::Set_request(Request::Ptr &request)
 
 Singleton<Timer_processor> Timer_processor::singleton;
 
-Timer_processor::Timer_processor():
-    Request_processor("Timer processor")
+Timer_processor::Timer_processor(Backend backend, Resolution resolution):
+    Request_processor("Timer processor"),
+    backend(backend),
+    resolution(resolution)
 {
+    if (backend == Backend::WHEEL && resolution != Resolution::MILLISECONDS) {
+        VSM_EXCEPTION(Invalid_param_exception,
+                      "Timing wheel supports milliseconds resolution only.");
+    }
 }
 
 Timer_processor::Tick_type
@@ -166,11 +177,17 @@ void
 Timer_processor::Insert_timer(Timer::Ptr &timer)
 {
     std::unique_lock<std::mutex> lock(tree_lock);
+    if (backend == Backend::WHEEL) {
+        wheel.Insert(timer, Get_ticks(std::chrono::steady_clock::now()));
+        return;
+    }
     auto result = tree.insert(std::pair<Tick_type, Timer::Ptr>
-        (Get_ticks(timer->Get_fire_time()), timer));
+        (Get_tree_key(timer->Get_fire_time()), timer));
     if (!result.second) {
         /* Same slot already occupied, attach to existing timer. */
-        result.first->second->Attach(timer);
+        auto num_attached = result.first->second->Attach(timer);
+        attached_timers++;
+        Update_max(max_attach_chain, num_attached + 1);
     }
 }
 
@@ -178,6 +195,7 @@ void
 Timer_processor::Timer_handler(Timer::Ptr timer, Handler handler,
                                Request_container::Ptr container)
 {
+    handler_lateness.Record(std::chrono::steady_clock::now() - timer->Get_fire_time());
     if (handler() && timer->Is_running()) {
         timer->fire_time += timer->interval;
         /* Do not allow to accumulate firings. */
@@ -206,7 +224,7 @@ Timer_processor::Create_request(Timer::Ptr &timer, const Handler &handler,
 }
 
 Timer_processor::Timer::Ptr
-Timer_processor::Create_timer(std::chrono::milliseconds interval,
+Timer_processor::Create_timer(std::chrono::microseconds interval,
                               const Handler &handler,
                               Request_container::Ptr container)
 {
@@ -215,15 +233,67 @@ Timer_processor::Create_timer(std::chrono::milliseconds interval,
                 "should be set.");
     }
     Timer::Ptr timer = Timer::Create(Shared_from_this(), interval);
+    Update_max(max_active_timers, ++active_timers);
     Create_request(timer, handler, container);
     return timer;
 }
 
+Timer_processor::Stats
+Timer_processor::Get_stats(bool reset)
+{
+    Stats stats;
+    stats.fire_lateness = fire_lateness.Get_snapshot();
+    stats.handler_lateness = handler_lateness.Get_snapshot();
+    stats.active_timers = active_timers;
+    stats.max_active_timers = std::max(max_active_timers.load(), stats.active_timers);
+    stats.attached_timers = attached_timers;
+    stats.max_attach_chain = max_attach_chain;
+    if (reset) {
+        fire_lateness.Reset();
+        handler_lateness.Reset();
+        max_active_timers = stats.active_timers;
+        attached_timers = 0;
+        max_attach_chain = 0;
+    }
+    return stats;
+}
+
+void
+Timer_processor::Dump_stats()
+{
+    auto s = Get_stats(true);
+    LOG_INFO("Timers: active %zu max %zu, attached %" PRIu64 " max chain %zu, "
+             "fire lateness us p50 %lld p99 %lld max %lld, "
+             "handler lateness us p50 %lld p99 %lld max %lld",
+             s.active_timers, s.max_active_timers,
+             s.attached_timers, s.max_attach_chain,
+             static_cast<long long>(s.fire_lateness.Get_percentile(50).count()),
+             static_cast<long long>(s.fire_lateness.Get_percentile(99).count()),
+             static_cast<long long>(s.fire_lateness.max.count()),
+             static_cast<long long>(s.handler_lateness.Get_percentile(50).count()),
+             static_cast<long long>(s.handler_lateness.Get_percentile(99).count()),
+             static_cast<long long>(s.handler_lateness.max.count()));
+}
+
+void
+Timer_processor::Update_max(std::atomic<size_t> &max, size_t value)
+{
+    size_t cur = max.load(std::memory_order_relaxed);
+    while (value > cur &&
+           !max.compare_exchange_weak(cur, value, std::memory_order_relaxed));
+}
+
 void
 Timer_processor::Cancel_timer(Timer::Ptr timer)
 {
     std::unique_lock<std::mutex> lock(tree_lock);
-    Tick_type ticks = Get_ticks(timer->Get_fire_time());
+    if (backend == Backend::WHEEL) {
+        wheel.Remove(*timer);
+        lock.unlock();
+        timer->Destroy(true);
+        return;
+    }
+    Tick_type ticks = Get_tree_key(timer->Get_fire_time());
     do {
         auto it = tree.find(ticks);
         if (it == tree.end()) {
@@ -257,11 +327,22 @@ Timer_processor::On_disable()
     /* Wait for dedicated thread terminates. */
     thread.join();
     std::unique_lock<std::mutex> lock(tree_lock);
-    for (auto& iter : tree) {
-        if (!iter.second->Is_running()) {
+    std::vector<Timer::Ptr> timers;
+    if (backend == Backend::WHEEL) {
+        while (auto timer = wheel.Get_any()) {
+            wheel.Remove(*timer);
+            timers.push_back(timer);
+        }
+    } else {
+        for (auto& iter : tree) {
+            timers.push_back(iter.second);
+        }
+    }
+    for (auto& timer : timers) {
+        if (!timer->Is_running()) {
             continue;
         }
-        auto req = iter.second->request;
+        auto req = timer->request;
         std::string ctx_name = "absent";
         if (req) {
             auto locker = req->Lock();
@@ -270,12 +351,20 @@ Timer_processor::On_disable()
             }
         }
         LOG_ERR("Timer interval [%" PRIu64 " ms] in context [%s] is still running.",
-                static_cast<uint64_t>(iter.second->interval.count()),
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                        timer->interval).count()),
                 ctx_name.c_str());
         /* This is not normal. Timer users should cancel their timers before
          * disabling the timer processor. Try to recover in release anyway. */
         ASSERT(false);
     }
+    if (backend == Backend::WHEEL) {
+        lock.unlock();
+        for (auto& timer : timers) {
+            timer->Destroy(true);
+        }
+        return;
+    }
     /* Cancel all running timers. */
     while (!tree.empty()) {
         auto timer = tree.begin()->second;
@@ -288,31 +377,253 @@ Timer_processor::On_disable()
 void
 Timer_processor::On_wait_and_process()
 {
-    std::unique_lock<std::mutex> lock(tree_lock);
-    while (true) {
-        auto now = std::chrono::steady_clock::now();
-        /* Get nearest timer to fire. */
-        if (tree.empty()) {
-            /* Wait indefinitely. */
-            lock.unlock();
-            this->waiter->Wait_and_process({Shared_from_this()});
-            break;
+    std::chrono::microseconds delay;
+    {
+        /* Completion contexts are notified once for all fired timers. */
+        Request_batch batch;
+        Request_batch::Scope scope(batch);
+        std::unique_lock<std::mutex> lock(tree_lock);
+        if (backend == Backend::WHEEL) {
+            delay = Fire_wheel_timers();
+        } else {
+            delay = Fire_tree_timers();
         }
+    }
+    /* If waken up by timeout, timers will be fired during next iteration.
+     * Zero delay means indefinite waiting.
+     */
+    this->waiter->Wait_and_process({Shared_from_this()}, delay);
+}
+
+std::chrono::microseconds
+Timer_processor::Fire_tree_timers()
+{
+    auto window = Get_coalescing_window();
+    bool fired = false;
+    while (!tree.empty()) {
+        /* Get nearest timer to fire. */
         auto it = tree.begin();
         Timer::Ptr timer = it->second;
-        std::chrono::milliseconds delay =
-            std::chrono::duration_cast<std::chrono::milliseconds>
-            (timer->Get_fire_time().time_since_epoch() - now.time_since_epoch());
-        if (delay.count() > 0) {
-            /* Wait until this timer. */
-            lock.unlock();
-            this->waiter->Wait_and_process({Shared_from_this()},
-                                           delay);
-            /* If waken up by timeout, timers will be fired during next iteration. */
-            break;
+        auto delay = Get_fire_delay(timer->Get_fire_time());
+        /* Timers close to the expired ones are fired with them. */
+        if (delay.count() > 0 && (!fired || delay > window)) {
+            return delay;
         }
+        fired = true;
         /* Some expired timers exist, fire them. */
         tree.erase(it);
         timer->Fire();
     }
+    return std::chrono::microseconds::zero();
+}
+
+std::chrono::microseconds
+Timer_processor::Fire_wheel_timers()
+{
+    auto now = Get_ticks(std::chrono::steady_clock::now());
+    Tick_type window = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Get_coalescing_window()).count();
+    std::vector<Timer::Ptr> expired;
+    wheel.Advance(now, expired);
+    if (!expired.empty() && window) {
+        /* Timers close to the expired ones are fired with them. Wheel time
+         * stays at now, so timers created meanwhile are not delayed.
+         */
+        wheel.Collect(now + window, expired);
+    }
+    for (auto& timer : expired) {
+        timer->Fire();
+    }
+    if (wheel.Is_empty()) {
+        return std::chrono::microseconds::zero();
+    }
+    return std::chrono::milliseconds(
+            std::max<Tick_type>(1, wheel.Get_next_tick() - now));
+}
+
+Timer_processor::Tick_type
+Timer_processor::Get_tree_key(const std::chrono::steady_clock::time_point &time) const
+{
+    if (resolution == Resolution::MICROSECONDS) {
+        return std::chrono::duration_cast<std::chrono::microseconds>
+            (time.time_since_epoch()).count();
+    }
+    return Get_ticks(time);
+}
+
+std::chrono::microseconds
+Timer_processor::Get_fire_delay(const std::chrono::steady_clock::time_point &fire_time) const
+{
+    auto delay = fire_time - std::chrono::steady_clock::now();
+    if (resolution == Resolution::MICROSECONDS) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(delay);
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(delay);
+}
+
+/* Timer_processor::Timer_wheel class implementation. */
+
+void
+Timer_processor::Timer_wheel::Insert(const Timer::Ptr &timer, Tick_type now)
+{
+    if (!size && current < now) {
+        /* Nothing to process in the skipped ticks. */
+        current = now;
+    }
+    Link(timer);
+}
+
+void
+Timer_processor::Timer_wheel::Remove(Timer &timer)
+{
+    if (!timer.wheel_slot) {
+        return;
+    }
+    /* Hold the timer while unlinking since the list owns it. */
+    Timer::Ptr self = timer.wheel_prev ? timer.wheel_prev->wheel_next : *timer.wheel_slot;
+    Timer::Ptr next = std::move(timer.wheel_next);
+    if (next) {
+        next->wheel_prev = timer.wheel_prev;
+    }
+    if (timer.wheel_prev) {
+        timer.wheel_prev->wheel_next = std::move(next);
+    } else {
+        *timer.wheel_slot = std::move(next);
+    }
+    timer.wheel_prev = nullptr;
+    timer.wheel_slot = nullptr;
+    size--;
+}
+
+void
+Timer_processor::Timer_wheel::Advance(Tick_type now, std::vector<Timer::Ptr> &expired)
+{
+    while (current <= now) {
+        if (!size) {
+            current = now + 1;
+            break;
+        }
+        int index = current & (LEVEL_SIZE - 1);
+        if (slots[0][index]) {
+            auto timers = Take_slot(slots[0][index]);
+            expired.insert(expired.end(), timers.begin(), timers.end());
+        }
+        current++;
+        if (!(current & (LEVEL_SIZE - 1))) {
+            /* Move timers of the next block of each level down as soon as it
+             * is entered, so Get_next_tick() sees them even if the wheel
+             * stops at the block start.
+             */
+            for (int level = 1; level < NUM_LEVELS; level++) {
+                int level_index = (current >> (level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+                for (auto& timer : Take_slot(slots[level][level_index])) {
+                    Link(std::move(timer));
+                }
+                if (level_index) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void
+Timer_processor::Timer_wheel::Collect(Tick_type until, std::vector<Timer::Ptr> &expired)
+{
+    Tick_type last = std::min<Tick_type>(until, current + LEVEL_SIZE - 1);
+    for (Tick_type tick = current; tick <= last; tick++) {
+        auto& slot = slots[0][tick & (LEVEL_SIZE - 1)];
+        if (slot) {
+            auto timers = Take_slot(slot);
+            expired.insert(expired.end(), timers.begin(), timers.end());
+        }
+    }
+    /* Timers of the next block of a level are not moved down until the
+     * wheel time enters the block, pick the due ones from there.
+     */
+    for (int level = 1; level < NUM_LEVELS; level++) {
+        int shift = level * LEVEL_BITS;
+        if ((last >> shift) == (current >> shift)) {
+            break;
+        }
+        for (auto& timer : Take_slot(slots[level][(last >> shift) & (LEVEL_SIZE - 1)])) {
+            if (Get_ticks(timer->Get_fire_time()) <= last) {
+                expired.push_back(std::move(timer));
+            } else {
+                Link(std::move(timer));
+            }
+        }
+    }
+}
+
+Timer_processor::Tick_type
+Timer_processor::Timer_wheel::Get_next_tick() const
+{
+    int index = current & (LEVEL_SIZE - 1);
+    for (int i = index; i < LEVEL_SIZE; i++) {
+        if (slots[0][i]) {
+            return current + (i - index);
+        }
+    }
+    /* Next block start, higher levels are moved down there. */
+    return (current | (LEVEL_SIZE - 1)) + 1;
+}
+
+Timer_processor::Timer::Ptr
+Timer_processor::Timer_wheel::Get_any() const
+{
+    if (!size) {
+        return nullptr;
+    }
+    for (auto& level : slots) {
+        for (auto& slot : level) {
+            if (slot) {
+                return slot;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void
+Timer_processor::Timer_wheel::Link(Timer::Ptr timer)
+{
+    constexpr Tick_type range = Tick_type(1) << (NUM_LEVELS * LEVEL_BITS);
+    Tick_type expires = Get_ticks(timer->Get_fire_time());
+    if (expires < current) {
+        expires = current;
+    } else if (expires - current >= range) {
+        /* Re-inserted when the farthest slot is reached. */
+        expires = current + range - 1;
+    }
+    Tick_type delta = expires - current;
+    int level = 0;
+    while (level < NUM_LEVELS - 1 && delta >= (Tick_type(1) << ((level + 1) * LEVEL_BITS))) {
+        level++;
+    }
+    auto& slot = slots[level][(expires >> (level * LEVEL_BITS)) & (LEVEL_SIZE - 1)];
+    timer->wheel_prev = nullptr;
+    timer->wheel_slot = &slot;
+    timer->wheel_next = std::move(slot);
+    if (timer->wheel_next) {
+        timer->wheel_next->wheel_prev = timer.get();
+    }
+    slot = std::move(timer);
+    size++;
+}
+
+std::vector<Timer_processor::Timer::Ptr>
+Timer_processor::Timer_wheel::Take_slot(Timer::Ptr &slot)
+{
+    std::vector<Timer::Ptr> timers;
+    Timer::Ptr timer = std::move(slot);
+    while (timer) {
+        Timer::Ptr next = std::move(timer->wheel_next);
+        timer->wheel_prev = nullptr;
+        timer->wheel_slot = nullptr;
+        timers.push_back(std::move(timer));
+        timer = std::move(next);
+        size--;
+    }
+    return timers;
 }
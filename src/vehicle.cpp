@@ -542,7 +542,7 @@ Vehicle::Handle_ucs_command(
                 item_count++;
             }
             task->payload.ucs_response = ucs_request->response;
-            Submit_vehicle_request(task);
+            Submit_vehicle_request(task, cmd->Get_priority());
         } else {
             Vehicle_command::Type ctype;
             if (cmd == c_arm) {
@@ -588,7 +588,7 @@ Vehicle::Handle_ucs_command(
                 return;
             }
             auto task = Vehicle_command_request::Create(completion_handler, completion_ctx, ctype, params);
-            Submit_vehicle_request(task);
+            Submit_vehicle_request(task, cmd->Get_priority());
         }
     } catch (const std::exception& ex) {
         ucs_request->Complete(ugcs::vsm::proto::STATUS_INVALID_COMMAND, ex.what());
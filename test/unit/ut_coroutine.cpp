@@ -0,0 +1,208 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for coroutine adapters. Built with C++20 when the compiler supports
+ * it, empty otherwise.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+#include <ugcs/vsm/coroutine.h>
+#include "ut_fixtures.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+const char* TEST_FILE = "test_coroutine.tmp";
+
+class Coroutine_fixture: public ut::Processors_fixture {
+public:
+    ~Coroutine_fixture()
+    {
+        std::remove(TEST_FILE);
+    }
+
+    bool
+    Wait_finished()
+    {
+        for (int i = 0; i < 200 && !finished; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return finished;
+    }
+
+    std::atomic_bool finished = { false };
+};
+
+Async_task
+Write_and_read(Coroutine_fixture &f, std::string &data_read, std::thread::id &resumed_in)
+{
+    auto stream = f.fp->Open(TEST_FILE, "w");
+    auto res = co_await Async_write(stream, Io_buffer::Create("coroutine"), f.comp_ctx);
+    resumed_in = std::this_thread::get_id();
+    stream->Close();
+    if (res == Io_result::OK) {
+        stream = f.fp->Open(TEST_FILE, "r");
+        auto read = co_await Async_read(stream, 9, 9, f.comp_ctx);
+        if (read.result == Io_result::OK) {
+            data_read = read.buffer->Get_string();
+        }
+        stream->Close();
+    }
+    f.finished = true;
+}
+
+Async_task
+Socket_exchange(Coroutine_fixture &f, Socket_processor::Stream::Ref client,
+                Socket_processor::Stream::Ref server, std::string &data_read)
+{
+    /* Socket streams complete the steps with inline handlers. */
+    for (auto chunk : {"ping", "pong"}) {
+        auto res = co_await Async_write(client, Io_buffer::Create(chunk), f.comp_ctx);
+        if (res != Io_result::OK) {
+            break;
+        }
+        auto read = co_await Async_read(server, 4, 4, f.comp_ctx);
+        if (read.result != Io_result::OK) {
+            break;
+        }
+        data_read += read.buffer->Get_string();
+    }
+    f.finished = true;
+}
+
+Async_task
+Sleep_and_switch(Coroutine_fixture &f, std::chrono::steady_clock::duration &slept,
+                 Request_processor::Ptr processor, bool &switched)
+{
+    auto start = std::chrono::steady_clock::now();
+    co_await Async_sleep(std::chrono::milliseconds(50), f.comp_ctx);
+    slept = std::chrono::steady_clock::now() - start;
+    co_await Resume_on(processor);
+    switched = true;
+    f.finished = true;
+}
+
+Async_task
+Wait_request(Coroutine_fixture &f, Request::Ptr request, bool &done)
+{
+    Operation_waiter waiter(request);
+    co_await Async_wait(waiter, f.comp_ctx);
+    done = request->Is_done();
+    f.finished = true;
+}
+
+Async_task
+Repeat_and_fail_switch(Coroutine_fixture &f, int &ticks,
+                       Request_processor::Ptr disabled, bool &thrown)
+{
+    /* The same awaiter is reused. */
+    Async_sleep tick(std::chrono::milliseconds(5), f.comp_ctx);
+    for (int i = 0; i < 3; i++) {
+        co_await tick;
+        ticks++;
+    }
+    try {
+        co_await Resume_on(disabled);
+    } catch (const Invalid_op_exception &) {
+        thrown = true;
+    }
+    f.finished = true;
+}
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Coroutine_fixture, coroutine_file_io)
+{
+    std::string data_read;
+    std::thread::id resumed_in;
+    Write_and_read(*this, data_read, resumed_in);
+    CHECK(Wait_finished());
+    /* Resumed in the worker thread. */
+    CHECK(resumed_in != std::this_thread::get_id());
+    CHECK_EQUAL("coroutine", data_read);
+}
+
+TEST_FIXTURE(Coroutine_fixture, coroutine_socket_io)
+{
+    auto sp = Socket_processor::Get_instance();
+    sp->Enable();
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client, server;
+    Io_result result;
+    sp->Listen("127.0.0.1", "12348", Make_setter(listener, result));
+    CHECK(result == Io_result::OK);
+    auto op = sp->Accept(listener, Make_setter(server, result));
+    sp->Connect("127.0.0.1", "12348", Make_setter(client, result));
+    CHECK(result == Io_result::OK);
+    op.Wait();
+    CHECK(server);
+
+    std::string data_read;
+    Socket_exchange(*this, client, server, data_read);
+    CHECK(Wait_finished());
+    CHECK_EQUAL("pingpong", data_read);
+
+    client->Close();
+    server->Close();
+    listener->Close();
+    sp->Disable();
+}
+
+TEST_FIXTURE(Coroutine_fixture, coroutine_sleep_and_switch)
+{
+    auto processor = Request_processor::Create("UT coroutine processor");
+    processor->Enable();
+    std::chrono::steady_clock::duration slept;
+    bool switched = false;
+    Sleep_and_switch(*this, slept, processor, switched);
+    /* Resumed in the processor, which is processed here. */
+    for (int i = 0; i < 200 && !switched; i++) {
+        processor->Process_requests();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(switched);
+    /* Timers have millisecond tick resolution. */
+    CHECK(slept >= std::chrono::milliseconds(49));
+    processor->Disable();
+}
+
+TEST_FIXTURE(Coroutine_fixture, coroutine_wait_operation)
+{
+    auto processor = Request_processor::Create("UT coroutine processor");
+    processor->Enable();
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_callback(
+            [](Request::Ptr r)
+            {
+                r->Complete();
+            }, request));
+    bool done = false;
+    Wait_request(*this, request, done);
+    CHECK(!finished);
+    processor->Submit_request(request);
+    processor->Process_requests();
+    CHECK(Wait_finished());
+    CHECK(done);
+    processor->Disable();
+}
+
+TEST_FIXTURE(Coroutine_fixture, coroutine_reuse_and_disabled_context)
+{
+    auto processor = Request_processor::Create("UT coroutine processor");
+    int ticks = 0;
+    bool thrown = false;
+    Repeat_and_fail_switch(*this, ticks, processor, thrown);
+    CHECK(Wait_finished());
+    CHECK_EQUAL(3, ticks);
+    CHECK(thrown);
+}
+
+#endif /* __cpp_impl_coroutine */
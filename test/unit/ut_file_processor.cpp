@@ -14,6 +14,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 using namespace ugcs::vsm;
 
@@ -263,6 +264,38 @@ TEST_FIXTURE(File_deleter, file_locking)
     proc->Disable();
 }
 
+/* Read from an empty FIFO is not ready at submission, it should complete when
+ * the data arrives.
+ */
+TEST_FIXTURE(File_deleter, fifo_read)
+{
+    File_processor::Ptr proc = File_processor::Create();
+    proc->Enable();
+
+    {
+    CHECK_EQUAL(0, mkfifo(test_path, 0600));
+    auto file = proc->Open(test_path, "r");
+    int write_fd = open(test_path, O_WRONLY);
+    CHECK(write_fd != -1);
+    std::thread writer([write_fd]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK_EQUAL(4, write(write_fd, "fifo", 4));
+    });
+    Io_buffer::Ptr buf;
+    Io_result result;
+    file->Read(4, 4, Make_setter(buf, result));
+    writer.join();
+    CHECK(Io_result::OK == result);
+    CHECK_EQUAL("fifo", buf->Get_string());
+    close(write_fd);
+    file->Close().Wait();
+    }
+
+    proc->Disable();
+    File_processor::Remove_utf8(test_path);
+}
+
 /* Very basic test for UTF-8 file name manipulations. */
 TEST(utf8_paths)
 {
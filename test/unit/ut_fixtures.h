@@ -0,0 +1,76 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Helpers shared by unit tests of asynchronous components.
+ */
+
+#ifndef _UT_FIXTURES_H_
+#define _UT_FIXTURES_H_
+
+#include <ugcs/vsm/vsm.h>
+
+#include <fstream>
+
+namespace ut {
+
+/** Enables timer and file processors and serves a request processor and a
+ * completion context by one worker thread.
+ */
+class Processors_fixture {
+public:
+    Processors_fixture()
+    {
+        ugcs::vsm::Timer_processor::Get_instance()->Enable();
+        fp = ugcs::vsm::File_processor::Create();
+        fp->Enable();
+        processor = ugcs::vsm::Request_processor::Create("UT processor");
+        processor->Enable();
+        comp_ctx = ugcs::vsm::Request_completion_context::Create("UT completion");
+        comp_ctx->Enable();
+        worker = ugcs::vsm::Request_worker::Create("UT worker",
+                std::initializer_list<ugcs::vsm::Request_container::Ptr>{processor, comp_ctx});
+        worker->Enable();
+    }
+
+    ~Processors_fixture()
+    {
+        worker->Disable();
+        processor->Disable();
+        comp_ctx->Disable();
+        fp->Disable();
+        ugcs::vsm::Timer_processor::Get_instance()->Disable();
+    }
+
+    ugcs::vsm::File_processor::Ptr fp;
+    ugcs::vsm::Request_processor::Ptr processor;
+    ugcs::vsm::Request_completion_context::Ptr comp_ctx;
+    ugcs::vsm::Request_worker::Ptr worker;
+};
+
+/** Count Mavlink messages of the given type in the file. */
+inline int
+Count_mavlink_messages(const char *file_name, ugcs::vsm::mavlink::MESSAGE_ID_TYPE id)
+{
+    std::ifstream f(file_name, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)),
+            std::istreambuf_iterator<char>());
+    int count = 0;
+    ugcs::vsm::Mavlink_decoder decoder;
+    decoder.Register_handler(ugcs::vsm::Mavlink_decoder::Make_decoder_handler(
+            [&](ugcs::vsm::Io_buffer::Ptr, ugcs::vsm::mavlink::MESSAGE_ID_TYPE msg_id,
+                uint8_t, uint8_t, uint32_t)
+            {
+                if (msg_id == id) {
+                    count++;
+                }
+            }));
+    decoder.Decode(ugcs::vsm::Io_buffer::Create(std::move(data)));
+    decoder.Disable();
+    return count;
+}
+
+} /* namespace ut */
+
+#endif /* _UT_FIXTURES_H_ */
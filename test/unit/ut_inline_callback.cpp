@@ -0,0 +1,150 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Inline_callback class.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+
+#include <array>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/* Counts live instances. */
+struct Tracked {
+    static int count;
+
+    Tracked()
+    {
+        count++;
+    }
+
+    Tracked(const Tracked &)
+    {
+        count++;
+    }
+
+    Tracked(Tracked &&) noexcept
+    {
+        count++;
+    }
+
+    ~Tracked()
+    {
+        count--;
+    }
+};
+
+int Tracked::count = 0;
+
+int
+Sum(int a, int b)
+{
+    return a + b;
+}
+
+class Adder {
+public:
+    int
+    Add(int a)
+    {
+        return base + a;
+    }
+
+    int base = 10;
+};
+
+} /* anonymous namespace */
+
+TEST(inline_callback_storage)
+{
+    int value = 0;
+    Inline_callback<int> small([&value]() { return ++value; });
+    CHECK(small);
+    CHECK(small.Is_inline());
+    CHECK_EQUAL(1, small());
+
+    std::array<char, 128> big_data;
+    big_data[0] = 5;
+    Inline_callback<int> big([big_data]() { return big_data[0]; });
+    CHECK(!big.Is_inline());
+    CHECK_EQUAL(5, big());
+
+    Inline_callback<int> empty;
+    CHECK(!empty);
+    CHECK_THROW(empty(), Nullptr_exception);
+}
+
+TEST(inline_callback_bound_args)
+{
+    auto cbk = Make_inline_callback(Sum, 2, 3);
+    CHECK(cbk.Is_inline());
+    CHECK_EQUAL(5, cbk());
+
+    auto adder = std::make_shared<Adder>();
+    auto method_cbk = Make_inline_callback(&Adder::Add, adder, 5);
+    CHECK(method_cbk.Is_inline());
+    CHECK_EQUAL(15, method_cbk());
+
+    /* Regular callback is stored by pointer. */
+    Inline_callback<int> shared(Make_callback(Sum, 1, 1));
+    CHECK(shared.Is_inline());
+    CHECK_EQUAL(2, shared());
+    Inline_callback<int> null_shared(Callback_base<int>::Ptr<>(nullptr));
+    CHECK(!null_shared);
+}
+
+TEST(inline_callback_move)
+{
+    {
+        Tracked tracked;
+        Inline_callback<void> a([tracked]() {});
+        Inline_callback<void> big([tracked]() {});
+        CHECK_EQUAL(3, Tracked::count);
+        Inline_callback<void> b(std::move(a));
+        CHECK(!a);
+        CHECK(b);
+        CHECK_EQUAL(3, Tracked::count);
+        b = std::move(big);
+        CHECK_EQUAL(2, Tracked::count);
+        b = nullptr;
+        CHECK_EQUAL(1, Tracked::count);
+    }
+    CHECK_EQUAL(0, Tracked::count);
+}
+
+TEST(inline_callback_request_handlers)
+{
+    auto processor = Request_processor::Create("UT inline processor");
+    auto comp_ctx = Request_completion_context::Create("UT inline completion");
+    processor->Enable();
+    comp_ctx->Enable();
+
+    bool processed = false, completed = false;
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_inline_callback(
+            [&processed](Request::Ptr r)
+            {
+                processed = true;
+                r->Complete();
+            }, request));
+    request->Set_completion_handler(comp_ctx, Request::Inline_handler(
+            [&completed]()
+            {
+                completed = true;
+            }));
+    processor->Submit_request(request);
+    CHECK_EQUAL(1, processor->Process_requests());
+    CHECK(processed);
+    CHECK_EQUAL(1, comp_ctx->Process_requests());
+    CHECK(completed);
+    CHECK(request->Is_done());
+
+    processor->Disable();
+    comp_ctx->Disable();
+}
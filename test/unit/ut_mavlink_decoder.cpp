@@ -148,3 +148,97 @@ TEST(mavlink_decoder_wrong_stx)
     }
 }
 
+
+TEST(mavlink_decoder_seq_tracking)
+{
+    Mavlink_decoder decoder;
+    Mavlink_encoder encoder;
+    mavlink::Pld_heartbeat hb;
+    std::vector<Io_buffer::Ptr> msgs;
+    for (int i = 0; i < 300; i++) {
+        msgs.push_back(encoder.Encode_v2(hb, SYSID, 2));
+    }
+    int reports = 0;
+    float reported_quality = 0;
+    decoder.Register_link_quality_handler(
+            Mavlink_decoder::Make_link_quality_handler(
+                    [&](uint8_t system_id, uint8_t component_id, float quality)
+                    {
+                        CHECK_EQUAL(SYSID, system_id);
+                        CHECK_EQUAL(2, component_id);
+                        reported_quality = quality;
+                        reports++;
+                    }));
+
+    CHECK_EQUAL(-1, decoder.Get_link_quality(SYSID));
+    /* 0..9 in order, 10 and 11 lost, 13 before 12, 14 duplicated. */
+    for (int i = 0; i < 10; i++) {
+        decoder.Decode(msgs[i]);
+    }
+    decoder.Decode(msgs[13]);
+    decoder.Decode(msgs[12]);
+    decoder.Decode(msgs[14]);
+    decoder.Decode(msgs[14]);
+    auto stats = decoder.Get_stats(SYSID);
+    CHECK_EQUAL(2ul, stats.seq_lost);
+    CHECK_EQUAL(1ul, stats.seq_reordered);
+    CHECK_EQUAL(1ul, stats.seq_duplicates);
+    CHECK_EQUAL(2ul, decoder.Get_common_stats().seq_lost);
+    CHECK_CLOSE(13.0 / 15, decoder.Get_link_quality(SYSID), 0.001);
+    CHECK_CLOSE(13.0 / 15, decoder.Get_link_quality(SYSID, 2), 0.001);
+    CHECK_EQUAL(-1, decoder.Get_link_quality(SYSID, 3));
+    CHECK_EQUAL(0, reports);
+
+    /* Sequence number wraps around without losses. */
+    for (int i = 15; i < 300; i++) {
+        decoder.Decode(msgs[i]);
+    }
+    CHECK_EQUAL(2ul, decoder.Get_stats(SYSID).seq_lost);
+    CHECK_EQUAL(3, reports);
+    CHECK_CLOSE(1.0, reported_quality, 0.001);
+}
+
+TEST(mavlink_decoder_seq_resync)
+{
+    Mavlink_decoder decoder;
+    Mavlink_encoder encoder;
+    mavlink::Pld_heartbeat hb;
+    for (int i = 0; i < 100; i++) {
+        decoder.Decode(encoder.Encode_v2(hb, SYSID, 2));
+    }
+    /* Sender reboots and starts numbering from zero again. */
+    Mavlink_encoder rebooted;
+    for (int i = 0; i < 10; i++) {
+        decoder.Decode(rebooted.Encode_v2(hb, SYSID, 2));
+    }
+    auto stats = decoder.Get_stats(SYSID);
+    CHECK_EQUAL(0ul, stats.seq_duplicates);
+    CHECK_EQUAL(0ul, stats.seq_reordered);
+    /* Gap from 99 to 0 is not accounted as lost. */
+    CHECK_EQUAL(0ul, stats.seq_lost);
+    CHECK_CLOSE(1.0, decoder.Get_link_quality(SYSID), 0.001);
+}
+
+TEST(mavlink_decoder_seq_resync_forward)
+{
+    Mavlink_decoder decoder;
+    Mavlink_encoder encoder;
+    mavlink::Pld_heartbeat hb;
+    std::vector<Io_buffer::Ptr> msgs;
+    for (int i = 0; i < 160; i++) {
+        msgs.push_back(encoder.Encode_v2(hb, SYSID, 2));
+    }
+    /* Jump from 10 to 150 is too far ahead to be a gap. */
+    for (int i = 0; i <= 10; i++) {
+        decoder.Decode(msgs[i]);
+    }
+    for (int i = 150; i < 160; i++) {
+        decoder.Decode(msgs[i]);
+    }
+    auto stats = decoder.Get_stats(SYSID);
+    CHECK_EQUAL(0ul, stats.seq_lost);
+    CHECK_EQUAL(0ul, stats.seq_duplicates);
+    CHECK_EQUAL(0ul, stats.seq_reordered);
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().seq_lost);
+    CHECK_CLOSE(1.0, decoder.Get_link_quality(SYSID), 0.001);
+}
@@ -143,6 +143,9 @@ TEST(handler_from_dedicated_processor)
     CHECK(hb_handler_called);
 
     processor->Disable();
+    /* Message is not silently lost when the processor is gone. */
+    CHECK_THROW(demuxer.Demux(buffer, mavlink::MESSAGE_ID::HEARTBEAT, 42, 43, 0),
+                Internal_error_exception);
     demuxer.Disable();
 
 }
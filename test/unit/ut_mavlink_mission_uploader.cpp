@@ -0,0 +1,172 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Mavlink_mission_uploader class.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+#include "ut_fixtures.h"
+
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+const char* OUTPUT_FILE = "test_mission_uploader.tmp";
+
+class Upload_fixture: public ut::Processors_fixture {
+public:
+    Upload_fixture()
+    {
+        stream = fp->Open(OUTPUT_FILE, "w+");
+        mav_stream = Mavlink_stream::Create(stream);
+        mav_stream->Bind_decoder_demuxer();
+        mav_stream->Set_mavlink_v2();
+
+        uploader = Mavlink_mission_uploader::Create(
+                mav_stream, 255, 190, 1, 1, processor, comp_ctx);
+        std::vector<mavlink::Pld_mission_item_int> items(10);
+        uploader->Set_items(items);
+    }
+
+    ~Upload_fixture()
+    {
+        mav_stream->Disable();
+        stream->Close();
+    }
+
+    /* Feed the message as if it was received from the vehicle. */
+    void
+    Receive(const mavlink::Payload_base& payload)
+    {
+        mav_stream->Get_decoder().Decode(Mavlink_encoder().Encode_v2(payload, 1, 1));
+    }
+
+    void
+    Request_item(int seq)
+    {
+        mavlink::Pld_mission_request_int req;
+        req->seq = seq;
+        req->target_system = 255;
+        req->target_component = 190;
+        Receive(req);
+    }
+
+    /* Wait until upload is finished. */
+    bool
+    Wait_done()
+    {
+        for (int i = 0; i < 200 && uploader->Is_active(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return !uploader->Is_active();
+    }
+
+    /* Count messages of the given type written to the stream so far. */
+    int
+    Count_sent(mavlink::MESSAGE_ID_TYPE id)
+    {
+        return ut::Count_mavlink_messages(OUTPUT_FILE, id);
+    }
+
+    Io_stream::Ref stream;
+    Mavlink_stream::Ptr mav_stream;
+    Mavlink_mission_uploader::Ptr uploader;
+
+    Mavlink_mission_uploader::Result result = Mavlink_mission_uploader::Result::CANCELED;
+    float progress = 0;
+    int completions = 0;
+
+    Mavlink_mission_uploader::Completion_handler
+    Completion()
+    {
+        return Mavlink_mission_uploader::Make_completion_handler(
+                [this](Mavlink_mission_uploader::Result res, mavlink::MAV_MISSION_RESULT)
+                {
+                    result = res;
+                    completions++;
+                });
+    }
+
+    Mavlink_mission_uploader::Progress_handler
+    Progress()
+    {
+        return Mavlink_mission_uploader::Make_progress_handler(
+                [this](float value)
+                {
+                    progress = value;
+                });
+    }
+};
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Upload_fixture, windowed_upload)
+{
+    uploader->Set_window(4);
+    uploader->Upload(Completion(), Progress());
+    CHECK(uploader->Is_active());
+
+    /* Items 0..3 are sent on the first request, the next window on seq 4. */
+    Request_item(0);
+    Request_item(4);
+    Request_item(8);
+    /* Retransmission request, item is sent again. */
+    Request_item(9);
+
+    mavlink::Pld_mission_ack ack;
+    ack->type = mavlink::MAV_MISSION_ACCEPTED;
+    Receive(ack);
+
+    CHECK(Wait_done());
+    CHECK(Mavlink_mission_uploader::Result::OK == result);
+    CHECK_EQUAL(1, completions);
+    CHECK_CLOSE(1.0, progress, 0.001);
+
+    /* Let pending writes complete. */
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK_EQUAL(1, Count_sent(mavlink::MESSAGE_ID::MISSION_COUNT));
+    CHECK_EQUAL(11, Count_sent(mavlink::MESSAGE_ID::MISSION_ITEM_INT));
+}
+
+TEST_FIXTURE(Upload_fixture, rejected_upload)
+{
+    uploader->Upload(Completion());
+    Request_item(0);
+    mavlink::Pld_mission_ack ack;
+    ack->type = mavlink::MAV_MISSION_NO_SPACE;
+    Receive(ack);
+    CHECK(Wait_done());
+    CHECK(Mavlink_mission_uploader::Result::REJECTED == result);
+}
+
+TEST_FIXTURE(Upload_fixture, upload_timeout)
+{
+    uploader->Set_timeout(std::chrono::milliseconds(50), 2);
+    uploader->Upload(Completion());
+    CHECK(Wait_done());
+    CHECK(Mavlink_mission_uploader::Result::TIMED_OUT == result);
+    CHECK_EQUAL(1, completions);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    /* Initial count and two retries. */
+    CHECK_EQUAL(3, Count_sent(mavlink::MESSAGE_ID::MISSION_COUNT));
+}
+
+TEST_FIXTURE(Upload_fixture, upload_cancel)
+{
+    uploader->Upload(Completion());
+    CHECK_THROW(uploader->Upload(Completion()), Invalid_op_exception);
+    uploader->Cancel();
+    CHECK(!uploader->Is_active());
+    CHECK(Mavlink_mission_uploader::Result::CANCELED == result);
+    CHECK_EQUAL(1, completions);
+    /* Responses after cancel are ignored. */
+    Request_item(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_EQUAL(1, completions);
+}
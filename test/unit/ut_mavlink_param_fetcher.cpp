@@ -0,0 +1,224 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Mavlink_param_fetcher class.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+#include "ut_fixtures.h"
+
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+const char* OUTPUT_FILE = "test_param_fetcher.tmp";
+const uint32_t TEST_HASH = 0x12345678;
+
+class Fetch_fixture: public ut::Processors_fixture {
+public:
+    Fetch_fixture()
+    {
+        stream = fp->Open(OUTPUT_FILE, "w+");
+        mav_stream = Mavlink_stream::Create(stream);
+        mav_stream->Bind_decoder_demuxer();
+
+        fetcher = Mavlink_param_fetcher::Create(
+                mav_stream, 255, 190, 1, 1, processor, comp_ctx);
+        fetcher->Set_timeout(std::chrono::milliseconds(50), 3);
+        std::remove(Cache_file().c_str());
+    }
+
+    ~Fetch_fixture()
+    {
+        std::remove(Cache_file().c_str());
+        mav_stream->Disable();
+        stream->Close();
+    }
+
+    std::string
+    Cache_file()
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "./params_%08x.cache", TEST_HASH);
+        return name;
+    }
+
+    /* Feed PARAM_VALUE as if it was received from the vehicle. */
+    void
+    Receive_value(int index, int count, float value, const char* name = nullptr)
+    {
+        mavlink::Pld_param_value pv;
+        pv->param_index = index;
+        pv->param_count = count;
+        pv->param_value = value;
+        pv->param_type = mavlink::MAV_PARAM_TYPE_REAL32;
+        if (name) {
+            pv->param_id = name;
+        } else {
+            pv->param_id = "PARAM_" + std::to_string(index);
+        }
+        mav_stream->Get_decoder().Decode(Mavlink_encoder().Encode_v1(pv, 1, 1));
+    }
+
+    void
+    Receive_hash()
+    {
+        float value;
+        std::memcpy(&value, &TEST_HASH, sizeof(value));
+        Receive_value(65535, 20, value, Mavlink_param_fetcher::HASH_PARAM_NAME);
+    }
+
+    bool
+    Wait_done()
+    {
+        for (int i = 0; i < 200 && fetcher->Is_active(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return !fetcher->Is_active();
+    }
+
+    /* Count messages of the given type written to the stream so far. */
+    int
+    Count_sent(mavlink::MESSAGE_ID_TYPE id)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return ut::Count_mavlink_messages(OUTPUT_FILE, id);
+    }
+
+    /* Indices requested by PARAM_REQUEST_READ so far, by-name requests
+     * are not included.
+     */
+    std::vector<int>
+    Requested_indices()
+    {
+        std::ifstream f(OUTPUT_FILE, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)),
+                std::istreambuf_iterator<char>());
+        std::vector<int> indices;
+        Mavlink_decoder decoder;
+        decoder.Register_handler(Mavlink_decoder::Make_decoder_handler(
+                [&](Io_buffer::Ptr buffer, mavlink::MESSAGE_ID_TYPE msg_id,
+                    uint8_t, uint8_t, uint32_t)
+                {
+                    if (msg_id == mavlink::MESSAGE_ID::PARAM_REQUEST_READ) {
+                        mavlink::Pld_param_request_read req(buffer);
+                        if (req->param_index != -1) {
+                            indices.push_back(req->param_index);
+                        }
+                    }
+                }));
+        decoder.Decode(Io_buffer::Create(std::move(data)));
+        decoder.Disable();
+        return indices;
+    }
+
+    Mavlink_param_fetcher::Completion_handler
+    Completion()
+    {
+        return Mavlink_param_fetcher::Make_completion_handler(
+                [this](Mavlink_param_fetcher::Result res)
+                {
+                    result = res;
+                    completions++;
+                });
+    }
+
+    Io_stream::Ref stream;
+    Mavlink_stream::Ptr mav_stream;
+    Mavlink_param_fetcher::Ptr fetcher;
+
+    Mavlink_param_fetcher::Result result = Mavlink_param_fetcher::Result::CANCELED;
+    int completions = 0;
+};
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Fetch_fixture, fetch_with_gaps)
+{
+    fetcher->Set_timeout(std::chrono::milliseconds(300), 3);
+    float progress = 0;
+    fetcher->Fetch(Completion(), Mavlink_param_fetcher::Make_progress_handler(
+            [&](float value)
+            {
+                progress = value;
+            }));
+    for (int i = 0; i < 20; i++) {
+        if (i != 5 && i != 12) {
+            Receive_value(i, 20, i);
+        }
+    }
+    /* Values are handled in the processor thread. */
+    for (int i = 0; i < 100 && fetcher->Get_missing_count() != 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(fetcher->Is_active());
+    CHECK_EQUAL(2ul, fetcher->Get_missing_count());
+
+    /* Stream stall makes the fetcher re-request the gaps only. Next retry
+     * cannot happen earlier than one more timeout later.
+     */
+    std::vector<int> indices;
+    for (int i = 0; i < 100 && indices.size() < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        indices = Requested_indices();
+    }
+    CHECK_EQUAL(2ul, indices.size());
+    CHECK(indices == std::vector<int>({5, 12}));
+    Receive_value(12, 20, 12);
+    Receive_value(5, 20, 5);
+
+    CHECK(Wait_done());
+    CHECK(Mavlink_param_fetcher::Result::OK == result);
+    CHECK_CLOSE(1.0, progress, 0.001);
+    auto params = fetcher->Get_params();
+    CHECK_EQUAL(20ul, params.size());
+    CHECK_EQUAL("PARAM_12", params[12].name);
+    CHECK_CLOSE(12.0, params[12].value, 0.001);
+    CHECK_EQUAL(1, Count_sent(mavlink::MESSAGE_ID::PARAM_REQUEST_LIST));
+    CHECK(!fetcher->Is_from_cache());
+}
+
+TEST_FIXTURE(Fetch_fixture, fetch_from_cache)
+{
+    fetcher->Set_cache_dir(".");
+    fetcher->Fetch(Completion());
+    /* No cache file yet, so the list is fetched. */
+    Receive_hash();
+    for (int i = 0; i < 20; i++) {
+        /* Names with spaces survive the cache. */
+        Receive_value(i, 20, i * 0.5, i == 3 ? "MY PARAM" : nullptr);
+    }
+    CHECK(Wait_done());
+    CHECK(Mavlink_param_fetcher::Result::OK == result);
+    CHECK(!fetcher->Is_from_cache());
+    CHECK(std::ifstream(Cache_file()).is_open());
+
+    fetcher->Fetch(Completion());
+    Receive_hash();
+    CHECK(Wait_done());
+    CHECK(Mavlink_param_fetcher::Result::OK == result);
+    CHECK(fetcher->Is_from_cache());
+    auto params = fetcher->Get_params();
+    CHECK_EQUAL(20ul, params.size());
+    CHECK_EQUAL("PARAM_7", params[7].name);
+    CHECK_CLOSE(3.5, params[7].value, 0.0001);
+    CHECK_EQUAL("MY PARAM", params[3].name);
+    CHECK_EQUAL(1, Count_sent(mavlink::MESSAGE_ID::PARAM_REQUEST_LIST));
+}
+
+TEST_FIXTURE(Fetch_fixture, fetch_timeout)
+{
+    fetcher->Fetch(Completion());
+    CHECK(Wait_done());
+    CHECK(Mavlink_param_fetcher::Result::TIMED_OUT == result);
+    CHECK_EQUAL(1, completions);
+    /* Initial request and three retries. */
+    CHECK_EQUAL(4, Count_sent(mavlink::MESSAGE_ID::PARAM_REQUEST_LIST));
+}
@@ -5,6 +5,9 @@
 #include <UnitTest++.h>
 #include <ugcs/vsm/vsm.h>
 
+#include <fstream>
+#include <thread>
+
 using namespace ugcs::vsm;
 
 void
@@ -39,3 +42,138 @@ TEST(disable_in_handler)
     stream->Close();
     fp->Disable();
 }
+
+TEST(periodic_messages)
+{
+    Timer_processor::Get_instance()->Enable();
+    File_processor::Ptr fp = File_processor::Create();
+    fp->Enable();
+    auto comp_ctx = Request_completion_context::Create("UT periodic completion");
+    auto worker = Request_worker::Create("UT periodic worker",
+            std::initializer_list<Request_container::Ptr>{comp_ctx});
+    comp_ctx->Enable();
+    worker->Enable();
+
+    auto stream = fp->Open("test_mavlink_stream.tmp", "w+");
+    auto mav_stream = Mavlink_stream::Create(stream);
+    mav_stream->Set_mavlink_v2();
+
+    mavlink::Pld_heartbeat hb;
+    mavlink::Pld_system_time st;
+    /* Sequence is shared with regular messages. */
+    mav_stream->Send_message(hb, 1, 1, std::chrono::seconds(1),
+            Operation_waiter::Timeout_handler(), comp_ctx);
+    auto hb_id = mav_stream->Add_periodic_message(
+            hb, 1, 1, std::chrono::milliseconds(40), comp_ctx);
+    auto st_id = mav_stream->Add_periodic_message(
+            st, 1, 1, std::chrono::milliseconds(100), comp_ctx, false);
+    CHECK(hb_id != st_id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(230));
+    mav_stream->Remove_periodic_message(hb_id);
+    CHECK(!mav_stream->Update_periodic_message(hb_id, hb));
+    mav_stream->Remove_periodic_message(st_id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mav_stream->Disable();
+    stream->Close();
+
+    std::ifstream f("test_mavlink_stream.tmp", std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)),
+            std::istreambuf_iterator<char>());
+    int heartbeats = 0, system_times = 0;
+    Mavlink_decoder decoder;
+    decoder.Register_handler(Mavlink_decoder::Make_decoder_handler(
+            [&](Io_buffer::Ptr, mavlink::MESSAGE_ID_TYPE id, uint8_t, uint8_t, uint32_t)
+            {
+                if (id == mavlink::MESSAGE_ID::HEARTBEAT) {
+                    heartbeats++;
+                } else if (id == mavlink::MESSAGE_ID::SYSTEM_TIME) {
+                    system_times++;
+                }
+            }));
+    decoder.Decode(Io_buffer::Create(std::move(data)));
+    decoder.Disable();
+
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().bad_checksum);
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().seq_lost);
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().seq_duplicates);
+    /* One regular and about six periodic heartbeats. */
+    CHECK(heartbeats >= 5 && heartbeats <= 8);
+    CHECK(system_times >= 1 && system_times <= 3);
+
+    worker->Disable();
+    comp_ctx->Disable();
+    fp->Disable();
+    Timer_processor::Get_instance()->Disable();
+}
+
+TEST(periodic_messages_concurrent_send)
+{
+    Timer_processor::Get_instance()->Enable();
+    File_processor::Ptr fp = File_processor::Create();
+    fp->Enable();
+    auto comp_ctx = Request_completion_context::Create("UT periodic completion");
+    auto worker = Request_worker::Create("UT periodic worker",
+            std::initializer_list<Request_container::Ptr>{comp_ctx});
+    comp_ctx->Enable();
+    worker->Enable();
+
+    auto stream = fp->Open("test_mavlink_stream.tmp", "w+");
+    auto mav_stream = Mavlink_stream::Create(stream);
+    mav_stream->Set_mavlink_v2();
+
+    mavlink::Pld_heartbeat hb;
+    mavlink::Pld_system_time st;
+    /* Periods without a useful common divisor. */
+    auto hb_id = mav_stream->Add_periodic_message(
+            hb, 1, 1, std::chrono::milliseconds(7), comp_ctx);
+    auto st_id = mav_stream->Add_periodic_message(
+            st, 1, 1, std::chrono::milliseconds(11), comp_ctx);
+    /* Regular messages and periodic updates from other threads. */
+    std::thread sender([&]()
+        {
+            for (int i = 0; i < 200; i++) {
+                mav_stream->Send_message(st, 1, 1, std::chrono::seconds(1),
+                        Operation_waiter::Timeout_handler(), comp_ctx);
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        });
+    std::thread updater([&]()
+        {
+            for (int i = 0; i < 100; i++) {
+                mav_stream->Update_periodic_message(hb_id, hb);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    sender.join();
+    updater.join();
+    mav_stream->Remove_periodic_message(hb_id);
+    mav_stream->Remove_periodic_message(st_id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mav_stream->Disable();
+    stream->Close();
+
+    std::ifstream f("test_mavlink_stream.tmp", std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)),
+            std::istreambuf_iterator<char>());
+    int heartbeats = 0;
+    Mavlink_decoder decoder;
+    decoder.Register_handler(Mavlink_decoder::Make_decoder_handler(
+            [&](Io_buffer::Ptr, mavlink::MESSAGE_ID_TYPE id, uint8_t, uint8_t, uint32_t)
+            {
+                if (id == mavlink::MESSAGE_ID::HEARTBEAT) {
+                    heartbeats++;
+                }
+            }));
+    decoder.Decode(Io_buffer::Create(std::move(data)));
+    decoder.Disable();
+
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().bad_checksum);
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().seq_lost);
+    CHECK_EQUAL(0ul, decoder.Get_common_stats().seq_duplicates);
+    CHECK(heartbeats >= 5);
+
+    worker->Disable();
+    comp_ctx->Disable();
+    fp->Disable();
+    Timer_processor::Get_instance()->Disable();
+}
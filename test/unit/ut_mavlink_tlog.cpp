@@ -0,0 +1,147 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for tlog capture and replay.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+#include "ut_fixtures.h"
+
+#include <fstream>
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+const char* TLOG_FILE = "test_capture.tlog";
+const int FRAME_COUNT = 40;
+
+class Tlog_fixture: public ut::Processors_fixture {
+public:
+    ~Tlog_fixture()
+    {
+        std::remove(TLOG_FILE);
+    }
+
+    /* Capture heartbeats in two bursts with a pause between them. */
+    void
+    Capture(std::chrono::milliseconds pause)
+    {
+        auto file = fp->Open(TLOG_FILE, "w");
+        auto writer = Mavlink_tlog_writer::Create(file, comp_ctx, 256);
+        writer->Enable();
+        Mavlink_decoder decoder;
+        decoder.Register_frame_handler(writer->Get_frame_handler());
+
+        Mavlink_encoder encoder;
+        mavlink::Pld_heartbeat hb;
+        /* Frame with broken checksum is not captured. */
+        auto corrupted = encoder.Encode_v2(hb, 1, 1);
+        std::vector<uint8_t> bytes(static_cast<const uint8_t*>(corrupted->Get_data()),
+                static_cast<const uint8_t*>(corrupted->Get_data()) + corrupted->Get_length());
+        bytes[bytes.size() - 1] ^= 0xff;
+        auto data = Io_buffer::Create("garbage")->Concatenate(Io_buffer::Create(std::move(bytes)));
+        for (int i = 0; i < FRAME_COUNT; i++) {
+            data = data->Concatenate(i % 2 ? encoder.Encode_v1(hb, 1, 1) :
+                                             encoder.Encode_v2(hb, 1, 1));
+            if (i == FRAME_COUNT / 2 - 1) {
+                decoder.Decode(data);
+                data = Io_buffer::Create();
+                std::this_thread::sleep_for(pause);
+            }
+        }
+        /* Feed in chunks which split frames. */
+        while (data->Get_length()) {
+            size_t len = std::min<size_t>(7, data->Get_length());
+            decoder.Decode(data->Slice(0, len));
+            data = data->Slice(len);
+        }
+        CHECK_EQUAL(static_cast<uint64_t>(FRAME_COUNT), writer->Get_frame_count());
+        writer->Disable();
+        decoder.Disable();
+        /* Wait for the background write. */
+        for (int i = 0; i < 100 && File_size() < expected_size; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK_EQUAL(expected_size, File_size());
+        file->Close();
+    }
+
+    size_t
+    File_size()
+    {
+        std::ifstream f(TLOG_FILE, std::ios::binary | std::ios::ate);
+        return f.tellg();
+    }
+
+    /* Replay the whole file and return number of decoded messages. */
+    int
+    Replay(Io_stream::Ptr stream)
+    {
+        int count = 0;
+        Mavlink_decoder decoder;
+        decoder.Register_handler(Mavlink_decoder::Make_decoder_handler(
+                [&](Io_buffer::Ptr, mavlink::MESSAGE_ID_TYPE, uint8_t, uint8_t, uint32_t)
+                {
+                    count++;
+                }));
+        while (true) {
+            Io_buffer::Ptr buf;
+            Io_result result;
+            stream->Read(64, 1, Make_setter(buf, result));
+            if (result != Io_result::OK) {
+                CHECK(result == Io_result::END_OF_FILE);
+                break;
+            }
+            decoder.Decode(buf);
+        }
+        decoder.Disable();
+        return count;
+    }
+
+    /* Each v2 heartbeat is 21 bytes, v1 is 17 bytes, plus timestamps. */
+    size_t expected_size = FRAME_COUNT / 2 * (21 + 17) + FRAME_COUNT * 8;
+};
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Tlog_fixture, tlog_capture_replay_fast)
+{
+    Capture(std::chrono::milliseconds(100));
+    auto stream = Mavlink_tlog_replay_stream::Create(
+            TLOG_FILE, comp_ctx, Mavlink_tlog_replay_stream::AS_FAST_AS_POSSIBLE);
+    auto start = std::chrono::steady_clock::now();
+    CHECK_EQUAL(FRAME_COUNT, Replay(stream));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(80));
+    CHECK_EQUAL(static_cast<uint64_t>(FRAME_COUNT), stream->Get_frame_count());
+    stream->Close();
+
+    Io_buffer::Ptr buf;
+    Io_result result = Io_result::OK;
+    stream->Read(64, 1, Make_setter(buf, result));
+    CHECK(result == Io_result::CLOSED);
+}
+
+TEST_FIXTURE(Tlog_fixture, tlog_replay_realtime)
+{
+    Capture(std::chrono::milliseconds(200));
+    auto start = std::chrono::steady_clock::now();
+    auto stream = Mavlink_tlog_replay_stream::Create(TLOG_FILE, comp_ctx, 1.0);
+    CHECK_EQUAL(FRAME_COUNT, Replay(stream));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(elapsed >= std::chrono::milliseconds(190));
+    stream->Close();
+
+    /* Four times faster. */
+    start = std::chrono::steady_clock::now();
+    stream = Mavlink_tlog_replay_stream::Create(TLOG_FILE, comp_ctx, 4.0);
+    CHECK_EQUAL(FRAME_COUNT, Replay(stream));
+    elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(elapsed >= std::chrono::milliseconds(45));
+    CHECK(elapsed < std::chrono::milliseconds(190));
+    stream->Close();
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Mpsc_queue class and lock-free request submission.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+#include <ugcs/vsm/mpsc_queue.h>
+
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+struct Node: Mpsc_queue_node {
+    int producer;
+    int value;
+};
+
+const int NUM_PRODUCERS = 4;
+const int NUM_ITEMS = 20000;
+
+} /* anonymous namespace */
+
+TEST(mpsc_queue_basic)
+{
+    Mpsc_queue<Node> queue;
+    Node nodes[3];
+    CHECK(queue.Is_empty());
+    CHECK(!queue.Pop());
+    CHECK(!queue.Peek());
+    for (int i = 0; i < 3; i++) {
+        nodes[i].value = i;
+        queue.Push(&nodes[i]);
+    }
+    CHECK_EQUAL(3ul, queue.Get_size());
+    for (int i = 0; i < 3; i++) {
+        CHECK(queue.Peek() == &nodes[i]);
+        auto node = queue.Pop();
+        CHECK(node == &nodes[i]);
+    }
+    CHECK(!queue.Pop());
+    CHECK(!queue.Peek());
+    CHECK(queue.Is_empty());
+    /* Node can be reused after pop. */
+    queue.Push(&nodes[1]);
+    CHECK(queue.Pop() == &nodes[1]);
+    CHECK(!queue.Pop());
+}
+
+TEST(mpsc_queue_stress)
+{
+    Mpsc_queue<Node> queue;
+    std::vector<Node> nodes(NUM_PRODUCERS * NUM_ITEMS);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&, p]()
+        {
+            for (int i = 0; i < NUM_ITEMS; i++) {
+                auto& node = nodes[p * NUM_ITEMS + i];
+                node.producer = p;
+                node.value = i;
+                queue.Push(&node);
+            }
+        });
+    }
+    /* Per-producer order should be preserved. */
+    std::vector<int> next(NUM_PRODUCERS, 0);
+    int received = 0;
+    bool order_ok = true;
+    while (received < NUM_PRODUCERS * NUM_ITEMS) {
+        auto node = queue.Pop();
+        if (!node) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (node->value != next[node->producer]) {
+            order_ok = false;
+        }
+        next[node->producer] = node->value + 1;
+        received++;
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    CHECK(order_ok);
+    CHECK(!queue.Pop());
+    CHECK(queue.Is_empty());
+}
+
+TEST(request_container_concurrent_submit)
+{
+    auto processor = Request_processor::Create("UT mpsc processor");
+    processor->Enable();
+    auto worker = Request_worker::Create("UT mpsc worker",
+            std::initializer_list<Request_container::Ptr>{processor});
+    worker->Enable();
+
+    std::atomic_int processed = { 0 };
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&]()
+        {
+            for (int i = 0; i < 1000; i++) {
+                auto req = Request::Create();
+                req->Set_processing_handler(Make_callback(
+                        [&processed](Request::Ptr r)
+                        {
+                            processed++;
+                            r->Complete();
+                        }, req));
+                processor->Submit_request(req);
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    for (int i = 0; i < 500 && processed < NUM_PRODUCERS * 1000; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK_EQUAL(NUM_PRODUCERS * 1000, processed.load());
+    worker->Disable();
+    processor->Disable();
+}
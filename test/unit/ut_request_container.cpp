@@ -0,0 +1,412 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Request_container class.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/* Counts live instances to check task destruction. */
+struct Tracked {
+    static int count;
+
+    Tracked()
+    {
+        count++;
+    }
+
+    Tracked(const Tracked &)
+    {
+        count++;
+    }
+
+    Tracked(Tracked &&) noexcept
+    {
+        count++;
+    }
+
+    ~Tracked()
+    {
+        count--;
+    }
+};
+
+int Tracked::count = 0;
+
+} /* anonymous namespace */
+
+TEST(post_ordering_with_requests)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    std::vector<int> order;
+    for (int i = 0; i < 6; i++) {
+        if (i % 2) {
+            CHECK(processor->Post([&order, i]() { order.push_back(i); }));
+        } else {
+            auto req = Request::Create();
+            req->Set_processing_handler(Make_callback(
+                    [&order](Request::Ptr r, int i)
+                    {
+                        order.push_back(i);
+                        r->Complete();
+                    }, req, i));
+            processor->Submit_request(req);
+        }
+    }
+    CHECK_EQUAL(6ul, processor->Get_queue_size());
+    CHECK_EQUAL(6, processor->Process_requests());
+    CHECK_EQUAL(6ul, order.size());
+    for (int i = 0; i < 6 && i < static_cast<int>(order.size()); i++) {
+        CHECK_EQUAL(i, order[i]);
+    }
+    processor->Disable();
+}
+
+TEST(post_to_disabled)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    bool invoked = false;
+    {
+        Tracked tracked;
+        CHECK(processor->Post([&invoked, tracked]() { invoked = true; }));
+    }
+    CHECK_EQUAL(1, Tracked::count);
+    /* Pending task is dropped without invocation. */
+    processor->Disable();
+    CHECK(!invoked);
+    CHECK_EQUAL(0, Tracked::count);
+    CHECK(!processor->Post([&invoked]() { invoked = true; }));
+    CHECK(!invoked);
+}
+
+TEST(post_from_worker)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    auto worker = Request_worker::Create("UT container worker",
+            std::initializer_list<Request_container::Ptr>{processor});
+    worker->Enable();
+    std::atomic_int count = { 0 };
+    for (int i = 0; i < 1000; i++) {
+        processor->Post([&count]() { count++; });
+    }
+    /* Request submitted after the tasks is processed after them. */
+    auto req = Request::Create();
+    int count_seen = 0;
+    req->Set_processing_handler(Make_callback(
+            [&](Request::Ptr r)
+            {
+                count_seen = count;
+                r->Complete();
+            }, req));
+    processor->Submit_request(req);
+    Operation_waiter(req).Wait(false);
+    CHECK_EQUAL(1000, count_seen);
+    worker->Disable();
+    processor->Disable();
+}
+
+TEST(latency_histogram_percentiles)
+{
+    Latency_histogram histogram;
+    for (int i = 0; i < 90; i++) {
+        histogram.Record(std::chrono::microseconds(3));
+    }
+    for (int i = 0; i < 10; i++) {
+        histogram.Record(std::chrono::milliseconds(10));
+    }
+    auto snapshot = histogram.Get_snapshot();
+    CHECK_EQUAL(100u, snapshot.count);
+    CHECK_EQUAL(4, snapshot.Get_percentile(50).count());
+    CHECK_EQUAL(10000, snapshot.Get_percentile(99).count());
+    CHECK_EQUAL(10000, snapshot.max.count());
+    histogram.Reset();
+    CHECK_EQUAL(0u, histogram.Get_snapshot().count);
+}
+
+TEST(container_stats)
+{
+    auto processor = Request_processor::Create("UT stats processor");
+    processor->Enable_stats();
+    processor->Enable();
+    CHECK_THROW(processor->Enable_stats(), Invalid_op_exception);
+    for (int i = 0; i < 5; i++) {
+        auto req = Request::Create();
+        req->Set_processing_handler(Make_callback(
+                [](Request::Ptr r)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    r->Complete();
+                }, req));
+        processor->Submit_request(req);
+    }
+    processor->Post([]() {});
+    CHECK_EQUAL(6, processor->Process_requests());
+    processor->Disable();
+
+    CHECK(processor->Get_stats() ==
+          Request_stats_registry::Get_instance()->Get_stats("UT stats processor"));
+    auto snapshot = processor->Get_stats()->Get_snapshot(true);
+    CHECK_EQUAL("UT stats processor", snapshot.name);
+    CHECK_EQUAL(6u, snapshot.submitted);
+    CHECK_EQUAL(6u, snapshot.max_queue_depth);
+    CHECK_EQUAL(6u, snapshot.processing_time.count);
+    CHECK(snapshot.processing_time.max >= std::chrono::milliseconds(2));
+    CHECK(snapshot.queue_latency.max >= std::chrono::milliseconds(8));
+    CHECK(snapshot.Get_throughput() > 0);
+    CHECK_EQUAL(0u, processor->Get_stats()->Get_snapshot().submitted);
+
+    /* Not collected by default. */
+    auto other = Request_processor::Create("UT no stats processor");
+    other->Enable();
+    CHECK(!other->Get_stats());
+    other->Disable();
+}
+
+TEST(priority_ordering)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    std::vector<int> order;
+    auto submit = [&](int id, Request::Priority priority)
+    {
+        auto req = Request::Create();
+        req->Set_priority(priority);
+        req->Set_processing_handler(Make_callback(
+                [&order](Request::Ptr r, int id)
+                {
+                    order.push_back(id);
+                    r->Complete();
+                }, req, id));
+        processor->Submit_request(req);
+    };
+    submit(0, Request::Priority::LOW);
+    submit(1, Request::Priority::NORMAL);
+    submit(2, Request::Priority::HIGH);
+    submit(3, Request::Priority::NORMAL);
+    submit(4, Request::Priority::HIGH);
+    CHECK_EQUAL(5, processor->Process_requests());
+    std::vector<int> expected = {2, 4, 1, 3, 0};
+    CHECK(order == expected);
+    processor->Disable();
+}
+
+TEST(priority_bounded_starvation)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    int low_position = -1, count = 0;
+    auto low = Request::Create();
+    low->Set_priority(Request::Priority::LOW);
+    low->Set_processing_handler(Make_callback(
+            [&](Request::Ptr r)
+            {
+                low_position = count++;
+                r->Complete();
+            }, low));
+    processor->Submit_request(low);
+    /* Continuous flow of high priority requests. */
+    std::function<void()> submit_high = [&]()
+    {
+        auto req = Request::Create();
+        req->Set_priority(Request::Priority::HIGH);
+        req->Set_processing_handler(Make_callback(
+                [&](Request::Ptr r)
+                {
+                    count++;
+                    r->Complete();
+                    if (count < 100) {
+                        submit_high();
+                    }
+                }, req));
+        processor->Submit_request(req);
+    };
+    submit_high();
+    processor->Process_requests(100);
+    CHECK_EQUAL(Request_container::STARVATION_LIMIT, low_position);
+    processor->Disable();
+}
+
+namespace {
+
+Request::Ptr
+Make_counting_request(int &count)
+{
+    auto req = Request::Create();
+    req->Set_processing_handler(Make_callback(
+            [&count](Request::Ptr r)
+            {
+                count++;
+                r->Complete();
+            }, req));
+    return req;
+}
+
+} /* anonymous namespace */
+
+TEST(capacity_reject)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    processor->Set_capacity(3, Request_container::Overflow_policy::REJECT);
+    int count = 0;
+    std::vector<Request::Ptr> requests;
+    for (int i = 0; i < 5; i++) {
+        requests.push_back(Make_counting_request(count));
+        processor->Submit_request(requests.back());
+    }
+    /* Urgent request is queued over the capacity. */
+    auto urgent = Make_counting_request(count);
+    urgent->Set_priority(Request::Priority::HIGH);
+    processor->Submit_request(urgent);
+    CHECK(!processor->Post([&count]() { count++; }));
+    CHECK_EQUAL(4ul, processor->Get_queue_size());
+    CHECK(requests[3]->Is_aborted());
+    CHECK(requests[4]->Is_aborted());
+    CHECK_EQUAL(4, processor->Process_requests());
+    CHECK_EQUAL(4, count);
+    auto counters = processor->Get_overflow_counters();
+    CHECK_EQUAL(3u, counters.rejected);
+    CHECK_EQUAL(0u, counters.dropped);
+    CHECK_EQUAL(0u, counters.blocked);
+    processor->Disable();
+}
+
+TEST(capacity_drop_head)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    processor->Set_capacity(2, Request_container::Overflow_policy::DROP_HEAD);
+    int count = 0;
+    std::vector<Request::Ptr> requests;
+    for (int i = 0; i < 4; i++) {
+        requests.push_back(Make_counting_request(count));
+        requests.back()->Set_coalescable();
+        processor->Submit_request(requests.back());
+    }
+    CHECK(requests[0]->Is_aborted());
+    CHECK(requests[1]->Is_aborted());
+    CHECK_EQUAL(2ul, processor->Get_queue_size());
+    /* Head is not coalescable, so the new one is rejected. */
+    processor->Process_requests();
+    auto plain = Make_counting_request(count);
+    processor->Submit_request(plain);
+    processor->Submit_request(Make_counting_request(count));
+    auto rejected = Make_counting_request(count);
+    processor->Submit_request(rejected);
+    CHECK(rejected->Is_aborted());
+    CHECK(!plain->Is_aborted());
+    auto counters = processor->Get_overflow_counters();
+    CHECK_EQUAL(2u, counters.dropped);
+    CHECK_EQUAL(1u, counters.rejected);
+    processor->Process_requests();
+    CHECK_EQUAL(4, count);
+    processor->Disable();
+}
+
+TEST(capacity_block)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    processor->Enable();
+    processor->Set_capacity(2, Request_container::Overflow_policy::BLOCK);
+    int count = 0;
+    std::atomic_int submitted = { 0 };
+    std::thread producer([&]()
+    {
+        for (int i = 0; i < 10; i++) {
+            processor->Submit_request(Make_counting_request(count));
+            submitted++;
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK_EQUAL(2, submitted.load());
+    CHECK_EQUAL(2ul, processor->Get_queue_size());
+    while (submitted < 10) {
+        processor->Process_requests();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    producer.join();
+    processor->Process_requests();
+    CHECK_EQUAL(10, count);
+    CHECK(processor->Get_overflow_counters().blocked > 0);
+
+    /* Disabling releases blocked producer. */
+    processor->Submit_request(Make_counting_request(count));
+    processor->Submit_request(Make_counting_request(count));
+    auto blocked = Make_counting_request(count);
+    std::thread blocked_producer([&]()
+    {
+        try {
+            processor->Submit_request(blocked);
+        } catch (const Exception &) {
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    processor->Disable();
+    blocked_producer.join();
+    CHECK(blocked->Is_aborted());
+}
+
+TEST(capacity_passes_completions)
+{
+    auto processor = Request_processor::Create("UT container processor");
+    auto comp_ctx = Request_completion_context::Create("UT container completion");
+    processor->Enable();
+    comp_ctx->Enable();
+    comp_ctx->Set_capacity(1, Request_container::Overflow_policy::REJECT);
+    int count = 0;
+    CHECK(comp_ctx->Post([&count]() { count++; }));
+
+    /* Completion is delivered to the full context. */
+    bool completed = false;
+    auto request = Make_counting_request(count);
+    request->Set_completion_handler(comp_ctx, Make_callback(
+            [&completed]()
+            {
+                completed = true;
+            }));
+    processor->Submit_request(request);
+    processor->Process_requests();
+    CHECK(!request->Is_aborted());
+    CHECK_EQUAL(2ul, comp_ctx->Get_queue_size());
+    std::thread worker([&comp_ctx]()
+    {
+        comp_ctx->Process_requests();
+    });
+    CHECK(request->Wait_done(false, std::chrono::milliseconds(1000)));
+    worker.join();
+    CHECK(completed);
+    CHECK_EQUAL(2, count);
+
+    /* Queued completion is not dropped in favor of a new entry. */
+    comp_ctx->Set_capacity(1, Request_container::Overflow_policy::DROP_HEAD);
+    completed = false;
+    request = Make_counting_request(count);
+    request->Set_coalescable();
+    request->Set_completion_handler(comp_ctx, Make_callback(
+            [&completed]()
+            {
+                completed = true;
+            }));
+    processor->Submit_request(request);
+    processor->Process_requests();
+    CHECK(!comp_ctx->Post([&count]() { count++; }));
+    CHECK_EQUAL(1u, comp_ctx->Get_overflow_counters().rejected);
+    comp_ctx->Process_requests();
+    CHECK(completed);
+    CHECK(request->Is_done());
+
+    processor->Disable();
+    comp_ctx->Disable();
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Request_pool class.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+const int NUM_CONTEXTS = 50;
+const int NUM_REQUESTS = 200;
+
+/* Per-context state checked by the handlers. */
+struct Context_state {
+    Request_processor::Ptr processor;
+    int next = 0;
+    std::atomic_int active = { 0 };
+    bool order_ok = true;
+    bool exclusive_ok = true;
+};
+
+void
+Submit(Context_state& state, int seq, std::atomic_int& done)
+{
+    auto req = Request::Create();
+    req->Set_processing_handler(Make_callback(
+            [&state, &done](Request::Ptr r, int seq)
+            {
+                if (state.active++) {
+                    state.exclusive_ok = false;
+                }
+                if (seq != state.next) {
+                    state.order_ok = false;
+                }
+                state.next = seq + 1;
+                state.active--;
+                r->Complete();
+                done++;
+            }, req, seq));
+    state.processor->Submit_request(req);
+}
+
+} /* anonymous namespace */
+
+TEST(request_pool_strands)
+{
+    auto pool = Request_pool::Create("UT pool", 4);
+    CHECK_EQUAL(4ul, pool->Get_num_threads());
+    pool->Enable();
+    std::vector<Context_state> states(NUM_CONTEXTS);
+    for (auto& state : states) {
+        state.processor = pool->Create_processor("UT pooled processor");
+        state.processor->Enable();
+    }
+    std::atomic_int done = { 0 };
+    /* Each context is fed by a single thread, so the order is defined. */
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 2; p++) {
+        producers.emplace_back([&, p]()
+        {
+            for (int i = 0; i < NUM_REQUESTS; i++) {
+                for (int c = p; c < NUM_CONTEXTS; c += 2) {
+                    Submit(states[c], i, done);
+                }
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    for (int i = 0; i < 500 && done < NUM_CONTEXTS * NUM_REQUESTS; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK_EQUAL(NUM_CONTEXTS * NUM_REQUESTS, done.load());
+    for (auto& state : states) {
+        CHECK(state.order_ok);
+        CHECK(state.exclusive_ok);
+        CHECK_EQUAL(NUM_REQUESTS, state.next);
+        state.processor->Disable();
+    }
+    pool->Disable();
+}
+
+TEST(request_pool_completion)
+{
+    auto pool = Request_pool::Create("UT pool", 2);
+    pool->Enable();
+    auto processor = pool->Create_processor("UT pooled processor");
+    auto comp_ctx = pool->Create_completion_context("UT pooled completion");
+    processor->Enable();
+    comp_ctx->Enable();
+
+    std::thread::id processed_by, completed_by;
+    auto req = Request::Create();
+    req->Set_processing_handler(Make_callback(
+            [&processed_by](Request::Ptr r)
+            {
+                processed_by = std::this_thread::get_id();
+                r->Complete();
+            }, req));
+    req->Set_completion_handler(comp_ctx, Make_callback(
+            [&completed_by]()
+            {
+                completed_by = std::this_thread::get_id();
+            }));
+    processor->Submit_request(req);
+    Operation_waiter(req).Wait(false);
+    CHECK(req->Is_completed());
+    CHECK(processed_by != std::this_thread::get_id());
+    CHECK(completed_by != std::this_thread::get_id());
+
+    processor->Disable();
+    comp_ctx->Disable();
+    pool->Disable();
+}
+
+TEST(request_pool_disable_with_pending)
+{
+    auto pool = Request_pool::Create("UT pool", 1);
+    pool->Enable();
+    auto processor = pool->Create_processor("UT pooled processor");
+    processor->Enable();
+    std::atomic_int done = { 0 };
+    Context_state state;
+    state.processor = processor;
+    /* Block the only thread so that requests stay queued. */
+    auto blocker = Request::Create();
+    blocker->Set_processing_handler(Make_callback(
+            [](Request::Ptr r)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                r->Complete();
+            }, blocker));
+    processor->Submit_request(blocker);
+    for (int i = 0; i < 10; i++) {
+        Submit(state, i, done);
+    }
+    processor->Disable();
+    /* Remaining requests are aborted, no handler runs after disabling. */
+    int done_after_disable = done;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_EQUAL(done_after_disable, done.load());
+    pool->Disable();
+}
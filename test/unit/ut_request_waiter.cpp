@@ -0,0 +1,299 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Request_waiter class.
+ */
+
+#include <UnitTest++.h>
+#include <ugcs/vsm/vsm.h>
+
+#include <thread>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/* Two workers passing a token to each other. */
+class Ping_pong {
+public:
+    Ping_pong()
+    {
+        for (int i = 0; i < 2; i++) {
+            processors[i] = Request_processor::Create("UT ping pong processor");
+            processors[i]->Enable();
+            workers[i] = Request_worker::Create("UT ping pong worker",
+                    std::initializer_list<Request_container::Ptr>{processors[i]});
+            workers[i]->Enable();
+        }
+    }
+
+    ~Ping_pong()
+    {
+        for (int i = 0; i < 2; i++) {
+            workers[i]->Disable();
+            processors[i]->Disable();
+        }
+    }
+
+    void
+    Pass(int to)
+    {
+        auto req = Request::Create();
+        req->Set_processing_handler(Make_callback(
+                [this](Request::Ptr r, int to)
+                {
+                    r->Complete();
+                    if (++passes < total) {
+                        Pass(1 - to);
+                    }
+                }, req, to));
+        processors[to]->Submit_request(req);
+    }
+
+    /* @return Round trips per second. */
+    double
+    Run(int round_trips)
+    {
+        total = round_trips * 2;
+        passes = 0;
+        auto start = std::chrono::steady_clock::now();
+        Pass(0);
+        while (passes < total) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+        return round_trips / elapsed.count();
+    }
+
+    Request_processor::Ptr processors[2];
+    Request_worker::Ptr workers[2];
+    std::atomic_int passes = { 0 };
+    int total = 0;
+};
+
+} /* anonymous namespace */
+
+TEST(wait_woken_by_submit)
+{
+    auto processor = Request_processor::Create("UT waiter processor");
+    processor->Enable();
+    std::atomic_bool processed = { false };
+    std::thread consumer([&]()
+    {
+        while (!processed) {
+            processor->Get_waiter()->Wait_and_process({processor},
+                    std::chrono::milliseconds(5000));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto start = std::chrono::steady_clock::now();
+    auto req = Request::Create();
+    req->Set_processing_handler(Make_callback(
+            [&processed](Request::Ptr r)
+            {
+                processed = true;
+                r->Complete();
+            }, req));
+    processor->Submit_request(req);
+    consumer.join();
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+    processor->Disable();
+}
+
+TEST(submit_without_waiters)
+{
+    /* Nobody waits, requests are just queued. */
+    auto processor = Request_processor::Create("UT waiter processor");
+    processor->Enable();
+    int count = 0;
+    for (int i = 0; i < 100; i++) {
+        auto req = Request::Create();
+        req->Set_processing_handler(Make_callback(
+                [&count](Request::Ptr r)
+                {
+                    count++;
+                    r->Complete();
+                }, req));
+        processor->Submit_request(req);
+    }
+    CHECK_EQUAL(100, processor->Process_requests());
+    CHECK_EQUAL(100, count);
+    processor->Disable();
+}
+
+TEST(ping_pong_benchmark)
+{
+    Ping_pong ping_pong;
+    double rate = ping_pong.Run(20000);
+    LOG_INFO("Ping-pong between two workers: %.0f round trips/s", rate);
+    CHECK(rate > 0);
+}
+
+TEST(submit_requests_range)
+{
+    auto processor = Request_processor::Create("UT waiter processor");
+    processor->Enable();
+    auto worker = Request_worker::Create("UT waiter worker",
+            std::initializer_list<Request_container::Ptr>{processor});
+    worker->Enable();
+    std::vector<int> order;
+    std::vector<Request::Ptr> requests;
+    for (int i = 0; i < 10; i++) {
+        auto req = Request::Create();
+        req->Set_processing_handler(Make_callback(
+                [&order](Request::Ptr r, int i)
+                {
+                    order.push_back(i);
+                    r->Complete();
+                }, req, i));
+        requests.push_back(req);
+    }
+    processor->Submit_requests(requests);
+    Operation_waiter(requests.back()).Wait(false);
+    CHECK_EQUAL(10ul, order.size());
+    for (int i = 0; i < 10 && i < static_cast<int>(order.size()); i++) {
+        CHECK_EQUAL(i, order[i]);
+    }
+    worker->Disable();
+    processor->Disable();
+}
+
+namespace {
+
+/** Iterator over requests which throws when the given position is reached. */
+class Throwing_iterator {
+public:
+    Throwing_iterator(std::vector<Request::Ptr>::iterator it, size_t throw_at):
+        it(it), throw_at(throw_at)
+    {}
+
+    Request::Ptr
+    operator *() const
+    {
+        if (!throw_at) {
+            VSM_EXCEPTION(Invalid_op_exception, "Iterator failure");
+        }
+        return *it;
+    }
+
+    Throwing_iterator &
+    operator ++(int)
+    {
+        it++;
+        throw_at--;
+        return *this;
+    }
+
+    bool
+    operator !=(const Throwing_iterator &other) const
+    {
+        return it != other.it;
+    }
+
+private:
+    std::vector<Request::Ptr>::iterator it;
+    size_t throw_at;
+};
+
+} /* anonymous namespace */
+
+TEST(submit_requests_notify_on_throw)
+{
+    auto processor = Request_processor::Create("UT waiter processor");
+    processor->Enable();
+    std::atomic_int processed = { 0 };
+    std::thread consumer([&]()
+    {
+        processor->Get_waiter()->Wait_and_process({processor},
+                std::chrono::milliseconds(5000));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector<Request::Ptr> requests;
+    for (int i = 0; i < 4; i++) {
+        auto req = Request::Create();
+        req->Set_processing_handler(Make_callback(
+                [&processed](Request::Ptr r)
+                {
+                    processed++;
+                    r->Complete();
+                }, req));
+        requests.push_back(req);
+    }
+    auto start = std::chrono::steady_clock::now();
+    CHECK_THROW(processor->Submit_requests(Throwing_iterator(requests.begin(), 2),
+                                           Throwing_iterator(requests.end(), 0)),
+                Invalid_op_exception);
+    consumer.join();
+    /* Requests queued before the failure are woken up for right away. */
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+    CHECK_EQUAL(2, processed);
+    /* Requests which were not submitted. */
+    requests[2]->Abort();
+    requests[3]->Abort();
+    processor->Disable();
+}
+
+TEST(request_batch_deferred_notify)
+{
+    auto processor = Request_processor::Create("UT waiter processor");
+    processor->Enable();
+    std::atomic_int processed = { 0 };
+    std::thread consumer([&]()
+    {
+        while (processed < 5) {
+            processor->Get_waiter()->Wait_and_process({processor},
+                    std::chrono::milliseconds(5000));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    {
+        Request_batch batch;
+        for (int i = 0; i < 5; i++) {
+            auto req = Request::Create();
+            req->Set_processing_handler(Make_callback(
+                    [&processed](Request::Ptr r)
+                    {
+                        processed++;
+                        r->Complete();
+                    }, req));
+            batch.Submit(processor, req);
+        }
+        /* Consumer is not woken up until the batch is closed. */
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK_EQUAL(0, processed.load());
+        CHECK_EQUAL(5ul, processor->Get_queue_size());
+    }
+    consumer.join();
+    CHECK_EQUAL(5, processed.load());
+    processor->Disable();
+}
+
+TEST(request_batch_scope)
+{
+    auto processor = Request_processor::Create("UT waiter processor");
+    auto comp_ctx = Request_completion_context::Create("UT waiter completion");
+    processor->Enable();
+    comp_ctx->Enable();
+    bool completed = false;
+    auto req = Request::Create();
+    req->Set_processing_handler(Make_callback([](Request::Ptr r) { r->Complete(); }, req));
+    req->Set_completion_handler(comp_ctx, Make_callback([&completed]() { completed = true; }));
+    processor->Submit_request(req);
+    CHECK(!Request_batch::Get_current());
+    {
+        Request_batch batch;
+        Request_batch::Scope scope(batch);
+        CHECK(Request_batch::Get_current() == &batch);
+        /* Completion is queued through the batch. */
+        CHECK_EQUAL(1, processor->Process_requests());
+        CHECK_EQUAL(1ul, comp_ctx->Get_queue_size());
+    }
+    CHECK(!Request_batch::Get_current());
+    CHECK_EQUAL(1, comp_ctx->Process_requests());
+    CHECK(completed);
+    processor->Disable();
+    comp_ctx->Disable();
+}
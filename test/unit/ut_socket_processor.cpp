@@ -10,6 +10,7 @@
 #include <ugcs/vsm/debug.h>
 
 #include <iostream>
+#include <thread>
 
 #include <UnitTest++.h>
 
@@ -362,3 +363,329 @@ TEST_FIXTURE(Timed_writes, timed_writes)
     /* No specific checks, it should just work, don't crash, don't assert anywhere. */
 }
 
+
+TEST_FIXTURE(Test_case_wrapper, socket_processor_local_timeout)
+{
+    Socket_processor::Ptr sp = ugcs::vsm::Socket_processor::Get_instance();
+    Request_worker::Ptr worker = Request_worker::Create("UT socket processor worker");
+    worker->Enable();
+
+    /* Timer created from another thread wakes the processor up. */
+    std::atomic_bool fired = { false };
+    std::thread::id timer_thread;
+    auto start = std::chrono::steady_clock::now();
+    sp->Create_timer(std::chrono::milliseconds(20), Make_callback(
+            [&]()
+            {
+                timer_thread = std::this_thread::get_id();
+                fired = true;
+                return false;
+            }));
+    while (!fired) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+    CHECK(timer_thread != std::this_thread::get_id());
+
+    Socket_processor::Stream::Ref stream;
+    Io_result result;
+    sp->Bind_udp(Socket_address::Create("127.0.0.1", "0"),
+                 Make_setter(stream, result));
+    CHECK(result == Io_result::OK);
+
+    /* Nothing to read, times out in the processor thread. */
+    Io_buffer::Ptr buf;
+    Io_result read_result = Io_result::OK;
+    std::atomic_bool done = { false };
+    start = std::chrono::steady_clock::now();
+    auto op = stream->Read(100, 1, Make_read_callback(
+            [&](Io_buffer::Ptr, Io_result res)
+            {
+                read_result = res;
+                done = true;
+            }), worker);
+    sp->Set_timeout(op, std::chrono::milliseconds(50));
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(read_result == Io_result::TIMED_OUT);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+
+    stream->Close();
+    worker->Disable();
+}
+
+namespace {
+
+/* Stream operations over poller based backend.
+ * @param port Base of three consecutive ports to use.
+ */
+void
+Check_poller_backend(Socket_processor::Ptr sp, int port)
+{
+    sp->Enable();
+
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client_stream;
+    Socket_processor::Stream::Ref server_stream;
+    Io_result result;
+    Io_buffer::Ptr buf;
+
+    sp->Listen("127.0.0.1", std::to_string(port), Make_setter(listener, result));
+    CHECK(result == Io_result::OK);
+    auto op = sp->Accept(listener, Make_setter(server_stream, result));
+    sp->Connect("127.0.0.1", std::to_string(port), Make_setter(client_stream, result));
+    CHECK(result == Io_result::OK);
+    op.Wait();
+    CHECK(server_stream);
+
+    /* Data arrived before the read is issued. */
+    client_stream->Write(Io_buffer::Create("abcdef"), Make_setter(result));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_stream->Read(3, 3, Make_setter(buf, result));
+    CHECK_EQUAL("abc", buf->Get_string());
+    /* Rest of the data is still pending, no new edge for it. */
+    server_stream->Read(3, 3, Make_setter(buf, result));
+    CHECK_EQUAL("def", buf->Get_string());
+
+    server_stream->Write(Io_buffer::Create("0123456789"), Make_setter(result));
+    client_stream->Read(10, 10, Make_setter(buf, result));
+    CHECK(result == Io_result::OK);
+    CHECK_EQUAL("0123456789", buf->Get_string());
+
+    /* Peer close is reported. */
+    client_stream->Close();
+    server_stream->Read(10, 1, Make_setter(buf, result));
+    CHECK(result != Io_result::OK);
+    server_stream->Close();
+    listener->Close();
+
+    /* Socket descriptors of closed streams are reused. */
+    Socket_processor::Stream::Ref udp1, udp2;
+    sp->Bind_udp(Socket_address::Create("127.0.0.1", std::to_string(port + 1)), Make_setter(udp1, result));
+    sp->Bind_udp(Socket_address::Create("127.0.0.1", std::to_string(port + 2)), Make_setter(udp2, result));
+    udp1->Write_to(Io_buffer::Create("ping"), udp2->Get_local_address(), Make_setter(result));
+    Socket_address::Ptr peer = Socket_address::Create();
+    udp2->Read_from(100, Make_setter(buf, result, peer));
+    CHECK(result == Io_result::OK);
+    CHECK_EQUAL("ping", buf->Get_string());
+
+    /* Local timers define the wait timeout. */
+    auto read_op = udp2->Read(100, 1, Make_setter(buf, result));
+    sp->Set_timeout(read_op, std::chrono::microseconds(30500));
+    read_op.Wait();
+    CHECK(result == Io_result::TIMED_OUT);
+
+    udp1->Close();
+    udp2->Close();
+    sp->Disable();
+}
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Test_case_wrapper, socket_processor_epoll)
+{
+    auto sp = Socket_processor::Create(Piped_request_waiter::Create(),
+                                       Socket_processor::Backend::EPOLL);
+    CHECK(sp->Get_backend() == Socket_processor::Backend::EPOLL);
+    Check_poller_backend(sp, 32771);
+}
+
+namespace {
+
+/* Transfer data over loopback TCP connection.
+ * @return Throughput in megabytes per second.
+ */
+double
+Run_transfer(Socket_processor::Backend backend, int port)
+{
+    constexpr size_t CHUNK_SIZE = 16384;
+    constexpr int NUM_CHUNKS = 2000;
+    auto sp = Socket_processor::Create(Piped_request_waiter::Create(), backend);
+    sp->Enable();
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client_stream, server_stream;
+    Io_result result;
+    sp->Listen("127.0.0.1", std::to_string(port), Make_setter(listener, result));
+    auto op = sp->Accept(listener, Make_setter(server_stream, result));
+    sp->Connect("127.0.0.1", std::to_string(port), Make_setter(client_stream, result));
+    op.Wait();
+
+    auto chunk = Io_buffer::Create(std::string(CHUNK_SIZE, 'x'));
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer([&]()
+    {
+        for (int i = 0; i < NUM_CHUNKS; i++) {
+            Io_result write_result;
+            client_stream->Write(chunk, Make_setter(write_result));
+        }
+    });
+    size_t received = 0;
+    while (received < CHUNK_SIZE * NUM_CHUNKS) {
+        Io_buffer::Ptr buf;
+        Io_result read_result;
+        server_stream->Read(CHUNK_SIZE, 1, Make_setter(buf, read_result));
+        if (read_result != Io_result::OK) {
+            break;
+        }
+        received += buf->Get_length();
+    }
+    writer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    CHECK_EQUAL(CHUNK_SIZE * NUM_CHUNKS, received);
+
+    client_stream->Close();
+    server_stream->Close();
+    listener->Close();
+    sp->Disable();
+    return received / elapsed.count() / (1024 * 1024);
+}
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Test_case_wrapper, socket_processor_backends_benchmark)
+{
+    double select_rate = Run_transfer(Socket_processor::Backend::SELECT, 32777);
+    double epoll_rate = Run_transfer(Socket_processor::Backend::EPOLL, 32778);
+    LOG_INFO("Loopback TCP transfer: select %.1f MB/s, epoll %.1f MB/s",
+             select_rate, epoll_rate);
+    CHECK(select_rate > 0 && epoll_rate > 0);
+}
+
+namespace {
+
+/* Burst of datagrams several times larger than a receive or send batch.
+ * @param port Base of two consecutive ports to use.
+ */
+void
+Check_udp_burst(Socket_processor::Backend backend, int port)
+{
+    constexpr int NUM_DATAGRAMS = 100;
+    auto sp = Socket_processor::Create(Piped_request_waiter::Create(), backend);
+    sp->Enable();
+    Socket_processor::Stream::Ref sender, receiver;
+    Io_result result;
+    sp->Bind_udp(Socket_address::Create("127.0.0.1", std::to_string(port)), Make_setter(sender, result));
+    CHECK(result == Io_result::OK);
+    sp->Bind_udp(Socket_address::Create("127.0.0.1", std::to_string(port + 1)), Make_setter(receiver, result));
+    CHECK(result == Io_result::OK);
+
+    /* Reads are queued first so nothing is dropped by the packet cache. */
+    std::vector<Io_buffer::Ptr> bufs(NUM_DATAGRAMS);
+    std::vector<Io_result> read_results(NUM_DATAGRAMS, Io_result::OTHER_FAILURE);
+    std::vector<Socket_address::Ptr> peers(NUM_DATAGRAMS);
+    std::vector<Operation_waiter> reads;
+    for (int i = 0; i < NUM_DATAGRAMS; i++) {
+        reads.push_back(receiver->Read_from(100, Make_setter(bufs[i], read_results[i], peers[i])));
+    }
+    std::vector<Io_result> write_results(NUM_DATAGRAMS, Io_result::OTHER_FAILURE);
+    std::vector<Operation_waiter> writes;
+    for (int i = 0; i < NUM_DATAGRAMS; i++) {
+        writes.push_back(sender->Write_to(Io_buffer::Create(std::to_string(i)),
+                                          receiver->Get_local_address(),
+                                          Make_setter(write_results[i])));
+    }
+    for (int i = 0; i < NUM_DATAGRAMS; i++) {
+        writes[i].Wait();
+        CHECK(write_results[i] == Io_result::OK);
+    }
+    for (int i = 0; i < NUM_DATAGRAMS; i++) {
+        reads[i].Wait();
+        CHECK(read_results[i] == Io_result::OK);
+        /* Loopback preserves the order. */
+        CHECK_EQUAL(std::to_string(i), bufs[i]->Get_string());
+        CHECK_EQUAL(port, ntohs(peers[i]->Get_as_sockaddr_in().sin_port));
+    }
+
+    sender->Close();
+    receiver->Close();
+    sp->Disable();
+}
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Test_case_wrapper, socket_processor_udp_batch)
+{
+    Check_udp_burst(Socket_processor::Backend::SELECT, 32780);
+    Check_udp_burst(Socket_processor::Backend::EPOLL, 32782);
+}
+
+namespace {
+
+/* Tiny and exactly sized reads of TCP stream, served by the receive ring.
+ * Amount of data exceeds the ring size.
+ */
+void
+Check_tcp_small_reads(Socket_processor::Backend backend, int port)
+{
+    auto sp = Socket_processor::Create(Piped_request_waiter::Create(), backend);
+    sp->Enable();
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client_stream, server_stream;
+    Io_result result;
+    sp->Listen("127.0.0.1", std::to_string(port), Make_setter(listener, result));
+    auto op = sp->Accept(listener, Make_setter(server_stream, result));
+    sp->Connect("127.0.0.1", std::to_string(port), Make_setter(client_stream, result));
+    op.Wait();
+    CHECK(server_stream);
+
+    std::string data;
+    for (int i = 0; i < 100000; i++) {
+        data += static_cast<char>('a' + i % 26);
+    }
+    Io_result write_result;
+    auto write_op = client_stream->Write(Io_buffer::Create(data), Make_setter(write_result));
+
+    std::vector<Io_buffer::Ptr> bufs;
+    size_t received = 0;
+    while (received < data.size()) {
+        /* One byte reads, then MAVLink-like exactly sized ones, copied out
+         * of the ring, mixed with large ones served by slices.
+         */
+        size_t size = received < 1000 ? 1 : bufs.size() % 2 ? 263 : 4000;
+        size = std::min(size, data.size() - received);
+        Io_buffer::Ptr buf;
+        server_stream->Read(size, size, Make_setter(buf, result));
+        CHECK(result == Io_result::OK);
+        if (result != Io_result::OK) {
+            break;
+        }
+        CHECK_EQUAL(size, buf->Get_length());
+        bufs.push_back(buf);
+        received += buf->Get_length();
+    }
+    write_op.Wait();
+    CHECK(write_result == Io_result::OK);
+
+    /* Slices stay intact after the ring is replaced. */
+    std::string joined;
+    for (auto &buf : bufs) {
+        joined += buf->Get_string();
+    }
+    CHECK(joined == data);
+
+    /* Buffered data is returned before the peer close. */
+    client_stream->Write(Io_buffer::Create("xyz"), Make_setter(result));
+    client_stream->Close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Io_buffer::Ptr buf;
+    server_stream->Read(1, 1, Make_setter(buf, result));
+    CHECK(result == Io_result::OK);
+    server_stream->Read(10, 2, Make_setter(buf, result));
+    CHECK(result == Io_result::OK);
+    CHECK_EQUAL("yz", buf->Get_string());
+    server_stream->Read(10, 1, Make_setter(buf, result));
+    CHECK(result != Io_result::OK);
+
+    server_stream->Close();
+    listener->Close();
+    sp->Disable();
+}
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Test_case_wrapper, socket_processor_tcp_small_reads)
+{
+    Check_tcp_small_reads(Socket_processor::Backend::SELECT, 32786);
+    Check_tcp_small_reads(Socket_processor::Backend::EPOLL, 32787);
+}
@@ -8,6 +8,7 @@
 
 #include <ugcs/vsm/timer_processor.h>
 #include <ugcs/vsm/request_worker.h>
+#include <algorithm>
 #include <unordered_set>
 #include <vector>
 
@@ -332,3 +333,386 @@ TEST(cancel_race)
         LOG_INFO("Iteration done.");
     }
 }
+
+TEST(timer_wheel_expiration)
+{
+    /* Timers are not started, only their fire time is used. */
+    auto timer_proc = Timer_processor::Create();
+    auto start = std::chrono::steady_clock::now();
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            start.time_since_epoch()).count();
+    std::vector<int> intervals = {0, 1, 63, 64, 65, 1000, 4096, 5000, 300000,
+                                  20 * 24 * 3600 * 1000};
+    Timer_processor::Timer_wheel wheel;
+    std::vector<Timer_processor::Timer::Ptr> timers;
+    for (auto interval : intervals) {
+        auto timer = Timer_processor::Timer::Create(timer_proc,
+                std::chrono::milliseconds(interval));
+        timers.push_back(timer);
+        wheel.Insert(timer, now);
+    }
+    auto canceled = Timer_processor::Timer::Create(timer_proc, std::chrono::milliseconds(70));
+    wheel.Insert(canceled, now);
+    wheel.Remove(*canceled);
+    wheel.Remove(*canceled);
+
+    size_t num_expired = 0;
+    auto tick = now;
+    while (!wheel.Is_empty()) {
+        tick = std::max(tick, wheel.Get_next_tick());
+        std::vector<Timer_processor::Timer::Ptr> expired;
+        wheel.Advance(tick, expired);
+        for (auto& timer : expired) {
+            CHECK(timer != canceled);
+            auto fire_tick = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    timer->Get_fire_time().time_since_epoch()).count();
+            /* Expired exactly at its tick. */
+            CHECK_EQUAL(fire_tick, tick);
+            CHECK(timer == timers[num_expired]);
+            num_expired++;
+        }
+        tick++;
+    }
+    CHECK_EQUAL(intervals.size(), num_expired);
+}
+
+TEST(timer_wheel_block_start)
+{
+    constexpr auto LEVEL_SIZE = Timer_processor::Timer_wheel::LEVEL_SIZE;
+    auto timer_proc = Timer_processor::Create();
+    auto get_tick = [](const std::chrono::steady_clock::time_point &time)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                time.time_since_epoch()).count();
+    };
+    auto now = get_tick(std::chrono::steady_clock::now());
+    /* Far enough for the timer to be linked above the lowest level. */
+    auto block_start = ((now + 2 * LEVEL_SIZE) | (LEVEL_SIZE - 1)) + 1;
+    Timer_processor::Timer_wheel wheel;
+    auto timer = Timer_processor::Timer::Create(timer_proc,
+            std::chrono::milliseconds(block_start + 5 - now));
+    wheel.Insert(timer, now);
+    auto fire_tick = get_tick(timer->Get_fire_time());
+    std::vector<Timer_processor::Timer::Ptr> expired;
+    /* Wheel stops right at the start of the timer block. */
+    wheel.Advance(block_start - 1, expired);
+    CHECK(expired.empty());
+    CHECK_EQUAL(fire_tick, wheel.Get_next_tick());
+    wheel.Advance(fire_tick, expired);
+    CHECK_EQUAL(1ul, expired.size());
+}
+
+TEST(timer_wheel_collect)
+{
+    auto timer_proc = Timer_processor::Create();
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    Timer_processor::Timer_wheel wheel;
+    auto first = Timer_processor::Timer::Create(timer_proc, std::chrono::milliseconds(5));
+    auto near = Timer_processor::Timer::Create(timer_proc, std::chrono::milliseconds(10));
+    wheel.Insert(first, now);
+    wheel.Insert(near, now);
+    auto fire_tick = std::chrono::duration_cast<std::chrono::milliseconds>(
+            first->Get_fire_time().time_since_epoch()).count();
+    std::vector<Timer_processor::Timer::Ptr> expired;
+    wheel.Advance(fire_tick, expired);
+    CHECK_EQUAL(1ul, expired.size());
+    /* Coalesced with the expired one. */
+    wheel.Collect(fire_tick + 10, expired);
+    CHECK_EQUAL(2ul, expired.size());
+    CHECK(wheel.Is_empty());
+
+    /* Timer created right after the coalesced fire and expiring within the
+     * coalescing window is not delayed.
+     */
+    auto short_timer = Timer_processor::Timer::Create(timer_proc, std::chrono::milliseconds(7));
+    auto short_tick = std::chrono::duration_cast<std::chrono::milliseconds>(
+            short_timer->Get_fire_time().time_since_epoch()).count();
+    wheel.Insert(short_timer, fire_tick);
+    CHECK(wheel.Get_next_tick() <= short_tick);
+    expired.clear();
+    wheel.Advance(short_tick, expired);
+    CHECK_EQUAL(1ul, expired.size());
+}
+
+TEST(timer_wheel_collect_next_block)
+{
+    constexpr auto LEVEL_SIZE = Timer_processor::Timer_wheel::LEVEL_SIZE;
+    auto timer_proc = Timer_processor::Create();
+    auto get_tick = [](const std::chrono::steady_clock::time_point &time)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                time.time_since_epoch()).count();
+    };
+    auto now = get_tick(std::chrono::steady_clock::now());
+    /* Far enough for the second timer to be linked above the lowest level. */
+    auto block_start = ((now + 2 * LEVEL_SIZE) | (LEVEL_SIZE - 1)) + 1;
+    Timer_processor::Timer_wheel wheel;
+    auto first = Timer_processor::Timer::Create(timer_proc,
+            std::chrono::milliseconds(block_start - 2 - now));
+    auto next = Timer_processor::Timer::Create(timer_proc,
+            std::chrono::milliseconds(block_start + 2 - now));
+    wheel.Insert(first, now);
+    wheel.Insert(next, now);
+    auto fire_tick = get_tick(first->Get_fire_time());
+    auto next_tick = get_tick(next->Get_fire_time());
+    CHECK(fire_tick < block_start && next_tick >= block_start);
+    std::vector<Timer_processor::Timer::Ptr> expired;
+    wheel.Advance(fire_tick, expired);
+    CHECK_EQUAL(1ul, expired.size());
+    /* The window crosses the block boundary. */
+    wheel.Collect(next_tick, expired);
+    CHECK_EQUAL(2ul, expired.size());
+    CHECK(wheel.Is_empty());
+}
+
+TEST(timer_wheel_usage)
+{
+    auto timer_proc = Timer_processor::Create(Timer_processor::Backend::WHEEL);
+    CHECK(timer_proc->Get_backend() == Timer_processor::Backend::WHEEL);
+    timer_proc->Enable();
+    auto worker = Request_worker::Create("UT timer wheel");
+    worker->Enable();
+
+    int count = 3;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration elapsed;
+    auto periodic = timer_proc->Create_timer(std::chrono::milliseconds(100),
+            Make_callback([&]()
+            {
+                elapsed = std::chrono::steady_clock::now() - start;
+                return --count != 0;
+            }), worker);
+    int canceled_count = 0;
+    auto canceled = timer_proc->Create_timer(std::chrono::milliseconds(150),
+            Make_callback([&]()
+            {
+                canceled_count++;
+                return true;
+            }), worker);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    canceled->Cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CHECK(!periodic->Is_running());
+    CHECK_EQUAL(0, count);
+    CHECK(elapsed >= std::chrono::milliseconds(299));
+    CHECK(elapsed < std::chrono::milliseconds(450));
+    CHECK_EQUAL(0, canceled_count);
+
+    worker->Disable();
+    timer_proc->Disable();
+}
+
+namespace {
+
+/* Create and cancel many concurrent timeouts.
+ * @return Time spent.
+ */
+std::chrono::duration<double>
+Run_timeouts(Timer_processor::Backend backend, int num_timers)
+{
+    auto timer_proc = Timer_processor::Create(backend);
+    timer_proc->Enable();
+    auto worker = Request_worker::Create("UT timer benchmark");
+    worker->Enable();
+    auto handler = Make_callback([]() { return false; });
+    std::vector<Timer_processor::Timer::Ptr> timers;
+    timers.reserve(num_timers);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_timers; i++) {
+        /* Spread like operation timeouts. */
+        timers.push_back(timer_proc->Create_timer(
+                std::chrono::milliseconds(5000 + i % 10000), handler, worker));
+    }
+    /* Wait until all timers are inserted. */
+    auto req = Request::Create();
+    req->Set_processing_handler(Make_callback([](Request::Ptr r) { r->Complete(); }, req));
+    timer_proc->Submit_request(req);
+    req->Wait_done(false);
+    for (auto& timer : timers) {
+        timer->Cancel();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    worker->Disable();
+    timer_proc->Disable();
+    return elapsed;
+}
+
+} /* anonymous namespace */
+
+TEST(timer_backends_benchmark)
+{
+    constexpr int NUM_OF_TIMERS = 100000;
+    auto tree_time = Run_timeouts(Timer_processor::Backend::TREE, NUM_OF_TIMERS);
+    auto wheel_time = Run_timeouts(Timer_processor::Backend::WHEEL, NUM_OF_TIMERS);
+    LOG_INFO("%d timeouts created and canceled: tree %.1f ms, wheel %.1f ms",
+             NUM_OF_TIMERS, tree_time.count() * 1000, wheel_time.count() * 1000);
+    CHECK(wheel_time.count() > 0);
+}
+
+TEST(timer_microseconds_resolution)
+{
+    CHECK_THROW(Timer_processor::Create(Timer_processor::Backend::WHEEL,
+                                        Timer_processor::Resolution::MICROSECONDS),
+                Invalid_param_exception);
+    auto timer_proc = Timer_processor::Create(Timer_processor::Backend::TREE,
+                                              Timer_processor::Resolution::MICROSECONDS);
+    timer_proc->Enable();
+    auto worker = Request_worker::Create("UT timer microseconds");
+    worker->Enable();
+
+    constexpr int NUM_FIRES = 40;
+    std::atomic_int count = { 0 };
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration first, elapsed;
+    auto timer = timer_proc->Create_timer(std::chrono::microseconds(2500),
+            Make_callback([&]()
+            {
+                auto now = std::chrono::steady_clock::now() - start;
+                if (!count) {
+                    first = now;
+                }
+                elapsed = now;
+                return ++count < NUM_FIRES;
+            }), worker);
+    while (count < NUM_FIRES) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(first >= std::chrono::microseconds(2500));
+    CHECK(elapsed >= std::chrono::microseconds(2500 * NUM_FIRES));
+    CHECK(elapsed < std::chrono::milliseconds(2500 * NUM_FIRES / 1000 + 60));
+    LOG_INFO("%d fires of 2.5 ms timer took %.2f ms", NUM_FIRES,
+             std::chrono::duration<double, std::milli>(elapsed).count());
+
+    worker->Disable();
+    timer_proc->Disable();
+}
+
+TEST(timer_coalescing)
+{
+    for (auto backend: {Timer_processor::Backend::TREE, Timer_processor::Backend::WHEEL}) {
+        auto timer_proc = Timer_processor::Create(backend);
+        timer_proc->Set_coalescing_window(std::chrono::milliseconds(20));
+        timer_proc->Enable();
+        auto worker = Request_worker::Create("UT timer coalescing");
+        worker->Enable();
+
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration fired[2];
+        std::atomic_int count = { 0 };
+        auto handler = [&](int idx)
+        {
+            fired[idx] = std::chrono::steady_clock::now() - start;
+            count++;
+            return false;
+        };
+        timer_proc->Create_timer(std::chrono::milliseconds(100),
+                                 Make_callback(handler, 0), worker);
+        timer_proc->Create_timer(std::chrono::milliseconds(110),
+                                 Make_callback(handler, 1), worker);
+        while (count < 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        /* Second timer fired early together with the first one. */
+        CHECK(fired[0] >= std::chrono::milliseconds(99));
+        CHECK(fired[1] < std::chrono::milliseconds(110));
+        CHECK(fired[1] - fired[0] < std::chrono::milliseconds(5));
+        if (fired[1] >= std::chrono::milliseconds(110)) std::cerr << "DBG backend " << int(backend) << " " << std::chrono::duration_cast<std::chrono::microseconds>(fired[0]).count() << " " << std::chrono::duration_cast<std::chrono::microseconds>(fired[1]).count() << std::endl;
+
+        worker->Disable();
+        timer_proc->Disable();
+    }
+}
+
+TEST(worker_local_timer)
+{
+    Request_worker::Ptr worker = Request_worker::Create("UT timer local");
+    std::thread::id handler_thread;
+    std::atomic_int count = { 3 };
+    auto handler = [&]()
+    {
+        handler_thread = std::this_thread::get_id();
+        return --count != 0;
+    };
+    /* Created before the worker thread is started. */
+    auto timer = worker->Create_timer(std::chrono::milliseconds(20),
+                                      Make_callback(handler));
+    auto canceled = worker->Create_timer(std::chrono::milliseconds(50),
+                                         Make_callback([]() { return true; }));
+    CHECK(canceled->Is_running());
+    canceled->Cancel();
+    CHECK(!canceled->Is_running());
+    worker->Enable();
+    while (count) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(!timer->Is_running());
+    CHECK(handler_thread != std::this_thread::get_id());
+
+    /* Idle worker is woken up by a timer created from another thread. */
+    auto start = std::chrono::steady_clock::now();
+    std::atomic_bool fired = { false };
+    std::chrono::steady_clock::duration delay;
+    worker->Create_timer(std::chrono::milliseconds(30), Make_callback(
+            [&]()
+            {
+                delay = std::chrono::steady_clock::now() - start;
+                fired = true;
+                return false;
+            }));
+    while (!fired) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(delay >= std::chrono::milliseconds(30));
+    CHECK(delay < std::chrono::milliseconds(80));
+
+    /* Running timers are canceled on disabling. */
+    auto periodic = worker->Create_timer(std::chrono::milliseconds(10),
+                                         Make_callback([]() { return true; }));
+    worker->Disable();
+    CHECK(!periodic->Is_running());
+}
+
+TEST(timer_stats)
+{
+    auto timer_proc = Timer_processor::Create();
+    timer_proc->Enable();
+    auto worker = Request_worker::Create("UT timer stats");
+    worker->Enable();
+
+    std::atomic_int count = { 0 };
+    std::vector<Timer_processor::Timer::Ptr> timers;
+    for (int i = 0; i < 100; i++) {
+        timers.push_back(timer_proc->Create_timer(
+                std::chrono::milliseconds(50),
+                Make_callback([&]() { count++; return false; }), worker));
+    }
+    auto stats = timer_proc->Get_stats();
+    CHECK_EQUAL(100u, stats.active_timers);
+    CHECK_EQUAL(100u, stats.max_active_timers);
+    while (count < 100) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    /* Destroyed after the handler returns. */
+    while (timer_proc->Get_stats().active_timers) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    stats = timer_proc->Get_stats(true);
+    CHECK_EQUAL(100u, stats.max_active_timers);
+    CHECK_EQUAL(100u, stats.fire_lateness.count);
+    CHECK_EQUAL(100u, stats.handler_lateness.count);
+    CHECK(stats.handler_lateness.max >= stats.fire_lateness.Get_percentile(50));
+    /* Timers created within the same millisecond share the tree slot. */
+    CHECK(stats.attached_timers > 0);
+    CHECK(stats.max_attach_chain >= 2);
+    timer_proc->Dump_stats();
+
+    stats = timer_proc->Get_stats();
+    CHECK_EQUAL(0u, stats.fire_lateness.count);
+    CHECK_EQUAL(0u, stats.max_active_timers);
+    CHECK_EQUAL(0u, stats.max_attach_chain);
+
+    worker->Disable();
+    timer_proc->Disable();
+}
@@ -177,3 +177,21 @@ TEST(udp_multistream)
     sp->Disable();
     Timer_processor::Get_instance()->Disable();
 }
+
+TEST(udp_address_key)
+{
+    auto a = Socket_address::Create("127.0.0.1", "5760");
+    auto b = Socket_address::Create("127.0.0.1", "5760");
+    auto other_port = Socket_address::Create("127.0.0.1", "5761");
+    auto other_host = Socket_address::Create("127.0.0.2", "5760");
+    std::hash<Socket_address::Key> hash;
+
+    CHECK(a->Get_key() == b->Get_key());
+    CHECK_EQUAL(hash(a->Get_key()), hash(b->Get_key()));
+    CHECK(!(a->Get_key() == other_port->Get_key()));
+    CHECK(!(a->Get_key() == other_host->Get_key()));
+    CHECK(hash(a->Get_key()) != hash(other_port->Get_key()));
+
+    /* Key is built from raw address as received by recvfrom(). */
+    CHECK(Socket_address::Key(a->Get_as_sockaddr_storage()) == a->Get_key());
+}
@@ -10,6 +10,8 @@
 
 #include <UnitTest++.h>
 
+#include <future>
+
 using namespace ugcs::vsm;
 
 
@@ -93,6 +95,45 @@ public:
         t_latitude->Set_value(11.2);
         Commit_to_ucs();
     }
+
+    /* Send commands which undo each other back to back as UCS does. */
+    void
+    Send_paired_commands()
+    {
+        for (auto &cmd : {c_takeoff_command, c_land_command, c_resume, c_rth}) {
+            ugcs::vsm::proto::Vsm_message msg;
+            msg.add_device_commands()->set_command_id(cmd->Get_id());
+            On_ucs_message(std::move(msg));
+        }
+    }
+
+    /* Executed commands and bulk tasks, in execution order. */
+    std::vector<std::string> executed;
+
+    using Vehicle::Handle_vehicle_request;
+
+    void
+    Handle_vehicle_request(Vehicle_command_request::Handle request) override
+    {
+        switch (request->Get_type()) {
+        case Vehicle_command::Type::TAKEOFF:
+            executed.push_back("takeoff");
+            break;
+        case Vehicle_command::Type::LAND:
+            executed.push_back("land");
+            break;
+        case Vehicle_command::Type::RESUME_MISSION:
+            executed.push_back("resume");
+            break;
+        case Vehicle_command::Type::RETURN_HOME:
+            executed.push_back("rth");
+            break;
+        default:
+            executed.push_back("other");
+            break;
+        }
+        request.Succeed();
+    }
 };
 
 TEST(basic_usage)
@@ -157,6 +198,49 @@ TEST(basic_usage)
     ugcs::vsm::Terminate();
 }
 
+TEST(paired_commands_keep_order)
+{
+    auto v = Some_vehicle::Create(0);
+    v->Enable();
+    auto processor = v->Get_processing_ctx();
+
+    /* Hold the vehicle processor until everything is queued. */
+    std::promise<void> started, release;
+    auto release_future = release.get_future();
+    processor->Post([&started, &release_future]()
+    {
+        started.set_value();
+        release_future.wait();
+    });
+    started.get_future().wait();
+
+    /* Bulk work, e.g. mission upload traffic, queued before the commands. */
+    for (int i = 0; i < 3; i++) {
+        processor->Post([&v]() { v->executed.push_back("bulk"); },
+                        Request::Priority::LOW);
+    }
+    v->Send_paired_commands();
+    release.set_value();
+
+    /* Done when the last bulk task is executed and the command completions
+     * queued before it are delivered.
+     */
+    std::promise<void> done;
+    processor->Post([&done, &v]()
+    {
+        v->Get_completion_ctx()->Post([&done]() { done.set_value(); });
+    }, Request::Priority::LOW);
+    done.get_future().wait();
+
+    std::vector<std::string> expected =
+        {"takeoff", "land", "resume", "rth", "bulk", "bulk", "bulk"};
+    CHECK_EQUAL(expected.size(), v->executed.size());
+    for (size_t i = 0; i < expected.size() && i < v->executed.size(); i++) {
+        CHECK_EQUAL(expected[i], v->executed[i]);
+    }
+    v->Disable();
+}
+
 TEST(get_takeoff_altitude_500)
 {
     // Test takeOffAltitude is 500.0